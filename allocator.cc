@@ -3,6 +3,8 @@
 #include <map>
 #include <iostream>
 #include <cstring>
+#include <thread>
+#include <unordered_map>
 #include <numa.h>
 
 #include "allocator.h"
@@ -15,6 +17,12 @@ using namespace util;
 
 static event_counter evt_allocator_total_region_usage(
     "allocator_total_region_usage_bytes");
+static event_counter evt_allocator_region_growth(
+    "allocator_region_growth_bytes");
+static event_counter evt_allocator_idle_released(
+    "allocator_idle_released_bytes");
+static event_counter evt_allocator_idle_reused(
+    "allocator_idle_reused_bytes");
 
 // page+alloc routines taken from masstree
 
@@ -33,7 +41,7 @@ allocator::PointerToPgMetadata(const void *p)
   p = (const void *) ((uintptr_t)p & ~(hugepgsize-1));
   const pgmetadata *pmd = (const pgmetadata *) p;
   ALWAYS_ASSERT((pmd->unit_ % AllocAlignment) == 0);
-  ALWAYS_ASSERT((MAX_ARENAS * AllocAlignment) >= pmd->unit_);
+  ALWAYS_ASSERT(MaxArenaAllocSize >= pmd->unit_);
   return pmd;
 }
 #endif
@@ -74,6 +82,15 @@ allocator::UseMAdvWillNeed()
   return use_madv;
 }
 
+bool
+allocator::UseMAdvDontNeed()
+{
+  static const char *px = getenv("DISABLE_MADV_DONTNEED");
+  static const std::string s = px ? to_lower(px) : "";
+  static const bool use_madv = !(s == "1" || s == "true");
+  return use_madv;
+}
+
 void
 allocator::Initialize(size_t ncpus, size_t maxpercore)
 {
@@ -95,7 +112,7 @@ allocator::Initialize(size_t ncpus, size_t maxpercore)
   maxpercore = slow_round_up(maxpercore, hugepgsize);
 
   g_ncpus = ncpus;
-  g_maxpercore = maxpercore;
+  g_maxpercore = maxpercore * RegionGrowthFactor;
 
   // mmap() the entire region for now, but just as a marker
   // (this does not actually cause physical pages to be allocated)
@@ -113,6 +130,7 @@ allocator::Initialize(size_t ncpus, size_t maxpercore)
   std::cerr << "allocator::Initialize()" << std::endl
             << "  hugepgsize: " << hugepgsize << std::endl
             << "  use MADV_WILLNEED: " << UseMAdvWillNeed() << std::endl
+            << "  use MADV_DONTNEED: " << UseMAdvDontNeed() << std::endl
             << "  mmap() region [" << x << ", " << endpx << ")" << std::endl;
 
   g_memstart = reinterpret_cast<void *>(util::iceil(uintptr_t(x), hugepgsize));
@@ -123,32 +141,94 @@ allocator::Initialize(size_t ncpus, size_t maxpercore)
       (reinterpret_cast<uintptr_t>(x) + (g_ncpus * g_maxpercore + hugepgsize)));
 
   for (size_t i = 0; i < g_ncpus; i++) {
-    g_regions[i].region_begin =
+    regionctx &pc = g_regions[i];
+    pc.region_start =
       reinterpret_cast<char *>(g_memstart) + (i * g_maxpercore);
-    g_regions[i].region_end   =
+    pc.region_begin = pc.region_start;
+    pc.region_end = reinterpret_cast<char *>(pc.region_start) + maxpercore;
+    pc.region_max =
       reinterpret_cast<char *>(g_memstart) + ((i + 1) * g_maxpercore);
-    std::cerr << "cpu" << i << " owns [" << g_regions[i].region_begin
-              << ", " << g_regions[i].region_end << ")" << std::endl;
-    ALWAYS_ASSERT(g_regions[i].region_begin < g_regions[i].region_end);
-    ALWAYS_ASSERT(g_regions[i].region_begin >= x);
-    ALWAYS_ASSERT(g_regions[i].region_end <= endpx);
+    pc.region_faulted_end = pc.region_start;
+    std::cerr << "cpu" << i << " owns [" << pc.region_begin
+              << ", " << pc.region_end << ") (grows up to "
+              << pc.region_max << ")" << std::endl;
+    ALWAYS_ASSERT(pc.region_begin < pc.region_end);
+    ALWAYS_ASSERT(pc.region_end <= pc.region_max);
+    ALWAYS_ASSERT(pc.region_begin >= x);
+    ALWAYS_ASSERT(pc.region_max <= endpx);
   }
 
+  if (UseMAdvDontNeed())
+    std::thread(&allocator::IdleReleaseLoop).detach();
+
   s_init = true;
 }
 
 void
 allocator::DumpStats()
 {
-  std::cerr << "[allocator] ncpus=" << g_ncpus << std::endl;
+  std::cerr << "[allocator] ncpus=" << g_ncpus
+            << " reserved=" << ReservedBytes() << " bytes"
+            << " resident=" << ResidentBytes() << " bytes" << std::endl;
   for (size_t i = 0; i < g_ncpus; i++) {
-    const bool f = g_regions[i].region_faulted;
+    regionctx &pc = g_regions[i];
+    lock_guard<spinlock> l(pc.lock);
+    const bool f = pc.region_faulted_end >= pc.region_end;
     const size_t remaining =
-      intptr_t(g_regions[i].region_end) -
-      intptr_t(g_regions[i].region_begin);
+      intptr_t(pc.region_end) - intptr_t(pc.region_begin);
+    const size_t growable =
+      intptr_t(pc.region_max) - intptr_t(pc.region_end);
     std::cerr << "[allocator] cpu=" << i << " fully_faulted?=" << f
-              << " remaining=" << remaining << " bytes" << std::endl;
+              << " remaining=" << remaining << " bytes"
+              << " growable=" << growable << " bytes"
+              << " released_hugepgs=" << pc.released_hugepgs.size()
+              << std::endl;
+  }
+}
+
+size_t
+allocator::ReservedBytes()
+{
+  size_t ret = 0;
+  for (size_t i = 0; i < g_ncpus; i++) {
+    regionctx &pc = g_regions[i];
+    lock_guard<spinlock> l(pc.lock);
+    ret += intptr_t(pc.region_end) - intptr_t(pc.region_start);
+  }
+  return ret;
+}
+
+size_t
+allocator::ResidentBytes()
+{
+  static const size_t hugepgsize = GetHugepageSize();
+  size_t ret = 0;
+  for (size_t i = 0; i < g_ncpus; i++) {
+    regionctx &pc = g_regions[i];
+    lock_guard<spinlock> l(pc.lock);
+    const void * const end = std::max(pc.region_begin, pc.region_faulted_end);
+    ret += intptr_t(end) - intptr_t(pc.region_start);
+    ret -= pc.released_hugepgs.size() * hugepgsize;
   }
+  return ret;
+}
+
+// the first object of size unit carved out of page
+static inline void *
+page_first_unit(void *page, const size_t unit)
+{
+#ifdef MEMCHECK_MAGIC
+  page = (void *) ((uintptr_t)page + sizeof(::allocator::pgmetadata));
+#endif
+  return (void *)util::iceil((uintptr_t)page, (uintptr_t)unit);
+}
+
+// the # of objects of size unit carved out of page
+static inline size_t
+page_units(void *page, const size_t pagesize, const size_t unit)
+{
+  void * const first = page_first_unit(page, unit);
+  return ((uintptr_t)page + pagesize - (uintptr_t)first) / unit;
 }
 
 static void *
@@ -159,10 +239,9 @@ initialize_page(void *page, const size_t pagesize, const size_t unit)
 #ifdef MEMCHECK_MAGIC
   ::allocator::pgmetadata *pmd = (::allocator::pgmetadata *) page;
   pmd->unit_ = unit;
-  page = (void *) ((uintptr_t)page + sizeof(*pmd));
 #endif
 
-  void *first = (void *)util::iceil((uintptr_t)page, (uintptr_t)unit);
+  void *first = page_first_unit(page, unit);
   INVARIANT((uintptr_t)first + unit <= (uintptr_t)page + pagesize);
   void **p = (void **)first;
   void *next = (void *)((uintptr_t)p + unit);
@@ -202,12 +281,13 @@ allocator::AllocateArenas(size_t cpu, size_t arena)
     // claim
     void *ret = pc.arenas[arena];
     pc.arenas[arena] = nullptr;
+    pc.narenas[arena] = 0;
     pc.lock.unlock();
     return ret;
   }
 
   void * const mypx = AllocateUnmanagedWithLock(pc, 1); // releases lock
-  return initialize_page(mypx, hugepgsize, (arena + 1) * AllocAlignment);
+  return initialize_page(mypx, hugepgsize, ArenaAllocSize(arena));
 }
 
 void *
@@ -223,6 +303,15 @@ allocator::AllocateUnmanagedWithLock(regionctx &pc, size_t nhugepgs)
 {
   static const size_t hugepgsize = GetHugepageSize();
 
+  if (nhugepgs == 1 && !pc.released_hugepgs.empty()) {
+    // still mapped, the next touch faults in zeroed pages
+    void * const px = pc.released_hugepgs.back();
+    pc.released_hugepgs.pop_back();
+    pc.lock.unlock();
+    evt_allocator_idle_reused.inc(hugepgsize);
+    return px;
+  }
+
   void * const mypx = pc.region_begin;
 
   // check alignment
@@ -232,20 +321,34 @@ allocator::AllocateUnmanagedWithLock(regionctx &pc, size_t nhugepgs)
   void * const mynewpx =
     reinterpret_cast<char *>(mypx) + nhugepgs * hugepgsize;
 
+  while (unlikely(mynewpx > pc.region_end) && pc.region_end < pc.region_max) {
+    // grow by doubling. the address space is already reserved, so this is
+    // just bookkeeping
+    const size_t cursz =
+      intptr_t(pc.region_end) - intptr_t(pc.region_start);
+    void * const newend = std::min(
+        reinterpret_cast<char *>(pc.region_end) + cursz,
+        reinterpret_cast<char *>(pc.region_max));
+    evt_allocator_region_growth.inc(intptr_t(newend) - intptr_t(pc.region_end));
+    pc.region_end = newend;
+  }
+
   if (unlikely(mynewpx > pc.region_end)) {
     std::cerr << "allocator::AllocateUnmanagedWithLock():" << std::endl
               << "  region ending at " << pc.region_end << " OOM" << std::endl;
     ALWAYS_ASSERT(false); // out of memory otherwise
   }
 
-  const bool needs_mmap = !pc.region_faulted;
+  const bool needs_mmap = mynewpx > pc.region_faulted_end;
   pc.region_begin = mynewpx;
+  if (needs_mmap)
+    pc.region_faulted_end = mynewpx;
   pc.lock.unlock();
 
   evt_allocator_total_region_usage.inc(nhugepgs * hugepgsize);
 
   if (needs_mmap) {
-    void * const x = mmap(mypx, hugepgsize, PROT_READ | PROT_WRITE,
+    void * const x = mmap(mypx, nhugepgs * hugepgsize, PROT_READ | PROT_WRITE,
         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
     if (unlikely(x == MAP_FAILED)) {
       perror("mmap");
@@ -254,7 +357,7 @@ allocator::AllocateUnmanagedWithLock(regionctx &pc, size_t nhugepgs)
     INVARIANT(x == mypx);
     const int advice =
       UseMAdvWillNeed() ? MADV_HUGEPAGE | MADV_WILLNEED : MADV_HUGEPAGE;
-    if (madvise(x, hugepgsize, advice)) {
+    if (madvise(x, nhugepgs * hugepgsize, advice)) {
       perror("madvise");
       ALWAYS_ASSERT(false);
     }
@@ -266,9 +369,15 @@ allocator::AllocateUnmanagedWithLock(regionctx &pc, size_t nhugepgs)
 void
 allocator::ReleaseArenas(void **arenas)
 {
-  // cpu -> [(head, tail)]
+  struct arena_list {
+    arena_list() : head(nullptr), tail(nullptr), n(0) {}
+    void *head;
+    void *tail;
+    size_t n;
+  };
+  // cpu -> [(head, tail, n)]
   // XXX: use a small_map here?
-  std::map<size_t, static_vector<std::pair<void *, void *>, MAX_ARENAS>> m;
+  std::map<size_t, static_vector<arena_list, MAX_ARENAS>> m;
   for (size_t arena = 0; arena < MAX_ARENAS; arena++) {
     void *p = arenas[arena];
     while (p) {
@@ -279,16 +388,18 @@ allocator::ReleaseArenas(void **arenas)
         auto &v = m[cpu];
         v.resize(MAX_ARENAS);
         *reinterpret_cast<void **>(p) = nullptr;
-        v[arena].first = v[arena].second = p;
+        v[arena].head = v[arena].tail = p;
+        v[arena].n = 1;
       } else {
         auto &v = it->second;
-        if (!v[arena].second) {
+        if (!v[arena].tail) {
           *reinterpret_cast<void **>(p) = nullptr;
-          v[arena].first = v[arena].second = p;
+          v[arena].head = v[arena].tail = p;
         } else {
-          *reinterpret_cast<void **>(p) = v[arena].first;
-          v[arena].first = p;
+          *reinterpret_cast<void **>(p) = v[arena].head;
+          v[arena].head = p;
         }
+        v[arena].n++;
       }
       p = pnext;
     }
@@ -298,15 +409,128 @@ allocator::ReleaseArenas(void **arenas)
     regionctx &pc = g_regions[p.first];
     lock_guard<spinlock> l(pc.lock);
     for (size_t arena = 0; arena < MAX_ARENAS; arena++) {
-      INVARIANT(bool(p.second[arena].first) == bool(p.second[arena].second));
-      if (!p.second[arena].first)
+      INVARIANT(bool(p.second[arena].head) == bool(p.second[arena].tail));
+      if (!p.second[arena].head)
         continue;
-      *reinterpret_cast<void **>(p.second[arena].second) = pc.arenas[arena];
-      pc.arenas[arena] = p.second[arena].first;
+      *reinterpret_cast<void **>(p.second[arena].tail) = pc.arenas[arena];
+      pc.arenas[arena] = p.second[arena].head;
+      pc.narenas[arena] += p.second[arena].n;
     }
   }
 }
 
+std::vector<void *>
+allocator::ExtractFreeHugepages(
+    void *&head, void *&tail, size_t &nobjs, size_t unit)
+{
+  static const size_t hugepgsize = GetHugepageSize();
+
+  // hugepage -> # of its objects in the list
+  std::unordered_map<uintptr_t, size_t> counts;
+  tail = nullptr;
+  for (void *p = head; p; p = *reinterpret_cast<void **>(p)) {
+    counts[slow_round_down(uintptr_t(p), uintptr_t(hugepgsize))]++;
+    tail = p;
+  }
+
+  std::vector<void *> ret;
+  for (auto &c : counts) {
+    if (c.second != page_units((void *) c.first, hugepgsize, unit))
+      continue;
+    ret.push_back((void *) c.first);
+    c.second = 0;
+  }
+  if (ret.empty())
+    return ret;
+
+  void **tailp = &head;
+  tail = nullptr;
+  for (void *p = head; p;) {
+    void * const pnext = *reinterpret_cast<void **>(p);
+    if (counts[slow_round_down(uintptr_t(p), uintptr_t(hugepgsize))]) {
+      *tailp = p;
+      tailp = reinterpret_cast<void **>(p);
+      tail = p;
+    } else {
+      INVARIANT(nobjs);
+      nobjs--;
+    }
+    p = pnext;
+  }
+  *tailp = nullptr;
+  return ret;
+}
+
+size_t
+allocator::ReleaseIdleMemory()
+{
+  static const size_t hugepgsize = GetHugepageSize();
+  static std::mutex s_lock;
+  lock_guard<std::mutex> l0(s_lock);
+  size_t ret = 0;
+  for (size_t cpu = 0; cpu < g_ncpus; cpu++) {
+    regionctx &pc = g_regions[cpu];
+
+    // take the lists which could hold an entire hugepage, so we can walk
+    // them w/o holding the lock (allocations in the meantime take fresh
+    // hugepages)
+    void *lists[MAX_ARENAS];
+    void *tails[MAX_ARENAS];
+    size_t nobjs[MAX_ARENAS];
+    {
+      lock_guard<spinlock> l(pc.lock);
+      for (size_t arena = 0; arena < MAX_ARENAS; arena++) {
+        if (pc.narenas[arena] * ArenaAllocSize(arena) < hugepgsize) {
+          lists[arena] = nullptr;
+          nobjs[arena] = 0;
+          continue;
+        }
+        lists[arena] = pc.arenas[arena];
+        nobjs[arena] = pc.narenas[arena];
+        pc.arenas[arena] = nullptr;
+        pc.narenas[arena] = 0;
+      }
+    }
+
+    std::vector<void *> pgs;
+    for (size_t arena = 0; arena < MAX_ARENAS; arena++) {
+      if (!lists[arena])
+        continue;
+      const std::vector<void *> v = ExtractFreeHugepages(
+          lists[arena], tails[arena], nobjs[arena], ArenaAllocSize(arena));
+      pgs.insert(pgs.end(), v.begin(), v.end());
+    }
+    for (auto pg : pgs) {
+      if (madvise(pg, hugepgsize, MADV_DONTNEED)) {
+        perror("madvise");
+        ALWAYS_ASSERT(false);
+      }
+    }
+
+    lock_guard<spinlock> l(pc.lock);
+    for (size_t arena = 0; arena < MAX_ARENAS; arena++) {
+      if (!lists[arena])
+        continue;
+      *reinterpret_cast<void **>(tails[arena]) = pc.arenas[arena];
+      pc.arenas[arena] = lists[arena];
+      pc.narenas[arena] += nobjs[arena];
+    }
+    pc.released_hugepgs.insert(pc.released_hugepgs.end(), pgs.begin(), pgs.end());
+    ret += pgs.size() * hugepgsize;
+  }
+  evt_allocator_idle_released.inc(ret);
+  return ret;
+}
+
+void
+allocator::IdleReleaseLoop()
+{
+  for (;;) {
+    usleep(IdleReleaseIntervalMs * 1000);
+    ReleaseIdleMemory();
+  }
+}
+
 static void
 numa_hint_memory_placement(void *px, size_t sz, unsigned node)
 {
@@ -322,11 +546,11 @@ allocator::FaultRegion(size_t cpu)
   static const size_t hugepgsize = GetHugepageSize();
   ALWAYS_ASSERT(cpu < g_ncpus);
   regionctx &pc = g_regions[cpu];
-  if (pc.region_faulted)
+  if (pc.region_faulted_end >= pc.region_end)
     return;
   lock_guard<std::mutex> l1(pc.fault_lock);
   lock_guard<spinlock> l(pc.lock); // exclude other users of the allocator
-  if (pc.region_faulted)
+  if (pc.region_faulted_end >= pc.region_end)
     return;
   // mmap the entire region + memset it for faulting
   if (reinterpret_cast<uintptr_t>(pc.region_begin) % hugepgsize)
@@ -366,7 +590,7 @@ allocator::FaultRegion(size_t cpu)
     *px = 0xDE;
   std::cerr << "cpu" << cpu << " finished faulting region in "
             << t.lap_ms() << " ms" << std::endl;
-  pc.region_faulted = true;
+  pc.region_faulted_end = pc.region_end;
 }
 
 void *allocator::g_memstart = nullptr;
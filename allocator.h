@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <iterator>
 #include <mutex>
+#include <vector>
 
 #include "util.h"
 #include "core.h"
@@ -13,7 +14,10 @@
 class allocator {
 public:
 
-  // our allocator doesn't let allocations exceed maxpercore over a single core
+  // each core starts out with a region of maxpercore bytes. a core which
+  // exhausts its region grows it (by doubling) on demand, up to
+  // RegionGrowthFactor * maxpercore bytes. the address space for the fully
+  // grown regions is reserved (but not backed) up front
   //
   // Initialize can be called many times- but only the first call has effect.
   //
@@ -38,16 +42,78 @@ public:
   static void
   ReleaseArenas(void **arenas);
 
+  // returns the hugepages whose arena objects have all been released back
+  // to their core (see ReleaseArenas()) to the OS with MADV_DONTNEED. the
+  // address space stays with the core, and is reused before its region
+  // grows. returns the number of bytes released.
+  //
+  // Initialize() starts a thread which calls this every
+  // IdleReleaseIntervalMs, unless DISABLE_MADV_DONTNEED is set
+  static size_t
+  ReleaseIdleMemory();
+
+  // address space which the cores' regions currently span
+  static size_t
+  ReservedBytes();
+
+  // bytes of the cores' regions which have been handed out (or faulted by
+  // FaultRegion()), and not released by ReleaseIdleMemory()
+  static size_t
+  ResidentBytes();
+
+  static const size_t RegionGrowthFactor = 16;
+  static const uint64_t IdleReleaseIntervalMs = 1000;
+
   static const size_t LgAllocAlignment = 4; // all allocations aligned to 2^4 = 16
   static const size_t AllocAlignment = 1 << LgAllocAlignment;
-  static const size_t MAX_ARENAS = 32;
 
+  // arenas [0, NSmallArenas) serve sizes up to 512 bytes in AllocAlignment
+  // steps. above that, each power of two range (2^k, 2^(k+1)] is split into
+  // ArenasPerDoubling geometrically spaced size classes, up to
+  // MaxArenaAllocSize. anything larger is not served by the arenas
+  static const size_t NSmallArenas = 32;
+  static const size_t LgMaxSmallAllocSize = 9;
+  static const size_t LgArenasPerDoubling = 2;
+  static const size_t ArenasPerDoubling = 1 << LgArenasPerDoubling;
+  static const size_t LgMaxArenaAllocSize = 16;
+  static const size_t MaxArenaAllocSize = 1 << LgMaxArenaAllocSize;
+  static const size_t MAX_ARENAS =
+    NSmallArenas +
+    (LgMaxArenaAllocSize - LgMaxSmallAllocSize) * ArenasPerDoubling;
+
+  static_assert((NSmallArenas * AllocAlignment) == (1 << LgMaxSmallAllocSize),
+                "xx");
+
+  // returns (allocation size, arena) for an allocation of sz bytes. the
+  // arena is >= MAX_ARENAS if sz is too large to come from an arena, in which
+  // case the allocation size is just sz rounded up to AllocAlignment
   static inline std::pair<size_t, size_t>
   ArenaSize(size_t sz)
   {
     const size_t allocsz = util::round_up<size_t, LgAllocAlignment>(sz);
-    const size_t arena = allocsz / AllocAlignment - 1;
-    return std::make_pair(allocsz, arena);
+    if (likely(allocsz <= (NSmallArenas * AllocAlignment)))
+      return std::make_pair(allocsz, allocsz / AllocAlignment - 1);
+    if (unlikely(allocsz > MaxArenaAllocSize))
+      return std::make_pair(allocsz, MAX_ARENAS);
+    // allocsz is in (2^lg, 2^(lg+1)]
+    const size_t lg = 63 - __builtin_clzl(allocsz - 1);
+    const size_t lgstep = lg - LgArenasPerDoubling;
+    const size_t idx = ((allocsz - (1UL << lg) - 1) >> lgstep) + 1;
+    return std::make_pair(
+        (1UL << lg) + (idx << lgstep),
+        NSmallArenas + (lg - LgMaxSmallAllocSize) * ArenasPerDoubling + idx - 1);
+  }
+
+  // the size of the objects served by arena
+  static inline size_t
+  ArenaAllocSize(size_t arena)
+  {
+    INVARIANT(arena < MAX_ARENAS);
+    if (likely(arena < NSmallArenas))
+      return (arena + 1) * AllocAlignment;
+    const size_t a = arena - NSmallArenas;
+    const size_t lg = LgMaxSmallAllocSize + a / ArenasPerDoubling;
+    return (1UL << lg) + ((a % ArenasPerDoubling + 1) << (lg - LgArenasPerDoubling));
   }
 
   // slow, but only needs to be called on initialization
@@ -104,36 +170,59 @@ private:
   static size_t GetPageSizeImpl();
   static size_t GetHugepageSizeImpl();
   static bool UseMAdvWillNeed();
+  static bool UseMAdvDontNeed();
+
+  static void IdleReleaseLoop();
 
   struct regionctx {
     regionctx()
-      : region_begin(nullptr),
+      : region_start(nullptr),
+        region_begin(nullptr),
         region_end(nullptr),
-        region_faulted(false)
+        region_max(nullptr),
+        region_faulted_end(nullptr)
     {
       NDB_MEMSET(arenas, 0, sizeof(arenas));
+      NDB_MEMSET(narenas, 0, sizeof(narenas));
     }
     regionctx(const regionctx &) = delete;
     regionctx(regionctx &&) = delete;
     regionctx &operator=(const regionctx &) = delete;
 
-    // set by Initialize()
+    // set by Initialize(). [region_start, region_begin) has been handed out,
+    // [region_begin, region_end) is free, and [region_end, region_max) is
+    // reserved for growing the region
+    void *region_start;
     void *region_begin;
     void *region_end;
+    void *region_max;
 
-    bool region_faulted;
+    // [region_start, region_faulted_end) is mapped read/write
+    void *region_faulted_end;
 
     spinlock lock;
     std::mutex fault_lock; // XXX: hacky
     void *arenas[MAX_ARENAS];
+    size_t narenas[MAX_ARENAS]; // # of objects in arenas[i]
+
+    // hugepages returned to the OS by ReleaseIdleMemory(), which are handed
+    // out again before region_begin is advanced
+    std::vector<void *> released_hugepgs;
   };
 
+  // returns the hugepages in the arena list [head, tail] of objects of size
+  // unit which are fully free, and removes their objects from the list.
+  // head, tail and nobjs are updated to describe what is left of the list
+  static std::vector<void *>
+  ExtractFreeHugepages(void *&head, void *&tail, size_t &nobjs, size_t unit);
+
   // assumes caller has the regionctx lock held, and
   // will release the lock.
   static void *
   AllocateUnmanagedWithLock(regionctx &pc, size_t nhugepgs);
 
   // [g_memstart, g_memstart + ncpus * maxpercore) is the region of memory mmap()-ed
+  // (g_maxpercore is the fully grown size of a core's region)
   static void *g_memstart;
   static void *g_memend; // g_memstart + ncpus * maxpercore
   static size_t g_ncpus;
@@ -29,26 +29,44 @@ public:
   typedef transaction_base::string_type string_type;
   typedef concurrent_btree::string_type keystring_type;
 
+  // hashed backs the table w/ a hash index (see btree()), for tables which
+  // are never scanned
   base_txn_btree(size_type value_size_hint = 128,
             bool mostly_append = false,
-            const std::string &name = "<unknown>")
-    : value_size_hint(value_size_hint),
+            const std::string &name = "<unknown>",
+            bool hashed = false)
+    : mem_stats(index_mem_stats::ForName(name)),
+      underlying_btree(mostly_append, hashed,
+                       &mem_stats->node_bytes, &mem_stats->suffix_bytes),
+      value_size_hint(value_size_hint),
       name(name),
       been_destructed(false)
   {
     base_txn_btree_handler<Transaction>::on_construct();
+    transaction_base::RegisterTableName(&underlying_btree, name);
   }
 
   ~base_txn_btree()
   {
     if (!been_destructed)
       unsafe_purge(false);
+    transaction_base::UnregisterTableName(&underlying_btree);
   }
 
+  // counts tombstones which have not been unlinked yet as well (see
+  // btree::size_estimate())
   inline size_t
   size_estimate() const
   {
-    return underlying_btree.size();
+    return underlying_btree.size_estimate();
+  }
+
+  // boundaries of n key ranges of about the same size (see
+  // btree::key_quantiles())
+  inline std::vector<std::string>
+  key_quantiles(size_t n) const
+  {
+    return underlying_btree.key_quantiles(n);
   }
 
   inline size_type
@@ -63,6 +81,22 @@ public:
     this->value_size_hint = value_size_hint;
   }
 
+  // update size growth observed at commit time, used to leave room in
+  // freshly allocated tuples (see value_size_stats)
+  inline const value_size_stats &
+  get_value_size_stats() const
+  {
+    return size_stats;
+  }
+
+  // where the memory held by this table is accounted (tables w/ the same
+  // name share one)
+  inline const index_mem_stats &
+  get_mem_stats() const
+  {
+    return *mem_stats;
+  }
+
   inline void print() {
     underlying_btree.print();
   }
@@ -77,6 +111,61 @@ public:
    */
   std::map<std::string, uint64_t> unsafe_purge(bool dump_stats = false);
 
+  /**
+   * Builds the records for a bulk_load(). Each loader must be fed keys in
+   * strictly ascending order; the records are allocated at MIN_TID, so they
+   * are visible to every transaction once loaded.
+   *
+   * Neither threadsafe nor transactional: distinct loaders can be filled by
+   * distinct threads, but bulk_load() must only be called on an empty table
+   * with no concurrent accessors (ie during the initial load).
+   */
+  class bulk_loader {
+    friend class base_txn_btree;
+  public:
+    bulk_loader(base_txn_btree *btr) : btr(btr) {}
+
+    void
+    add(const std::string &k, const void *v, dbtuple::tuple_writer_t writer)
+    {
+      const size_t sz = writer(dbtuple::TUPLE_WRITER_COMPUTE_NEEDED, v, nullptr, 0);
+      ALWAYS_ASSERT(sz);
+      dbtuple * const tuple =
+        dbtuple::alloc_first(sz, false, btr->size_stats.slack(),
+                             btr->mem_stats->id());
+      tuple->write_value(v, writer, sz, 0);
+      tuple->version = dbtuple::MIN_TID;
+#if NDB_MASSTREE
+      // masstree has no bottom-up build, just insert directly
+      scoped_rcu_region guard;
+      ALWAYS_ASSERT(btr->underlying_btree.insert_if_absent(
+            varkey(k), (typename concurrent_btree::value_type) tuple));
+#else
+      builder.add(varkey(k), (typename concurrent_btree::value_type) tuple);
+#endif
+    }
+
+  private:
+    base_txn_btree *const btr;
+#if !NDB_MASSTREE
+    typename concurrent_btree::bulk_builder builder;
+#endif
+  };
+
+  // loaders must cover disjoint key ranges, in ascending order
+  void
+  bulk_load(const std::vector<bulk_loader *> &loaders)
+  {
+#if !NDB_MASSTREE
+    std::vector<typename concurrent_btree::bulk_builder *> builders;
+    for (auto l : loaders) {
+      INVARIANT(l->btr == this);
+      builders.push_back(&l->builder);
+    }
+    underlying_btree.bulk_load(builders);
+#endif
+  }
+
 private:
 
   struct purge_tree_walker : public concurrent_btree::tree_walk_callback {
@@ -145,18 +234,29 @@ protected:
   struct txn_search_range_callback : public concurrent_btree::low_level_search_range_callback {
     constexpr txn_search_range_callback(
           Transaction<Traits> *t,
+          const concurrent_btree *btr,
           Callback *caller_callback,
           KeyReader *key_reader,
           ValueReader *value_reader)
-      : t(t), caller_callback(caller_callback),
+      : t(t), btr(btr), caller_callback(caller_callback),
         key_reader(key_reader), value_reader(value_reader) {}
 
     virtual void on_resp_node(const typename concurrent_btree::node_opaque_t *n, uint64_t version);
     virtual bool invoke(const typename concurrent_btree::string_type &k, typename concurrent_btree::value_type v,
                         const typename concurrent_btree::node_opaque_t *n, uint64_t version);
 
+    // start fetching the headers of all the tuples in the leaf, which
+    // invoke() then reads one at a time
+    virtual void
+    on_leaf_values(const typename concurrent_btree::value_type *values, size_t n)
+    {
+      for (size_t i = 0; i < n; i++)
+        ::prefetch((const void *) values[i]);
+    }
+
   private:
     Transaction<Traits> *const t;
+    const concurrent_btree *const btr;
     Callback *const caller_callback;
     KeyReader *const key_reader;
     ValueReader *const value_reader;
@@ -168,6 +268,13 @@ protected:
             const typename P::Key &k,
             ValueReader &value_reader);
 
+  // do_search() w/ the key already encoded
+  template <typename Traits, typename ValueReader>
+  inline bool
+  do_search_key(Transaction<Traits> &t,
+                const std::string &key_str,
+                ValueReader &value_reader);
+
   template <typename Traits, typename Callback,
             typename KeyReader, typename ValueReader>
   inline void
@@ -200,7 +307,9 @@ protected:
                    dbtuple::tuple_writer_t writer,
                    bool expect_new);
 
+  index_mem_stats *const mem_stats;
   concurrent_btree underlying_btree;
+  value_size_stats size_stats;
   size_type value_size_hint;
   std::string name;
   bool been_destructed;
@@ -224,17 +333,30 @@ base_txn_btree<Transaction, P>::do_search(
   typename P::KeyWriter key_writer(&k);
   const std::string * const key_str =
     key_writer.fully_materialize(true, t.string_allocator());
+  return do_search_key(t, *key_str, value_reader);
+}
 
+template <template <typename> class Transaction, typename P>
+template <typename Traits, typename ValueReader>
+bool
+base_txn_btree<Transaction, P>::do_search_key(
+    Transaction<Traits> &t,
+    const std::string &key_str,
+    ValueReader &value_reader)
+{
   // search the underlying btree to map k=>(btree_node|tuple)
   typename concurrent_btree::value_type underlying_v{};
   concurrent_btree::versioned_node_t search_info;
-  const bool found = this->underlying_btree.search(varkey(*key_str), underlying_v, &search_info);
+  const bool found = this->underlying_btree.search(varkey(key_str), underlying_v, &search_info);
   if (found) {
     const dbtuple * const tuple = reinterpret_cast<const dbtuple *>(underlying_v);
-    return t.do_tuple_read(tuple, value_reader);
+    if (t.do_tuple_read(&this->underlying_btree, tuple, value_reader))
+      return true;
+    ++transaction_base::g_evt_read_logical_deleted_node_search;
+    return false;
   } else {
     // not found, add to absent_set
-    t.do_node_read(search_info.first, search_info.second);
+    t.do_node_read(&this->underlying_btree, search_info.first, search_info.second);
     return false;
   }
 }
@@ -332,6 +454,7 @@ void base_txn_btree<Transaction, P>::do_tree_put(
 
   if (unlikely(t.is_snapshot())) {
     const transaction_base::abort_reason r = transaction_base::ABORT_REASON_USER;
+    t.abort_btr = &this->underlying_btree;
     t.abort_impl(r);
     throw transaction_abort_exception(r);
   }
@@ -339,10 +462,12 @@ void base_txn_btree<Transaction, P>::do_tree_put(
   bool insert = false;
 retry:
   if (expect_new) {
-    auto ret = t.try_insert_new_tuple(this->underlying_btree, k, v, writer);
+    auto ret = t.try_insert_new_tuple(
+        this->underlying_btree, size_stats, mem_stats->id(), k, v, writer);
     INVARIANT(!ret.second || ret.first);
     if (unlikely(ret.second)) {
       const transaction_base::abort_reason r = transaction_base::ABORT_REASON_WRITE_NODE_INTERFERENCE;
+      t.abort_btr = &this->underlying_btree;
       t.abort_impl(r);
       throw transaction_abort_exception(r);
     }
@@ -365,7 +490,8 @@ retry:
   INVARIANT(px);
   if (!insert) {
     // add to write set normally, as non-insert
-    t.write_set.emplace_back(px, k, v, writer, &this->underlying_btree, false);
+    t.write_set.emplace_back(
+        px, k, v, writer, &this->underlying_btree, &size_stats, false);
   } else {
     // should already exist in write set as insert
     // (because of try_insert_new_tuple())
@@ -388,7 +514,7 @@ base_txn_btree<Transaction, P>
   VERBOSE(std::cerr << "on_resp_node(): <node=0x" << util::hexify(intptr_t(n))
                << ", version=" << version << ">" << std::endl);
   VERBOSE(std::cerr << "  " << concurrent_btree::NodeStringify(n) << std::endl);
-  t->do_node_read(n, version);
+  t->do_node_read(btr, n, version);
 }
 
 template <template <typename> class Transaction, typename P>
@@ -406,9 +532,10 @@ base_txn_btree<Transaction, P>
                     << ", version=" << version << ">" << std::endl
                     << "  " << *((dbtuple *) v) << std::endl);
   const dbtuple * const tuple = reinterpret_cast<const dbtuple *>(v);
-  if (t->do_tuple_read(tuple, *value_reader))
+  if (t->do_tuple_read(btr, tuple, *value_reader))
     return caller_callback->invoke(
         (*key_reader)(k), value_reader->results());
+  ++transaction_base::g_evt_read_logical_deleted_node_scan;
   return true;
 }
 
@@ -446,7 +573,7 @@ base_txn_btree<Transaction, P>::do_search_range_call(
     return;
 
   txn_search_range_callback<Traits, Callback, KeyReader, ValueReader> c(
-			&t, &callback, &key_reader, &value_reader);
+			&t, &this->underlying_btree, &callback, &key_reader, &value_reader);
 
   varkey uppervk;
   if (upper_str)
@@ -482,7 +609,7 @@ base_txn_btree<Transaction, P>::do_rsearch_range_call(
     return;
 
   txn_search_range_callback<Traits, Callback, KeyReader, ValueReader> c(
-			&t, &callback, &key_reader, &value_reader);
+			&t, &this->underlying_btree, &callback, &key_reader, &value_reader);
 
   varkey lowervk;
   if (lower_str)
@@ -67,6 +67,14 @@ public:
 
   virtual void reset_ntxn_persisted() { }
 
+  /**
+   * the name of the txn type (workload_desc name) the calling thread is
+   * about to run, so the db can attribute aborts to it.
+   *
+   * name must remain valid until the next call from this thread
+   */
+  virtual void set_txn_type_name(const char *name) {}
+
   enum TxnProfileHint {
     HINT_DEFAULT,
 
@@ -125,10 +133,21 @@ public:
 
   virtual void print_txn_debug(void *txn) const {}
 
+  /**
+   * If every key of the index is fixed_key_size bytes long, implementations
+   * may pick an index specialized for keys of that width (0 means keys
+   * vary in length)
+   *
+   * If the index is only ever accessed by key (get/put/insert/remove, never
+   * scan/rscan), point_lookups_only lets implementations back it by a hash
+   * index instead
+   */
   virtual abstract_ordered_index *
   open_index(const std::string &name,
              size_t value_size_hint,
-             bool mostly_append = false) = 0;
+             bool mostly_append = false,
+             size_t fixed_key_size = 0,
+             bool point_lookups_only = false) = 0;
 
   virtual void
   close_index(abstract_ordered_index *idx) = 0;
@@ -5,6 +5,7 @@
 #include <string>
 #include <utility>
 #include <map>
+#include <vector>
 
 #include "../macros.h"
 #include "../str_arena.h"
@@ -136,11 +137,53 @@ public:
     remove(txn, static_cast<const std::string &>(key));
   }
 
+  /**
+   * Accumulates (key, value) pairs, in strictly ascending key order, for a
+   * later bulk_load(). Not transactional.
+   */
+  class bulk_loader {
+  public:
+    virtual ~bulk_loader() {}
+    virtual void add(const std::string &key, const std::string &value) = 0;
+  };
+
+  /**
+   * Returns NULL if the index does not support bulk loading, in which case
+   * the caller should fall back to insert(). Caller owns the returned loader.
+   */
+  virtual bulk_loader *
+  new_bulk_loader()
+  {
+    return nullptr;
+  }
+
+  /**
+   * Installs the contents of loaders, which must cover disjoint key ranges
+   * given in ascending order. Only valid on an empty index with no
+   * concurrent accessors (ie in loading phase). Not thread safe.
+   */
+  virtual void
+  bulk_load(const std::vector<bulk_loader *> &loaders)
+  {
+  }
+
   /**
    * Only an estimate, not transactional!
    */
   virtual size_t size() const = 0;
 
+  /**
+   * Returns up to n - 1 keys in ascending order which split the index into
+   * n ranges of roughly the same size ([ret[i - 1], ret[i])), eg to
+   * partition a scan. Only an estimate, not transactional! The default
+   * returns no boundaries (a single range)
+   */
+  virtual std::vector<std::string>
+  key_quantiles(size_t n) const
+  {
+    return std::vector<std::string>();
+  }
+
   /**
    * Not thread safe for now
    */
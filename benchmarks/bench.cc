@@ -15,6 +15,7 @@
 #include "../counter.h"
 #include "../scopedperf.hh"
 #include "../allocator.h"
+#include "../tuple.h"
 
 #ifdef USE_JEMALLOC
 //cannot include this header b/c conflicts with malloc.h
@@ -104,6 +105,16 @@ write_cb(void *p, const char *s)
 
 static event_avg_counter evt_avg_abort_spins("avg_abort_spins");
 
+// counters created by the ndb abort attribution (see
+// transaction_base::SetTxnTypeName())
+static const string AbortBreakdownPrefix("abort_breakdown/");
+
+static inline bool
+starts_with(const string &s, const string &prefix)
+{
+  return s.compare(0, prefix.size(), prefix) == 0;
+}
+
 void
 bench_worker::run()
 {
@@ -124,13 +135,16 @@ bench_worker::run()
     double d = r.next_uniform();
     for (size_t i = 0; i < workload.size(); i++) {
       if ((i + 1) == workload.size() || d < workload[i].frequency) {
+        db->set_txn_type_name(workload[i].name.c_str());
       retry:
         timer t;
         const unsigned long old_seed = r.get_seed();
         const auto ret = workload[i].fn(this);
         if (likely(ret.first)) {
           ++ntxn_commits;
-          latency_numer_us += t.lap();
+          const uint64_t latency_us = t.lap();
+          latency_numer_us += latency_us;
+          latency_hist.add(latency_us);
           backoff_shifts >>= 1;
         } else {
           ++ntxn_aborts;
@@ -179,6 +193,7 @@ bench_runner::run()
       for (vector<bench_loader *>::const_iterator it = loaders.begin();
           it != loaders.end(); ++it)
         (*it)->join();
+      finish_loading();
     }
     const pair<uint64_t, uint64_t> mem_info_after = get_system_memory_info();
     const int64_t delta = int64_t(mem_info_before.first) - int64_t(mem_info_after.first); // free mem
@@ -197,6 +212,10 @@ bench_runner::run()
       cerr << persisted_info << " txns persisted in loading phase" << endl;
   }
   db->reset_ntxn_persisted();
+  if (verbose) {
+    cerr << "--- table memory (after loading) ---" << endl;
+    index_mem_stats::DumpAll(cerr);
+  }
 
   if (!no_reset_counters) {
     event_counter::reset_all_counters(); // XXX: for now - we really should have a before/after loading
@@ -247,10 +266,12 @@ bench_runner::run()
   size_t n_commits = 0;
   size_t n_aborts = 0;
   uint64_t latency_numer_us = 0;
+  log_histogram latency_hist;
   for (size_t i = 0; i < nthreads; i++) {
     n_commits += workers[i]->get_ntxn_commits();
     n_aborts += workers[i]->get_ntxn_aborts();
     latency_numer_us += workers[i]->get_latency_numer_us();
+    latency_hist.merge(workers[i]->get_latency_hist());
   }
   const auto persisted_info = db->get_ntxn_persisted();
 
@@ -337,16 +358,27 @@ bench_runner::run()
     cerr << "agg_persist_throughput: " << agg_persist_throughput << " ops/sec" << endl;
     cerr << "avg_per_core_persist_throughput: " << avg_per_core_persist_throughput << " ops/sec/core" << endl;
     cerr << "avg_latency: " << avg_latency_ms << " ms" << endl;
+    cerr << "p99_latency: " << latency_hist.percentile(0.99) / 1000.0 << " ms" << endl;
+    cerr << "p999_latency: " << latency_hist.percentile(0.999) / 1000.0 << " ms" << endl;
     cerr << "avg_persist_latency: " << avg_persist_latency_ms << " ms" << endl;
     cerr << "agg_abort_rate: " << agg_abort_rate << " aborts/sec" << endl;
     cerr << "avg_per_core_abort_rate: " << avg_per_core_abort_rate << " aborts/sec/core" << endl;
     cerr << "txn breakdown: " << format_list(agg_txn_counts.begin(), agg_txn_counts.end()) << endl;
+    cerr << "--- abort breakdown (txn type/reason/table) ---" << endl;
+    for (map<string, counter_data>::iterator it = ctrs.begin();
+         it != ctrs.end(); ++it)
+      if (starts_with(it->first, AbortBreakdownPrefix) && it->second.count_)
+        cerr << it->first.substr(AbortBreakdownPrefix.size()) << ": "
+             << it->second.count_ << " aborts" << endl;
     cerr << "--- system counters (for benchmark) ---" << endl;
     for (map<string, counter_data>::iterator it = ctrs.begin();
          it != ctrs.end(); ++it)
-      cerr << it->first << ": " << it->second << endl;
+      if (!starts_with(it->first, AbortBreakdownPrefix))
+        cerr << it->first << ": " << it->second << endl;
     cerr << "--- perf counters (if enabled, for benchmark) ---" << endl;
     PERF_EXPR(scopedperf::perfsum_base::printall());
+    cerr << "--- table memory ---" << endl;
+    index_mem_stats::DumpAll(cerr);
     cerr << "--- allocator stats ---" << endl;
     ::allocator::DumpStats();
     cerr << "---------------------------------------" << endl;
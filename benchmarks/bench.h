@@ -150,6 +150,13 @@ public:
 
   inline uint64_t get_latency_numer_us() const { return latency_numer_us; }
 
+  // commit latencies, in usec
+  inline const util::log_histogram &
+  get_latency_hist() const
+  {
+    return latency_hist;
+  }
+
   inline double
   get_avg_latency_us() const
   {
@@ -189,6 +196,7 @@ private:
   size_t ntxn_commits;
   size_t ntxn_aborts;
   uint64_t latency_numer_us;
+  util::log_histogram latency_hist;
   unsigned backoff_shifts;
 
 protected:
@@ -224,6 +232,10 @@ protected:
   // only called once
   virtual std::vector<bench_worker*> make_workers() = 0;
 
+  // called once all loaders have finished, still within the data loading
+  // phase (ie before any workers are started)
+  virtual void finish_loading() {}
+
   abstract_db *const db;
   std::map<std::string, abstract_ordered_index *> open_tables;
 
@@ -0,0 +1,228 @@
+/**
+ * btree_fanout: sweeps the btree node fanout (NKeysPerNode) against
+ * insert, point lookup and range scan throughput, for tree sizes from
+ * --min-keys to --max-keys (growing by 10x each step).
+ *
+ * The fanout is a compile time parameter of the btree, so only the
+ * fanouts instantiated below (15/31/63) can be selected with --fanouts.
+ * Single threaded; always uses the silo btree (regardless of MASSTREE).
+ *
+ * Keys are all 8 bytes, so each fanout is run both with the generic tree
+ * and with the fixed width key tree (fixed_key_btree_traits), unless
+ * --generic-only is given.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include "../macros.h"
+#include "../btree.h"
+#include "../btree_impl.h"
+#include "../thread.h"
+#include "../util.h"
+
+using namespace std;
+using namespace util;
+
+template <unsigned int NKeys>
+struct fanout_btree_traits : public concurrent_btree_fanout_traits<NKeys> {
+  static const bool RcuRespCaller = false;
+};
+
+template <unsigned int NKeys, bool FixedKeys>
+struct sweep_btree_traits {
+  typedef fanout_btree_traits<NKeys> type;
+};
+
+template <unsigned int NKeys>
+struct sweep_btree_traits<NKeys, true> {
+  typedef fixed_key_btree_traits<fanout_btree_traits<NKeys>> type;
+};
+
+static size_t min_keys = 1000000;
+static size_t max_keys = 1000000000;
+static size_t nlookups = 10000000;
+static size_t nscans = 1000000;
+static size_t scan_length = 100;
+static bool generic_only = false;
+
+// bijection on [0, 2^64), so keys are inserted in a random order but are
+// still unique
+static inline uint64_t
+permute(uint64_t i)
+{
+  return i * 0x9e3779b97f4a7c15ULL;
+}
+
+template <typename Btree>
+class scan_counter : public Btree::search_range_callback {
+public:
+  scan_counter(size_t limit) : n(0), limit(limit) {}
+  virtual bool
+  invoke(const typename Btree::string_type &k, typename Btree::value_type v)
+  {
+    return ++n < limit;
+  }
+  size_t n;
+private:
+  const size_t limit;
+};
+
+static inline double
+rate(size_t n, uint64_t usec)
+{
+  return double(n) / (double(usec) / 1000000.0);
+}
+
+template <unsigned int NKeys, bool FixedKeys>
+static void
+sweep()
+{
+  typedef btree<typename sweep_btree_traits<NKeys, FixedKeys>::type> btree_type;
+  typedef typename btree_type::value_type value_type;
+
+  for (size_t nkeys = min_keys; nkeys <= max_keys; nkeys *= 10) {
+    btree_type btr;
+    fast_random r(9837123 + nkeys);
+
+    timer t;
+    for (size_t i = 0; i < nkeys; i++) {
+      const uint64_t k = permute(i);
+      btr.insert(u64_varkey(k), (value_type) k);
+    }
+    const double insert_rate = rate(nkeys, t.lap());
+
+    t.lap();
+    for (size_t i = 0; i < nlookups; i++) {
+      const uint64_t k = permute(r.next() % nkeys);
+      value_type v = 0;
+      ALWAYS_ASSERT(btr.search(u64_varkey(k), v));
+      ALWAYS_ASSERT(v == (value_type) k);
+    }
+    const double lookup_rate = rate(nlookups, t.lap());
+
+    size_t nscanned = 0;
+    t.lap();
+    for (size_t i = 0; i < nscans; i++) {
+      scan_counter<btree_type> c(scan_length);
+      btr.search_range_call(u64_varkey(permute(r.next() % nkeys)), nullptr, c);
+      nscanned += c.n;
+    }
+    const uint64_t scan_usec = t.lap();
+
+    cout << "fanout " << NKeys
+         << " keys " << (FixedKeys ? "fixed" : "generic")
+         << " nkeys " << nkeys
+         << " insert " << insert_rate << " ops/sec"
+         << " lookup " << lookup_rate << " ops/sec"
+         << " scan " << rate(nscans, scan_usec) << " ops/sec"
+         << " (" << rate(nscanned, scan_usec) << " keys/sec)"
+         << endl;
+  }
+}
+
+class sweep_thread : public ndb_thread {
+public:
+  sweep_thread(const vector<unsigned> &fanouts)
+    : ndb_thread(false, string("btree_fanout")), fanouts(fanouts) {}
+
+  virtual void
+  run()
+  {
+    for (auto f : fanouts) {
+      switch (f) {
+      case 15:
+        sweep<15, false>();
+        if (!generic_only)
+          sweep<15, true>();
+        break;
+      case 31:
+        sweep<31, false>();
+        if (!generic_only)
+          sweep<31, true>();
+        break;
+      case 63:
+        sweep<63, false>();
+        if (!generic_only)
+          sweep<63, true>();
+        break;
+      default:
+        cerr << "unsupported fanout: " << f << " (must be one of 15,31,63)" << endl;
+        ALWAYS_ASSERT(false);
+      }
+    }
+  }
+
+private:
+  const vector<unsigned> fanouts;
+};
+
+int
+main(int argc, char **argv)
+{
+  vector<unsigned> fanouts = {15, 31, 63};
+  while (1) {
+    static struct option long_options[] =
+    {
+      {"fanouts"     , required_argument , 0 , 'f'} ,
+      {"min-keys"    , required_argument , 0 , 'm'} ,
+      {"max-keys"    , required_argument , 0 , 'M'} ,
+      {"lookups"     , required_argument , 0 , 'l'} ,
+      {"scans"       , required_argument , 0 , 's'} ,
+      {"scan-length" , required_argument , 0 , 'L'} ,
+      {"generic-only", no_argument       , 0 , 'g'} ,
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "f:m:M:l:s:L:g", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+    case 'f':
+      fanouts = ParseCSVString<unsigned, RangeAwareParser<unsigned>>(optarg);
+      break;
+
+    case 'm':
+      min_keys = strtoul(optarg, NULL, 10);
+      ALWAYS_ASSERT(min_keys > 0);
+      break;
+
+    case 'M':
+      max_keys = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'l':
+      nlookups = strtoul(optarg, NULL, 10);
+      break;
+
+    case 's':
+      nscans = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'L':
+      scan_length = strtoul(optarg, NULL, 10);
+      ALWAYS_ASSERT(scan_length > 0);
+      break;
+
+    case 'g':
+      generic_only = true;
+      break;
+
+    case '?':
+      /* getopt_long already printed an error message. */
+      exit(1);
+
+    default:
+      abort();
+    }
+  }
+
+  sweep_thread t(fanouts);
+  t.start();
+  t.join();
+  return 0;
+}
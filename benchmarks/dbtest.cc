@@ -73,6 +73,7 @@ main(int argc, char **argv)
   int fake_writes = 0;
   int disable_gc = 0;
   int disable_snapshots = 0;
+  size_t gc_threads = 0;
   vector<string> logfiles;
   vector<vector<unsigned>> assignments;
   string stats_server_sockfile;
@@ -102,12 +103,13 @@ main(int argc, char **argv)
       {"log-fake-writes"            , no_argument       , &fake_writes               , 1}   ,
       {"disable-gc"                 , no_argument       , &disable_gc                , 1}   ,
       {"disable-snapshots"          , no_argument       , &disable_snapshots         , 1}   ,
+      {"gc-threads"                 , required_argument , 0                          , 'g'} , // per NUMA node
       {"stats-server-sockfile"      , required_argument , 0                          , 'x'} ,
       {"no-reset-counters"          , no_argument       , &no_reset_counters         , 1}   ,
       {0, 0, 0, 0}
     };
     int option_index = 0;
-    int c = getopt_long(argc, argv, "b:s:t:d:B:f:r:n:o:m:l:a:x:", long_options, &option_index);
+    int c = getopt_long(argc, argv, "b:s:t:d:B:f:r:n:o:m:l:a:x:g:", long_options, &option_index);
     if (c == -1)
       break;
 
@@ -185,6 +187,11 @@ main(int argc, char **argv)
       stats_server_sockfile = optarg;
       break;
 
+    case 'g':
+      gc_threads = strtoul(optarg, NULL, 10);
+      ALWAYS_ASSERT(gc_threads > 0);
+      break;
+
     case '?':
       /* getopt_long already printed an error message. */
       exit(1);
@@ -275,6 +282,12 @@ main(int argc, char **argv)
   }
 #endif
 
+  if (gc_threads && db_type != "ndb-proto2") {
+    cerr << "[ERROR] benchmark " << db_type
+         << " does not have background gc" << endl;
+    return 1;
+  }
+
   if (db_type == "bdb") {
     const string cmd = "rm -rf " + basedir + "/db/*";
     // XXX(stephentu): laziness
@@ -302,6 +315,8 @@ main(int argc, char **argv)
     if (disable_snapshots)
       transaction_proto2_static::DisableSnapshots();
 #endif
+    if (gc_threads)
+      transaction_proto2_static::StartBackgroundGC(gc_threads);
   } else if (db_type == "kvdb") {
     db = new kvdb_wrapper<true>;
   } else if (db_type == "kvdb-st") {
@@ -370,6 +385,7 @@ main(int argc, char **argv)
     cerr << "  assignments : " << assignments               << endl;
     cerr << "  disable-gc : " << disable_gc                 << endl;
     cerr << "  disable-snapshots : " << disable_snapshots   << endl;
+    cerr << "  gc-threads : " << gc_threads                 << endl;
     cerr << "  stats-server-sockfile: " << stats_server_sockfile << endl;
 
     cerr << "system properties:" << endl;
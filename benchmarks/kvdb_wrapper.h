@@ -40,7 +40,9 @@ public:
   virtual abstract_ordered_index *
   open_index(const std::string &name,
              size_t value_size_hint,
-             bool mostly_append);
+             bool mostly_append,
+             size_t fixed_key_size,
+             bool point_lookups_only);
 
   virtual void
   close_index(abstract_ordered_index *idx)
@@ -49,7 +51,8 @@ public:
   }
 };
 
-template <bool UseConcurrencyControl>
+// FixedKeys indexes only hold 8 byte keys (see fixed_key_btree_traits)
+template <bool UseConcurrencyControl, bool FixedKeys = false>
 class kvdb_ordered_index : public abstract_ordered_index {
 public:
   kvdb_ordered_index(const std::string &name)
@@ -88,8 +91,10 @@ private:
   typedef
     typename std::conditional<
       UseConcurrencyControl,
-      concurrent_btree,
-      single_threaded_btree>::type
+      typename std::conditional<
+        FixedKeys, concurrent_fixed_key_btree, concurrent_btree>::type,
+      typename std::conditional<
+        FixedKeys, single_threaded_fixed_key_btree, single_threaded_btree>::type>::type
     my_btree;
   typedef typename my_btree::key_type key_type;
   my_btree btr;
@@ -309,9 +309,9 @@ public:
 
 } PACKED;
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 bool
-kvdb_ordered_index<UseConcurrencyControl>::get(
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::get(
     void *txn,
     const std::string &key,
     std::string &value, size_t max_bytes_read)
@@ -329,9 +329,9 @@ kvdb_ordered_index<UseConcurrencyControl>::get(
   return false;
 }
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 const char *
-kvdb_ordered_index<UseConcurrencyControl>::put(
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::put(
     void *txn,
     const std::string &key,
     const std::string &value)
@@ -362,9 +362,9 @@ kvdb_ordered_index<UseConcurrencyControl>::put(
   return 0;
 }
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 const char *
-kvdb_ordered_index<UseConcurrencyControl>::insert(void *txn,
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::insert(void *txn,
                            const std::string &key,
                            const std::string &value)
 {
@@ -404,9 +404,9 @@ private:
   str_arena *arena;
 };
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 void
-kvdb_ordered_index<UseConcurrencyControl>::scan(
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::scan(
     void *txn,
     const std::string &start_key,
     const std::string *end_key,
@@ -419,9 +419,9 @@ kvdb_ordered_index<UseConcurrencyControl>::scan(
   btr.search_range_call(key_type(start_key), end_key ? &end : 0, c, arena->next());
 }
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 void
-kvdb_ordered_index<UseConcurrencyControl>::rscan(
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::rscan(
     void *txn,
     const std::string &start_key,
     const std::string *end_key,
@@ -434,9 +434,9 @@ kvdb_ordered_index<UseConcurrencyControl>::rscan(
   btr.rsearch_range_call(key_type(start_key), end_key ? &end : 0, c, arena->next());
 }
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 void
-kvdb_ordered_index<UseConcurrencyControl>::remove(void *txn, const std::string &key)
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::remove(void *txn, const std::string &key)
 {
   typedef basic_kvdb_record<UseConcurrencyControl> kvdb_record;
   ANON_REGION("kvdb_ordered_index::remove:", &private_::kvdb_remove_probe0_cg);
@@ -447,9 +447,9 @@ kvdb_ordered_index<UseConcurrencyControl>::remove(void *txn, const std::string &
   }
 }
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 size_t
-kvdb_ordered_index<UseConcurrencyControl>::size() const
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::size() const
 {
   return btr.size();
 }
@@ -531,9 +531,9 @@ private:
   std::vector<std::pair<typename Btree::value_type, bool>> spec_values;
 };
 
-template <bool UseConcurrencyControl>
+template <bool UseConcurrencyControl, bool FixedKeys>
 std::map<std::string, uint64_t>
-kvdb_ordered_index<UseConcurrencyControl>::clear()
+kvdb_ordered_index<UseConcurrencyControl, FixedKeys>::clear()
 {
 
   purge_tree_walker<my_btree, UseConcurrencyControl> w;
@@ -550,8 +550,11 @@ kvdb_ordered_index<UseConcurrencyControl>::clear()
 template <bool UseConcurrencyControl>
 abstract_ordered_index *
 kvdb_wrapper<UseConcurrencyControl>::open_index(
-    const std::string &name, size_t value_size_hint, bool mostly_append)
+    const std::string &name, size_t value_size_hint, bool mostly_append,
+    size_t fixed_key_size, bool point_lookups_only)
 {
+  if (fixed_key_size == 8)
+    return new kvdb_ordered_index<UseConcurrencyControl, true>(name);
   return new kvdb_ordered_index<UseConcurrencyControl>(name);
 }
 
@@ -0,0 +1,168 @@
+/**
+ * large_values: measures write (overwrite) and point read throughput of
+ * txn_btree values from 1KB to 4MB. Values larger than
+ * dbtuple::MaxInlineValueSize are stored out of line in chunks, so the
+ * sizes straddle both representations.
+ *
+ * For each value size, --total-bytes worth of keys (at least one) is
+ * loaded, then every key is overwritten --write-rounds times, then
+ * --reads random keys are read back. Single threaded, one key per txn.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include "../macros.h"
+#include "../txn.h"
+#include "../txn_proto2_impl.h"
+#include "../txn_btree.h"
+#include "../thread.h"
+#include "../util.h"
+
+using namespace std;
+using namespace util;
+
+static size_t total_bytes = 256 << 20;
+static size_t write_rounds = 4;
+static size_t nreads = 10000;
+
+static inline double
+rate(size_t n, uint64_t usec)
+{
+  return double(n) / (double(usec) / 1000000.0);
+}
+
+static inline double
+mb_rate(size_t nbytes, uint64_t usec)
+{
+  return rate(nbytes, usec) / double(1 << 20);
+}
+
+static void
+run_size(size_t sz)
+{
+  typedef transaction_proto2<default_transaction_traits> txn_type;
+  const size_t nkeys = max(total_bytes / sz, size_t(1));
+  txn_btree<transaction_proto2> btr(sz);
+  default_transaction_traits::StringAllocator arena;
+  fast_random r(8544290 + sz);
+
+  string v(sz, 0);
+  for (size_t i = 0; i < sz; i++)
+    v[i] = char(r.next());
+
+  for (size_t i = 0; i < nkeys; i++) {
+    txn_type t(0, arena);
+    btr.insert(t, u64_varkey(i), (const uint8_t *) v.data(), v.size());
+    ALWAYS_ASSERT(t.commit(false));
+  }
+
+  timer tm;
+  for (size_t round = 0; round < write_rounds; round++) {
+    v[round % sz]++;
+    for (size_t i = 0; i < nkeys; i++) {
+      txn_type t(0, arena);
+      btr.insert(t, u64_varkey(i), (const uint8_t *) v.data(), v.size());
+      ALWAYS_ASSERT(t.commit(false));
+    }
+  }
+  const size_t nwrites = write_rounds * nkeys;
+  const uint64_t write_usec = tm.lap();
+
+  size_t nread_bytes = 0;
+  for (size_t i = 0; i < nreads; i++) {
+    txn_type t(0, arena);
+    string out;
+    ALWAYS_ASSERT(btr.search(t, u64_varkey(r.next() % nkeys), out));
+    ALWAYS_ASSERT(t.commit(false));
+    nread_bytes += out.size();
+  }
+  const uint64_t read_usec = tm.lap();
+  ALWAYS_ASSERT(nread_bytes == nreads * sz);
+
+  cout << "value_size " << sz
+       << " (" << (sz > dbtuple::MaxInlineValueSize ? "chunked" : "inline") << ")"
+       << " nkeys " << nkeys
+       << " write " << rate(nwrites, write_usec) << " ops/sec"
+       << " (" << mb_rate(nwrites * sz, write_usec) << " MB/sec)"
+       << " read " << rate(nreads, read_usec) << " ops/sec"
+       << " (" << mb_rate(nread_bytes, read_usec) << " MB/sec)"
+       << endl;
+
+  txn_epoch_sync<transaction_proto2>::sync();
+}
+
+class large_values_thread : public ndb_thread {
+public:
+  large_values_thread(const vector<size_t> &sizes)
+    : ndb_thread(false, string("large_values")), sizes(sizes) {}
+
+  virtual void
+  run()
+  {
+    for (auto sz : sizes)
+      run_size(sz);
+    txn_epoch_sync<transaction_proto2>::finish();
+  }
+
+private:
+  const vector<size_t> sizes;
+};
+
+int
+main(int argc, char **argv)
+{
+  vector<size_t> sizes =
+    {1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20};
+  while (1) {
+    static struct option long_options[] =
+    {
+      {"sizes"        , required_argument , 0 , 's'} ,
+      {"total-bytes"  , required_argument , 0 , 'b'} ,
+      {"write-rounds" , required_argument , 0 , 'w'} ,
+      {"reads"        , required_argument , 0 , 'r'} ,
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "s:b:w:r:", long_options, &option_index);
+    if (c == -1)
+      break;
+
+    switch (c) {
+    case 's':
+      sizes = ParseCSVString<size_t, RangeAwareParser<size_t>>(optarg);
+      break;
+
+    case 'b':
+      total_bytes = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'w':
+      write_rounds = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'r':
+      nreads = strtoul(optarg, NULL, 10);
+      ALWAYS_ASSERT(nreads > 0);
+      break;
+
+    case '?':
+      /* getopt_long already printed an error message. */
+      exit(1);
+
+    default:
+      abort();
+    }
+  }
+
+  for (auto sz : sizes)
+    ALWAYS_ASSERT(sz > 0);
+
+  large_values_thread t(sizes);
+  t.start();
+  t.join();
+  return 0;
+}
@@ -27,7 +27,9 @@ public:
   virtual abstract_ordered_index *
   open_index(const std::string &name,
              size_t value_size_hint,
-             bool mostly_append);
+             bool mostly_append,
+             size_t fixed_key_size,
+             bool point_lookups_only);
 
   virtual void
   close_index(abstract_ordered_index *idx);
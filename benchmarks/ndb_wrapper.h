@@ -84,6 +84,12 @@ public:
     txn_epoch_sync<Transaction>::reset_ntxn_persisted();
   }
 
+  virtual void
+  set_txn_type_name(const char *name)
+  {
+    transaction_base::SetTxnTypeName(name);
+  }
+
   virtual size_t
   sizeof_txn_object(uint64_t txn_flags) const;
 
@@ -100,7 +106,9 @@ public:
   virtual abstract_ordered_index *
   open_index(const std::string &name,
              size_t value_size_hint,
-             bool mostly_append);
+             bool mostly_append,
+             size_t fixed_key_size,
+             bool point_lookups_only);
 
   virtual void
   close_index(abstract_ordered_index *idx);
@@ -115,7 +123,8 @@ protected:
     using cast = private_::cast_base<Transaction, Traits>;
 
 public:
-  ndb_ordered_index(const std::string &name, size_t value_size_hint, bool mostly_append);
+  ndb_ordered_index(const std::string &name, size_t value_size_hint,
+                    bool mostly_append, bool point_lookups_only);
   virtual bool get(
       void *txn,
       const std::string &key,
@@ -154,9 +163,19 @@ public:
   virtual void remove(
       void *txn,
       std::string &&key);
+  virtual bulk_loader *new_bulk_loader();
+  virtual void bulk_load(const std::vector<bulk_loader *> &loaders);
   virtual size_t size() const;
+  virtual std::vector<std::string> key_quantiles(size_t n) const;
   virtual std::map<std::string, uint64_t> clear();
 private:
+  class ndb_bulk_loader : public bulk_loader {
+  public:
+    ndb_bulk_loader(txn_btree<Transaction> *btr) : loader(btr) {}
+    virtual void add(const std::string &key, const std::string &value);
+    typename txn_btree<Transaction>::bulk_loader loader;
+  };
+
   std::string name;
   txn_btree<Transaction> btr;
 };
@@ -278,9 +278,12 @@ ndb_wrapper<Transaction>::get_txn_counters(void *txn) const
 
 template <template <typename> class Transaction>
 abstract_ordered_index *
-ndb_wrapper<Transaction>::open_index(const std::string &name, size_t value_size_hint, bool mostly_append)
+ndb_wrapper<Transaction>::open_index(const std::string &name, size_t value_size_hint, bool mostly_append, size_t fixed_key_size, bool point_lookups_only)
 {
-  return new ndb_ordered_index<Transaction>(name, value_size_hint, mostly_append);
+  // transactions (read/write sets, GC) only know about concurrent_btree, so
+  // fixed width keys still go through the generic tree here. hash indexes
+  // are a mode of concurrent_btree, so they are fine
+  return new ndb_ordered_index<Transaction>(name, value_size_hint, mostly_append, point_lookups_only);
 }
 
 template <template <typename> class Transaction>
@@ -292,8 +295,9 @@ ndb_wrapper<Transaction>::close_index(abstract_ordered_index *idx)
 
 template <template <typename> class Transaction>
 ndb_ordered_index<Transaction>::ndb_ordered_index(
-    const std::string &name, size_t value_size_hint, bool mostly_append)
-  : name(name), btr(value_size_hint, mostly_append, name)
+    const std::string &name, size_t value_size_hint, bool mostly_append,
+    bool point_lookups_only)
+  : name(name), btr(value_size_hint, mostly_append, name, point_lookups_only)
 {
   // for debugging
   //std::cerr << name << " : btree= "
@@ -580,6 +584,32 @@ ndb_ordered_index<Transaction>::remove(void *txn, std::string &&key)
   }
 }
 
+template <template <typename> class Transaction>
+void
+ndb_ordered_index<Transaction>::ndb_bulk_loader::add(
+    const std::string &key, const std::string &value)
+{
+  loader.add(key, &value, txn_btree_::tuple_writer);
+}
+
+template <template <typename> class Transaction>
+abstract_ordered_index::bulk_loader *
+ndb_ordered_index<Transaction>::new_bulk_loader()
+{
+  return new ndb_bulk_loader(&btr);
+}
+
+template <template <typename> class Transaction>
+void
+ndb_ordered_index<Transaction>::bulk_load(
+    const std::vector<bulk_loader *> &loaders)
+{
+  std::vector<typename txn_btree<Transaction>::bulk_loader *> ls;
+  for (auto l : loaders)
+    ls.push_back(&static_cast<ndb_bulk_loader *>(l)->loader);
+  btr.bulk_load(ls);
+}
+
 template <template <typename> class Transaction>
 size_t
 ndb_ordered_index<Transaction>::size() const
@@ -587,6 +617,13 @@ ndb_ordered_index<Transaction>::size() const
   return btr.size_estimate();
 }
 
+template <template <typename> class Transaction>
+std::vector<std::string>
+ndb_ordered_index<Transaction>::key_quantiles(size_t n) const
+{
+  return btr.key_quantiles(n);
+}
+
 template <template <typename> class Transaction>
 std::map<std::string, uint64_t>
 ndb_ordered_index<Transaction>::clear()
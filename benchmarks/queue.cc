@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 
 #include "../macros.h"
 #include "../varkey.h"
@@ -19,6 +20,7 @@ using namespace std;
 using namespace util;
 
 static size_t nkeys;
+static int g_consume = 0;
 
 static inline string
 queue_key(uint64_t id0, uint64_t id1)
@@ -291,6 +293,40 @@ queue_do_test(abstract_db *db, int argc, char **argv)
 {
   nkeys = size_t(scale_factor * 1000.0);
   ALWAYS_ASSERT(nkeys > 0);
-  queue_bench_runner r(db, true);
+
+  // parse options
+  optind = 1;
+  while (1) {
+    static struct option long_options[] = {
+      {"consume" , no_argument , &g_consume , 1},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "", long_options, &option_index);
+    if (c == -1)
+      break;
+    switch (c) {
+    case 0:
+      if (long_options[option_index].flag != 0)
+        break;
+      abort();
+      break;
+
+    case '?':
+      /* getopt_long already printed an error message. */
+      exit(1);
+
+    default:
+      abort();
+    }
+  }
+
+  if (verbose)
+    cerr << "queue settings:" << endl
+         << "  consume: " << g_consume << endl;
+
+  // by default every worker only produces; with --consume, half of the
+  // workers drain the queues (scanning from the head) instead
+  queue_bench_runner r(db, !g_consume);
   r.run();
 }
@@ -144,6 +144,7 @@ static int g_disable_xpartition_txn = 0;
 static int g_disable_read_only_scans = 0;
 static int g_enable_partition_locks = 0;
 static int g_enable_separate_tree_per_partition = 0;
+static int g_enable_hash_indexes = 0;
 static int g_new_order_remote_item_pct = 1;
 static int g_new_order_fast_id_gen = 0;
 static int g_uniform_item_dist = 0;
@@ -1981,8 +1982,26 @@ private:
   static bool
   IsTableAppendOnly(const char *name)
   {
+    // keys grow monotonically per district (or per customer), new_order
+    // only ever removes from the front
     return strcmp("history", name) == 0 ||
-           strcmp("oorder_c_id_idx", name) == 0;
+           strcmp("new_order", name) == 0 ||
+           strcmp("oorder", name) == 0 ||
+           strcmp("oorder_c_id_idx", name) == 0 ||
+           strcmp("order_line", name) == 0;
+  }
+
+  static bool
+  IsTablePointLookupsOnly(const char *name)
+  {
+    // never scanned, and (mostly) loaded up front, so they can be hash
+    // indexes
+    return strcmp("customer", name) == 0 ||
+           strcmp("district", name) == 0 ||
+           strcmp("item", name) == 0 ||
+           strcmp("stock", name) == 0 ||
+           strcmp("stock_data", name) == 0 ||
+           strcmp("warehouse", name) == 0;
   }
 
   static vector<abstract_ordered_index *>
@@ -1990,12 +2009,15 @@ private:
   {
     const bool is_read_only = IsTableReadOnly(name);
     const bool is_append_only = IsTableAppendOnly(name);
+    const bool is_point_lookups_only =
+      g_enable_hash_indexes && IsTablePointLookupsOnly(name);
     const string s_name(name);
     vector<abstract_ordered_index *> ret(NumWarehouses());
     if (g_enable_separate_tree_per_partition && !is_read_only) {
       if (NumWarehouses() <= nthreads) {
         for (size_t i = 0; i < NumWarehouses(); i++)
-          ret[i] = db->open_index(s_name + "_" + to_string(i), expected_size, is_append_only);
+          ret[i] = db->open_index(s_name + "_" + to_string(i), expected_size, is_append_only,
+                                  0, is_point_lookups_only);
       } else {
         const unsigned nwhse_per_partition = NumWarehouses() / nthreads;
         for (size_t partid = 0; partid < nthreads; partid++) {
@@ -2003,13 +2025,15 @@ private:
           const unsigned wend   = (partid + 1 == nthreads) ?
             NumWarehouses() : (partid + 1) * nwhse_per_partition;
           abstract_ordered_index *idx =
-            db->open_index(s_name + "_" + to_string(partid), expected_size, is_append_only);
+            db->open_index(s_name + "_" + to_string(partid), expected_size, is_append_only,
+                           0, is_point_lookups_only);
           for (size_t i = wstart; i < wend; i++)
             ret[i] = idx;
         }
       }
     } else {
-      abstract_ordered_index *idx = db->open_index(s_name, expected_size, is_append_only);
+      abstract_ordered_index *idx =
+        db->open_index(s_name, expected_size, is_append_only, 0, is_point_lookups_only);
       for (size_t i = 0; i < NumWarehouses(); i++)
         ret[i] = idx;
     }
@@ -2141,6 +2165,7 @@ tpcc_do_test(abstract_db *db, int argc, char **argv)
       {"disable-read-only-snapshots"          , no_argument       , &g_disable_read_only_scans            , 1}   ,
       {"enable-partition-locks"               , no_argument       , &g_enable_partition_locks             , 1}   ,
       {"enable-separate-tree-per-partition"   , no_argument       , &g_enable_separate_tree_per_partition , 1}   ,
+      {"enable-hash-indexes"                  , no_argument       , &g_enable_hash_indexes                , 1}   ,
       {"new-order-remote-item-pct"            , required_argument , 0                                     , 'r'} ,
       {"new-order-fast-id-gen"                , no_argument       , &g_new_order_fast_id_gen              , 1}   ,
       {"uniform-item-dist"                    , no_argument       , &g_uniform_item_dist                  , 1}   ,
@@ -2200,6 +2225,7 @@ tpcc_do_test(abstract_db *db, int argc, char **argv)
     cerr << "  read_only_snapshots          : " << !g_disable_read_only_scans << endl;
     cerr << "  partition_locks              : " << g_enable_partition_locks << endl;
     cerr << "  separate_tree_per_partition  : " << g_enable_separate_tree_per_partition << endl;
+    cerr << "  hash_indexes                 : " << g_enable_hash_indexes << endl;
     cerr << "  new_order_remote_item_pct    : " << g_new_order_remote_item_pct << endl;
     cerr << "  new_order_fast_id_gen        : " << g_new_order_fast_id_gen << endl;
     cerr << "  uniform_item_dist            : " << g_uniform_item_dist << endl;
@@ -30,6 +30,11 @@ static const size_t YCSBRecordSize = 100;
 // the default is a modification of YCSB "A" we made (80/20 R/W)
 static unsigned g_txn_workload_mix[] = { 80, 20, 0, 0 };
 
+// build USERTABLE bottom-up from sorted runs instead of inserting records
+// one at a time with transactions (falls back to inserts if the index does
+// not support it)
+static int g_bulk_load = 0;
+
 class ycsb_worker : public bench_worker {
 public:
   ycsb_worker(unsigned int worker_id,
@@ -224,6 +229,7 @@ ycsb_load_keyrange(
     unsigned int pinid,
     abstract_db *db,
     abstract_ordered_index *tbl,
+    abstract_ordered_index::bulk_loader *bulk_loader,
     str_arena &arena,
     uint64_t txn_flags,
     void *txn_buf)
@@ -234,6 +240,16 @@ ycsb_load_keyrange(
     rcu::s_instance.fault_region();
   }
 
+  if (bulk_loader) {
+    const string v(YCSBRecordSize, 'a');
+    for (uint64_t i = keystart; i < keyend; i++)
+      bulk_loader->add(u64_varkey(i).str(), v);
+    if (verbose)
+      cerr << "[INFO] finished building USERTABLE range [kstart="
+        << keystart << ", kend=" << keyend << ") - nkeys: " << (keyend - keystart) << endl;
+    return;
+  }
+
   const size_t batchsize = (db->txn_max_batch_size() == -1) ?
     10000 : db->txn_max_batch_size();
   ALWAYS_ASSERT(batchsize > 0);
@@ -269,8 +285,9 @@ class ycsb_usertable_loader : public bench_loader {
 public:
   ycsb_usertable_loader(unsigned long seed,
                         abstract_db *db,
-                        const map<string, abstract_ordered_index *> &open_tables)
-    : bench_loader(seed, db, open_tables)
+                        const map<string, abstract_ordered_index *> &open_tables,
+                        abstract_ordered_index::bulk_loader *bulk_loader)
+    : bench_loader(seed, db, open_tables), bulk_loader(bulk_loader)
   {}
 
 protected:
@@ -288,11 +305,15 @@ protected:
           i,
           db,
           tbl,
+          bulk_loader,
           arena,
           txn_flags,
           txn_buf());
     }
   }
+
+private:
+  abstract_ordered_index::bulk_loader *bulk_loader;
 };
 
 class ycsb_parallel_usertable_loader : public bench_loader {
@@ -302,9 +323,11 @@ public:
                                  const map<string, abstract_ordered_index *> &open_tables,
                                  unsigned int pinid,
                                  uint64_t keystart,
-                                 uint64_t keyend)
+                                 uint64_t keyend,
+                                 abstract_ordered_index::bulk_loader *bulk_loader)
     : bench_loader(seed, db, open_tables),
-      pinid(pinid), keystart(keystart), keyend(keyend)
+      pinid(pinid), keystart(keystart), keyend(keyend),
+      bulk_loader(bulk_loader)
   {
     INVARIANT(keyend > keystart);
     if (verbose)
@@ -323,6 +346,7 @@ protected:
         pinid,
         db,
         tbl,
+        bulk_loader,
         arena,
         txn_flags,
         txn_buf());
@@ -332,6 +356,7 @@ private:
   unsigned int pinid;
   uint64_t keystart;
   uint64_t keyend;
+  abstract_ordered_index::bulk_loader *bulk_loader;
 };
 
 
@@ -340,7 +365,8 @@ public:
   ycsb_bench_runner(abstract_db *db)
     : bench_runner(db)
   {
-    open_tables["USERTABLE"] = db->open_index("USERTABLE", YCSBRecordSize);
+    open_tables["USERTABLE"] = db->open_index(
+        "USERTABLE", YCSBRecordSize, false, sizeof(uint64_t));
   }
 
 protected:
@@ -359,7 +385,7 @@ protected:
           ret.push_back(
               new ycsb_parallel_usertable_loader(
                 0, db, open_tables, i,
-                i * nkeysperloader, kend));
+                i * nkeysperloader, kend, new_bulk_loader()));
         }
       } else {
         // load balance the loaders amongst numa nodes in RR fashion
@@ -390,16 +416,29 @@ protected:
             ret.push_back(
                 new ycsb_parallel_usertable_loader(
                   0, db, open_tables, cpus_avail[j % cpus_avail.size()],
-                  loader_i * nkeysperloader, kend));
+                  loader_i * nkeysperloader, kend, new_bulk_loader()));
           }
         }
       }
     } else {
-      ret.push_back(new ycsb_usertable_loader(0, db, open_tables));
+      ret.push_back(new ycsb_usertable_loader(0, db, open_tables, new_bulk_loader()));
     }
     return ret;
   }
 
+  // the loaders are created (and thus fill their bulk loaders) in
+  // ascending key range order
+  virtual void
+  finish_loading()
+  {
+    if (bulk_loaders.empty())
+      return;
+    open_tables.at("USERTABLE")->bulk_load(bulk_loaders);
+    for (auto l : bulk_loaders)
+      delete l;
+    bulk_loaders.clear();
+  }
+
   virtual vector<bench_worker *>
   make_workers()
   {
@@ -420,6 +459,21 @@ protected:
 
 private:
 
+  // returns nullptr if bulk loading is disabled or unsupported
+  abstract_ordered_index::bulk_loader *
+  new_bulk_loader()
+  {
+    if (!g_bulk_load)
+      return nullptr;
+    abstract_ordered_index::bulk_loader * const l =
+      open_tables.at("USERTABLE")->new_bulk_loader();
+    if (l)
+      bulk_loaders.push_back(l);
+    return l;
+  }
+
+  vector<abstract_ordered_index::bulk_loader *> bulk_loaders;
+
   static vector<unsigned>
   get_numa_nodes_used(unsigned nthds)
   {
@@ -469,7 +523,8 @@ ycsb_do_test(abstract_db *db, int argc, char **argv)
   optind = 1;
   while (1) {
     static struct option long_options[] = {
-      {"workload-mix" , required_argument , 0 , 'w'},
+      {"workload-mix" , required_argument , 0             , 'w'},
+      {"bulk-load"    , no_argument       , &g_bulk_load , 1},
       {0, 0, 0, 0}
     };
     int option_index = 0;
@@ -512,6 +567,7 @@ ycsb_do_test(abstract_db *db, int argc, char **argv)
     cerr << "  workload_mix: "
          << format_list(g_txn_workload_mix, g_txn_workload_mix + ARRAY_NELEMS(g_txn_workload_mix))
          << endl;
+    cerr << "  bulk_load   : " << g_bulk_load << endl;
   }
 
   ycsb_bench_runner r(db);
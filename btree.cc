@@ -12,6 +12,7 @@
 #include "core.h"
 #include "btree.h"
 #include "btree_impl.h"
+#include "btree_simd.h"
 #include "thread.h"
 #include "txn.h"
 #include "util.h"
@@ -813,6 +814,814 @@ test_random_keys()
   ALWAYS_ASSERT(btr.size() == 0);
 }
 
+static void
+test_simd_key_search()
+{
+  using namespace btree_simd;
+  const kernel_t saved = g_kernel;
+  fast_random r(2394823);
+
+  // keys with a shared slice but different lengths exercise the
+  // length tie-break after the vectorized slice compare
+  vector<string> keys;
+  set<string> keyset;
+  for (size_t i = 0; i < 5000; i++) {
+    string k = r.next_readable_string(r.next() % 17);
+    if (r.next() % 2 == 0)
+      k = string(r.next() % 9, (char) (r.next() % 2 ? 0 : 255)) + k;
+    if (keyset.insert(k).second)
+      keys.push_back(k);
+  }
+
+  for (int kern = KERNEL_SCALAR; kern <= best_kernel(); kern++) {
+    ALWAYS_ASSERT(set_kernel(kernel_t(kern)) == kern);
+
+    for (size_t iter = 0; iter < 10000; iter++) {
+      uint64_t a[16];
+      const size_t n = r.next() % (ARRAY_NELEMS(a) + 1);
+      for (size_t i = 0; i < n; i++)
+        // small domain to get duplicates, high bit to check unsigned compares
+        a[i] = (r.next() % 8) | ((r.next() % 2) << 63);
+      sort(&a[0], &a[n]);
+      const uint64_t k = (r.next() % 9) | ((r.next() % 2) << 63);
+      const size_t expected = lower_bound(&a[0], &a[n], k) - &a[0];
+      ALWAYS_ASSERT(count_less(&a[0], n, k) == expected);
+    }
+
+    testing_concurrent_btree btr;
+    for (size_t i = 0; i < keys.size(); i++)
+      btr.insert(varkey(keys[i]), (typename testing_concurrent_btree::value_type) keys[i].data());
+    btr.invariant_checker();
+    for (size_t i = 0; i < keys.size(); i++) {
+      typename testing_concurrent_btree::value_type v = 0;
+      ALWAYS_ASSERT(btr.search(varkey(keys[i]), v));
+      ALWAYS_ASSERT(v == (typename testing_concurrent_btree::value_type) keys[i].data());
+      const string missing = keys[i] + string(1, 0);
+      if (!keyset.count(missing))
+        ALWAYS_ASSERT(!btr.search(varkey(missing), v));
+    }
+    test_range_scan_helper::expect ex(keyset);
+    test_range_scan_helper tester(btr, varkey(""), NULL, false, ex);
+    tester.test();
+  }
+
+  set_kernel(saved);
+}
+
+#if !defined(NDB_MASSTREE)
+template <unsigned int NKeys>
+struct testing_fanout_btree_traits : public concurrent_btree_fanout_traits<NKeys> {
+  static const bool RcuRespCaller = false;
+};
+
+template <unsigned int NKeys>
+static void
+test_fanout()
+{
+  typedef btree<testing_fanout_btree_traits<NKeys>> btree_type;
+  typedef typename btree_type::value_type value_type;
+  btree_type btr;
+  fast_random r(823947 + NKeys);
+
+  vector<string> keys;
+  set<string> keyset;
+  for (size_t i = 0; i < 20000; i++) {
+    string k = r.next_readable_string(r.next() % 20);
+    if (keyset.insert(k).second)
+      keys.push_back(k);
+  }
+
+  for (size_t i = 0; i < keys.size(); i++)
+    btr.insert(varkey(keys[i]), (value_type) keys[i].data());
+  btr.invariant_checker();
+  ALWAYS_ASSERT(btr.size() == keys.size());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    value_type v = 0;
+    ALWAYS_ASSERT(btr.search(varkey(keys[i]), v));
+    ALWAYS_ASSERT(v == (value_type) keys[i].data());
+  }
+
+  for (size_t i = 0; i < keys.size(); i += 2)
+    btr.remove(varkey(keys[i]));
+  btr.invariant_checker();
+  for (size_t i = 0; i < keys.size(); i++) {
+    value_type v = 0;
+    ALWAYS_ASSERT(btr.search(varkey(keys[i]), v) == (i % 2 == 1));
+  }
+}
+
+static void
+test_fanouts()
+{
+  test_fanout<31>();
+  test_fanout<63>();
+}
+
+namespace test_fixed_keys_ns {
+
+  typedef btree<fixed_key_btree_traits<testing_concurrent_btree_traits>>
+    fixed_btree;
+
+  template <typename Btree>
+  class pair_collector : public Btree::search_range_callback {
+  public:
+    virtual bool
+    invoke(const typename Btree::string_type &k, typename Btree::value_type v)
+    {
+      pairs.emplace_back(k, (uintptr_t) v);
+      return true;
+    }
+    vector<pair<string, uintptr_t>> pairs;
+  };
+
+  template <typename Btree>
+  static vector<pair<string, uintptr_t>>
+  scan(const Btree &btr, const string &lower, const string *upper)
+  {
+    pair_collector<Btree> c;
+    const varkey u(upper ? varkey(*upper) : varkey());
+    btr.search_range_call(varkey(lower), upper ? &u : nullptr, c);
+    return c.pairs;
+  }
+}
+
+static void
+test_fixed_keys()
+{
+  using namespace test_fixed_keys_ns;
+  typedef typename fixed_btree::value_type value_type;
+
+  // the fixed width tree should behave exactly like the generic one on 8
+  // byte keys, so we run both side by side
+  fixed_btree fbtr;
+  testing_concurrent_btree btr;
+  fast_random r(2389742);
+  map<uint64_t, uint64_t> ref;
+  for (size_t i = 0; i < 100000; i++) {
+    // small key space, so inserts and removes hit the same keys and nodes
+    // split, merge and steal from their siblings
+    const uint64_t k = r.next() % 20000;
+    const value_type v = (value_type) (r.next() | 0x1);
+    if (r.next() % 3) {
+      value_type old_v = 0, old_fv = 0;
+      const bool inserted = btr.insert(u64_varkey(k), v, &old_v);
+      ALWAYS_ASSERT(fbtr.insert(u64_varkey(k), v, &old_fv) == inserted);
+      ALWAYS_ASSERT(old_v == old_fv);
+      ref[k] = (uint64_t) v;
+    } else {
+      ALWAYS_ASSERT(fbtr.remove(u64_varkey(k)) == btr.remove(u64_varkey(k)));
+      ref.erase(k);
+    }
+  }
+  fbtr.invariant_checker();
+  ALWAYS_ASSERT(fbtr.size() == ref.size());
+
+  for (uint64_t k = 0; k < 20000; k++) {
+    value_type v = 0;
+    const auto it = ref.find(k);
+    ALWAYS_ASSERT(fbtr.search(u64_varkey(k), v) == (it != ref.end()));
+    ALWAYS_ASSERT(it == ref.end() || v == (value_type) it->second);
+  }
+
+  // keys of other lengths are never found, but work as scan bounds
+  const string k0 = u64_varkey(ref.begin()->first).str();
+  value_type v = 0;
+  ALWAYS_ASSERT(!fbtr.search(varkey(k0.substr(0, 7)), v));
+  ALWAYS_ASSERT(!fbtr.search(varkey(k0 + "a"), v));
+  const string mid = u64_varkey(10000).str();
+  const vector<string> bounds = {
+    "", string(1, '\0'), mid.substr(0, 7), mid, mid + "a", string(9, '\xff'),
+  };
+  for (auto &lower : bounds) {
+    ALWAYS_ASSERT(scan(fbtr, lower, nullptr) == scan(btr, lower, nullptr));
+    for (auto &upper : bounds)
+      ALWAYS_ASSERT(scan(fbtr, lower, &upper) == scan(btr, lower, &upper));
+  }
+  ALWAYS_ASSERT(scan(fbtr, "", nullptr).size() == ref.size());
+
+  // bulk loading builds the same tree
+  fixed_btree bulk;
+  fixed_btree::bulk_builder b;
+  for (auto &p : ref)
+    b.add(u64_varkey(p.first), (value_type) p.second);
+  bulk.bulk_load(b);
+  bulk.invariant_checker();
+  ALWAYS_ASSERT(scan(bulk, "", nullptr) == scan(fbtr, "", nullptr));
+}
+
+class bulk_build_worker : public ndb_thread {
+public:
+  bulk_build_worker(testing_concurrent_btree::bulk_builder &b,
+                    const vector<string> &keys, size_t begin, size_t end)
+    : b(&b), keys(&keys), begin(begin), end(end) {}
+  virtual void
+  run()
+  {
+    for (size_t i = begin; i < end; i++)
+      b->add(varkey((*keys)[i]), (typename testing_concurrent_btree::value_type) (*keys)[i].data());
+  }
+private:
+  testing_concurrent_btree::bulk_builder *const b;
+  const vector<string> *const keys;
+  const size_t begin;
+  const size_t end;
+};
+
+static void
+test_bulk_load()
+{
+  typedef typename testing_concurrent_btree::value_type value_type;
+  fast_random r(4328923);
+
+  // mix of short keys and long keys sharing slices, so the builder has to
+  // produce suffixes and layers
+  set<string> keyset;
+  for (size_t i = 0; i < 30000; i++) {
+    string k = r.next_readable_string(r.next() % 12);
+    if (r.next() % 4 == 0)
+      k = string("prefix__") + k + r.next_readable_string(r.next() % 20);
+    keyset.insert(k);
+  }
+  const vector<string> keys(keyset.begin(), keyset.end());
+
+  {
+    // empty builder leaves the tree empty (and usable)
+    testing_concurrent_btree btr;
+    testing_concurrent_btree::bulk_builder b;
+    btr.bulk_load(b);
+    btr.invariant_checker();
+    ALWAYS_ASSERT(btr.size() == 0);
+    btr.insert(varkey("a"), (value_type) 0x1);
+    ALWAYS_ASSERT(btr.size() == 1);
+  }
+
+  for (size_t nbuilders = 1; nbuilders <= 4; nbuilders += 3) {
+    // split into ranges which do not share a key slice
+    vector<size_t> splits;
+    splits.push_back(0);
+    for (size_t i = 1; i < nbuilders; i++) {
+      size_t p = i * keys.size() / nbuilders;
+      while (p < keys.size() &&
+             varkey(keys[p]).slice() == varkey(keys[p - 1]).slice())
+        p++;
+      splits.push_back(p);
+    }
+    splits.push_back(keys.size());
+
+    vector<testing_concurrent_btree::bulk_builder *> builders;
+    vector<bulk_build_worker *> workers;
+    for (size_t i = 0; i < nbuilders; i++) {
+      builders.push_back(new testing_concurrent_btree::bulk_builder);
+      workers.push_back(
+          new bulk_build_worker(*builders.back(), keys, splits[i], splits[i + 1]));
+      workers.back()->start();
+    }
+    for (auto w : workers) {
+      w->join();
+      delete w;
+    }
+
+    testing_concurrent_btree btr;
+    btr.bulk_load(builders);
+    for (auto b : builders)
+      delete b;
+    btr.invariant_checker();
+    ALWAYS_ASSERT(btr.size() == keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      value_type v = 0;
+      ALWAYS_ASSERT(btr.search(varkey(keys[i]), v));
+      ALWAYS_ASSERT(v == (value_type) keys[i].data());
+    }
+
+    test_range_scan_helper::expect ex(keyset);
+    test_range_scan_helper tester(btr, varkey(""), NULL, false, ex);
+    tester.test();
+
+    // the bulk built tree is a regular tree
+    for (size_t i = 0; i < keys.size(); i += 3)
+      ALWAYS_ASSERT(btr.remove(varkey(keys[i])));
+    for (size_t i = 0; i < 2000; i++)
+      btr.insert(u64_varkey(r.next()), (value_type) 0x1);
+    btr.invariant_checker();
+    for (size_t i = 0; i < keys.size(); i++) {
+      value_type v = 0;
+      ALWAYS_ASSERT(btr.search(varkey(keys[i]), v) == (i % 3 != 0));
+    }
+  }
+}
+#endif
+
+#if !defined(NDB_MASSTREE)
+namespace test_mostly_append_ns {
+
+  class leaf_counter : public testing_concurrent_btree::tree_walk_callback {
+  public:
+    leaf_counter() : nleaves(0), nkeys(0) {}
+    virtual void
+    on_node_begin(const typename testing_concurrent_btree::node_opaque_t *n)
+    {
+      values = testing_concurrent_btree::ExtractValues(n);
+    }
+    virtual void
+    on_node_success()
+    {
+      if (!values.empty()) {
+        nleaves++;
+        nkeys += values.size();
+      }
+    }
+    virtual void on_node_failure() {}
+    size_t nleaves;
+    size_t nkeys;
+  private:
+    vector<pair<typename testing_concurrent_btree::value_type, bool>> values;
+  };
+
+  static inline uint64_t
+  key(uint64_t range, uint64_t i)
+  {
+    return (range << 32) | i;
+  }
+
+  static const size_t nranges = 10;
+
+  // appends to nranges increasing key ranges, round robin (like orders
+  // across districts), then returns the average number of keys per leaf
+  static double
+  fill(testing_concurrent_btree &btr, size_t nperrange)
+  {
+    for (size_t i = 0; i < nperrange; i++)
+      for (size_t r = 0; r < nranges; r++)
+        btr.insert(u64_varkey(key(r, i)),
+                   (typename testing_concurrent_btree::value_type) key(r, i));
+    btr.invariant_checker();
+    leaf_counter c;
+    {
+      scoped_rcu_region guard;
+      btr.tree_walk(c);
+    }
+    ALWAYS_ASSERT(c.nkeys == nranges * nperrange);
+    return double(c.nkeys) / double(c.nleaves);
+  }
+}
+
+static void
+test_mostly_append()
+{
+  using namespace test_mostly_append_ns;
+  typedef typename testing_concurrent_btree::value_type value_type;
+  const size_t nperrange = 10000;
+
+  testing_concurrent_btree btr_mid, btr_append(true);
+  const double mid_fill = fill(btr_mid, nperrange);
+  const double append_fill = fill(btr_append, nperrange);
+  // middle splits leave all but the last leaf of each range half full
+  ALWAYS_ASSERT(mid_fill < 0.6 * testing_concurrent_btree::NKeysPerNode);
+  ALWAYS_ASSERT(append_fill > 0.9 * testing_concurrent_btree::NKeysPerNode);
+
+  // out of order inserts, long keys, and removes still work
+  fast_random r(2390823);
+  for (size_t i = 0; i < 5000; i++) {
+    const uint64_t k = key(r.next() % nranges, r.next() % (2 * nperrange));
+    btr_append.insert(u64_varkey(k), (value_type) k);
+  }
+  for (size_t i = 0; i < nperrange; i++) {
+    const string k = u64_varkey(key(nranges, 0)).str() + string(i % 3 + 1, 'a') + to_string(i);
+    btr_append.insert(varkey(k), (value_type) 0x1);
+  }
+  btr_append.invariant_checker();
+  for (size_t i = 0; i < nperrange; i++)
+    for (size_t rr = 0; rr < nranges; rr++)
+      if (i % 4)
+        ALWAYS_ASSERT(btr_append.remove(u64_varkey(key(rr, i))));
+  btr_append.invariant_checker();
+  for (size_t i = nperrange; i < 2 * nperrange; i++)
+    for (size_t rr = 0; rr < nranges; rr++)
+      btr_append.insert(u64_varkey(key(rr, i)), (value_type) key(rr, i));
+  btr_append.invariant_checker();
+  for (size_t i = 0; i < 2 * nperrange; i++)
+    for (size_t rr = 0; rr < nranges; rr++) {
+      const bool expect = i >= nperrange || !(i % 4);
+      value_type v = 0;
+      ALWAYS_ASSERT(btr_append.search(u64_varkey(key(rr, i)), v) == expect);
+      ALWAYS_ASSERT(!expect || v == (value_type) key(rr, i));
+    }
+
+  cout << "test_mostly_append passed (keys/leaf: middle splits "
+       << mid_fill << ", append splits " << append_fill << ")" << endl;
+}
+
+namespace test_batch_scan_ns {
+
+  typedef typename testing_concurrent_btree::value_type value_type;
+
+  class batch_collector : public testing_concurrent_btree::batch_search_range_callback {
+  public:
+    batch_collector(size_t limit = numeric_limits<size_t>::max())
+      : nbatches(0), limit(limit) {}
+    virtual bool
+    invoke_batch(const char *keys, const size_t *key_offsets,
+                 const value_type *values, size_t n)
+    {
+      ALWAYS_ASSERT(n > 0);
+      nbatches++;
+      for (size_t i = 0; i < n; i++)
+        pairs.emplace_back(
+            string(keys + key_offsets[i], key_offsets[i + 1] - key_offsets[i]),
+            values[i]);
+      return pairs.size() < limit;
+    }
+    vector<pair<string, value_type>> pairs;
+    size_t nbatches;
+  private:
+    const size_t limit;
+  };
+
+  class pair_collector : public testing_concurrent_btree::search_range_callback {
+  public:
+    virtual bool
+    invoke(const typename testing_concurrent_btree::string_type &k, value_type v)
+    {
+      pairs.emplace_back(k, v);
+      return true;
+    }
+    vector<pair<string, value_type>> pairs;
+  };
+}
+
+static void
+test_batch_scan()
+{
+  using namespace test_batch_scan_ns;
+  testing_concurrent_btree btr;
+
+  // a mix of short keys and long keys sharing prefixes, so the scan
+  // crosses many leaves and layers
+  fast_random r(8394823);
+  set<string> keys;
+  for (size_t i = 0; i < 4000; i++)
+    keys.insert(u64_varkey(r.next() % 100000).str());
+  for (size_t i = 0; i < 4000; i++)
+    keys.insert(string(8 + r.next() % 3, 'a' + r.next() % 4) + r.next_string(r.next() % 12));
+  for (auto &k : keys)
+    ALWAYS_ASSERT(btr.insert(varkey(k), (value_type) k.data()));
+  btr.invariant_checker();
+
+  const varkey lo(*next(keys.begin(), 100));
+  const varkey hi(*next(keys.begin(), 2000));
+  for (auto upper : {(const varkey *) nullptr, &hi}) {
+    batch_collector batched;
+    btr.search_range_call(lo, upper, batched);
+    pair_collector expected;
+    btr.search_range_call(lo, upper, expected);
+    ALWAYS_ASSERT(expected.pairs.size() == (upper ? 1900 : keys.size() - 100));
+    ALWAYS_ASSERT(batched.pairs == expected.pairs);
+    // one batch per leaf, not per key
+    ALWAYS_ASSERT(batched.nbatches > 1);
+    ALWAYS_ASSERT(batched.nbatches < batched.pairs.size() / 2);
+  }
+
+  // stopping stops after the batch which crossed the limit
+  batch_collector stopped(1000);
+  btr.search_range_call(lo, nullptr, stopped);
+  ALWAYS_ASSERT(stopped.pairs.size() >= 1000);
+  ALWAYS_ASSERT(stopped.pairs.size() < 1000 + 3 * testing_concurrent_btree::NKeysPerNode);
+  pair_collector all;
+  btr.search_range_call(lo, nullptr, all);
+  ALWAYS_ASSERT(equal(stopped.pairs.begin(), stopped.pairs.end(), all.pairs.begin()));
+
+  cout << "test_batch_scan passed" << endl;
+}
+
+static void
+test_hash_index()
+{
+  typedef typename testing_concurrent_btree::value_type value_type;
+  typedef typename testing_concurrent_btree::versioned_node_t versioned_node_t;
+  typedef typename testing_concurrent_btree::insert_info_t insert_info_t;
+  testing_concurrent_btree btr(false, true);
+
+  // a miss hands out the bucket, which an insert of the key bumps
+  {
+    scoped_rcu_region guard;
+    const string k("not there");
+    value_type v = 0;
+    versioned_node_t sinfo;
+    ALWAYS_ASSERT(!btr.search(varkey(k), v, &sinfo));
+    ALWAYS_ASSERT(sinfo.first);
+    ALWAYS_ASSERT(testing_concurrent_btree::ExtractVersionNumber(sinfo.first) == sinfo.second);
+    insert_info_t iinfo;
+    ALWAYS_ASSERT(btr.insert_if_absent(varkey(k), (value_type) 0x1, &iinfo));
+    ALWAYS_ASSERT(iinfo.node == sinfo.first);
+    ALWAYS_ASSERT(iinfo.old_version == sinfo.second);
+    ALWAYS_ASSERT(iinfo.new_version == sinfo.second + 1);
+    ALWAYS_ASSERT(testing_concurrent_btree::ExtractVersionNumber(sinfo.first) == iinfo.new_version);
+
+    // replacing a value is not a structural change
+    value_type old_v = 0;
+    ALWAYS_ASSERT(!btr.insert(varkey(k), (value_type) 0x2, &old_v));
+    ALWAYS_ASSERT(old_v == (value_type) 0x1);
+    ALWAYS_ASSERT(testing_concurrent_btree::ExtractVersionNumber(sinfo.first) == iinfo.new_version);
+    ALWAYS_ASSERT(btr.remove(varkey(k), &old_v));
+    ALWAYS_ASSERT(old_v == (value_type) 0x2);
+    ALWAYS_ASSERT(testing_concurrent_btree::ExtractVersionNumber(sinfo.first) == iinfo.new_version + 1);
+  }
+
+  // short keys, the empty key, and long keys sharing prefixes (which would
+  // need layers in the tree)
+  fast_random r(2384723);
+  set<string> keys;
+  keys.insert(string());
+  for (size_t i = 0; i < 5000; i++)
+    keys.insert(u64_varkey(r.next()).str());
+  for (size_t i = 0; i < 5000; i++)
+    keys.insert(string(8 + r.next() % 3, 'a') + r.next_string(r.next() % 20));
+  for (auto &k : keys)
+    ALWAYS_ASSERT(btr.insert_if_absent(varkey(k), (value_type) k.data()));
+  btr.invariant_checker();
+  ALWAYS_ASSERT(btr.size() == keys.size());
+  for (auto &k : keys) {
+    value_type v = 0;
+    ALWAYS_ASSERT(btr.search(varkey(k), v));
+    ALWAYS_ASSERT(v == (value_type) k.data());
+    ALWAYS_ASSERT(!btr.insert_if_absent(varkey(k), (value_type) 0x1));
+  }
+
+  size_t i = 0;
+  for (auto &k : keys)
+    if (i++ % 2)
+      ALWAYS_ASSERT(btr.remove(varkey(k)));
+  btr.invariant_checker();
+  ALWAYS_ASSERT(btr.size() == (keys.size() + 1) / 2);
+  i = 0;
+  for (auto &k : keys) {
+    const bool kept = !(i++ % 2);
+    value_type v = 0;
+    ALWAYS_ASSERT(btr.search(varkey(k), v) == kept);
+    ALWAYS_ASSERT(btr.remove(varkey(k)) == kept);
+  }
+  ALWAYS_ASSERT(btr.size() == 0);
+
+  btr.insert(varkey(*keys.begin()), (value_type) 0x1);
+  btr.clear();
+  ALWAYS_ASSERT(btr.size() == 0);
+  btr.insert(varkey(*keys.begin()), (value_type) 0x1);
+  btr.invariant_checker();
+  ALWAYS_ASSERT(btr.size() == 1);
+
+  cout << "test_hash_index passed" << endl;
+}
+
+namespace test_suffix_compression_ns {
+
+  class suffix_bytes_counter : public testing_concurrent_btree::tree_walk_callback {
+  public:
+    suffix_bytes_counter() : nbytes(0), cur(0) {}
+    virtual void
+    on_node_begin(const typename testing_concurrent_btree::node_opaque_t *n)
+    {
+      cur = testing_concurrent_btree::ExtractSuffixBytes(n);
+    }
+    virtual void
+    on_node_success()
+    {
+      nbytes += cur;
+    }
+    virtual void on_node_failure() {}
+    size_t nbytes;
+  private:
+    size_t cur;
+  };
+
+  static size_t
+  suffix_bytes(testing_concurrent_btree &btr)
+  {
+    suffix_bytes_counter c;
+    scoped_rcu_region guard;
+    btr.tree_walk(c);
+    return c.nbytes;
+  }
+
+  // every key has its own first slice (so it gets a suffix, not a layer),
+  // and the suffixes only differ in their last 4 bytes
+  static inline string
+  key(uint32_t i)
+  {
+    const uint32_t t = util::big_endian_trfm<uint32_t>()(i);
+    return u64_varkey(i).str() + string(24, 'x') + string((const char *) &t, 4);
+  }
+}
+
+static void
+test_suffix_compression()
+{
+  using namespace test_suffix_compression_ns;
+  typedef typename testing_concurrent_btree::value_type value_type;
+  const size_t nkeys = 10000;
+
+  testing_concurrent_btree btr;
+  vector<size_t> order;
+  for (size_t i = 0; i < nkeys; i++)
+    order.push_back(i);
+  fast_random r(923847);
+  for (size_t i = nkeys - 1; i > 0; i--)
+    swap(order[i], order[r.next() % (i + 1)]);
+  for (auto i : order)
+    ALWAYS_ASSERT(btr.insert_if_absent(varkey(key(i)), (value_type) (i + 1)));
+  btr.invariant_checker();
+
+  // only the distinguishing bytes of each suffix are kept
+  const size_t raw_bytes = nkeys * (key(0).size() - 8);
+  const size_t nbytes = suffix_bytes(btr);
+  ALWAYS_ASSERT(nbytes < raw_bytes / 3);
+
+  for (size_t i = 0; i < nkeys; i++) {
+    value_type v = 0;
+    ALWAYS_ASSERT(btr.search(varkey(key(i)), v));
+    ALWAYS_ASSERT(v == (value_type) (i + 1));
+    // same slice, suffix shorter than the common prefix, equal to it, or
+    // different within it
+    const string k = key(i);
+    ALWAYS_ASSERT(!btr.search(varkey(k.substr(0, 20)), v));
+    ALWAYS_ASSERT(!btr.search(varkey(k.substr(0, 32)), v));
+    ALWAYS_ASSERT(!btr.search(varkey(k.substr(0, 12) + "y" + k.substr(13)), v));
+  }
+
+  set<string> expected;
+  for (size_t i = 500; i < 600; i++)
+    expected.insert(key(i));
+  const string upper(key(600));
+  const varkey upper_k(upper);
+  test_range_scan_helper(btr, varkey(key(500)), &upper_k, false, expected).test();
+  // bounds which fall inside the shared prefix
+  test_range_scan_helper(btr, varkey(key(500).substr(0, 20)), &upper_k, false, expected).test();
+
+  // a key w/ the same slice as a packed suffix turns it into a layer
+  const string layered = key(7).substr(0, 16) + "layer";
+  ALWAYS_ASSERT(btr.insert_if_absent(varkey(layered), (value_type) 0x1));
+  btr.invariant_checker();
+  value_type v = 0;
+  ALWAYS_ASSERT(btr.search(varkey(key(7)), v));
+  ALWAYS_ASSERT(v == (value_type) 8);
+  ALWAYS_ASSERT(btr.search(varkey(layered), v));
+  ALWAYS_ASSERT(v == (value_type) 0x1);
+  ALWAYS_ASSERT(btr.remove(varkey(layered)));
+
+  for (size_t i = 0; i < nkeys; i++)
+    if (i % 3)
+      ALWAYS_ASSERT(btr.remove(varkey(key(i))));
+  btr.invariant_checker();
+  for (size_t i = 0; i < nkeys; i++) {
+    ALWAYS_ASSERT(btr.search(varkey(key(i)), v) == !(i % 3));
+    ALWAYS_ASSERT(i % 3 || v == (value_type) (i + 1));
+  }
+  ALWAYS_ASSERT(suffix_bytes(btr) < nbytes);
+
+  // suffixes w/o a common prefix, which add up to more than 64KB per leaf
+  testing_concurrent_btree btr_long;
+  vector<string> long_keys;
+  for (size_t i = 0; i < 64; i++)
+    long_keys.push_back(u64_varkey(i).str() + r.next_string(10000));
+  for (size_t i = 0; i < long_keys.size(); i++)
+    ALWAYS_ASSERT(btr_long.insert_if_absent(varkey(long_keys[i]), (value_type) i));
+  btr_long.invariant_checker();
+  for (size_t i = 0; i < long_keys.size(); i++) {
+    ALWAYS_ASSERT(btr_long.search(varkey(long_keys[i]), v));
+    ALWAYS_ASSERT(v == (value_type) i);
+    ALWAYS_ASSERT(btr_long.remove(varkey(long_keys[i])));
+  }
+  ALWAYS_ASSERT(suffix_bytes(btr_long) == 0);
+
+  cout << "test_suffix_compression passed (suffix bytes/key: raw "
+       << double(raw_bytes) / nkeys << ", packed " << double(nbytes) / nkeys
+       << ")" << endl;
+}
+
+static void
+test_size_estimate()
+{
+  typedef typename testing_concurrent_btree::value_type value_type;
+  const size_t nkeys = 100000;
+
+  testing_concurrent_btree btr;
+  ALWAYS_ASSERT(btr.size_estimate() == 0);
+  ALWAYS_ASSERT(btr.key_quantiles(4).empty());
+
+  // keys sharing slices (so some go into layers), inserted more than once
+  for (size_t i = 0; i < nkeys; i++) {
+    const string k = u64_varkey(i / 2).str() + string(i % 2, 'a');
+    ALWAYS_ASSERT(btr.insert(varkey(k), (value_type) 0x1));
+    ALWAYS_ASSERT(!btr.insert(varkey(k), (value_type) 0x2));
+    ALWAYS_ASSERT(!btr.insert_if_absent(varkey(k), (value_type) 0x3));
+  }
+  ALWAYS_ASSERT(btr.size_estimate() == nkeys);
+  btr.invariant_checker();
+
+  // evenly spread keys give evenly spread quantiles
+  const size_t nranges = 8;
+  const vector<string> q = btr.key_quantiles(nranges);
+  ALWAYS_ASSERT(q.size() == nranges - 1);
+  for (size_t i = 0; i < q.size(); i++) {
+    ALWAYS_ASSERT(!i || q[i - 1] < q[i]);
+    // keys are big endian, so ranges are compared by their first 8 bytes
+    string b(q[i]);
+    b.resize(8);
+    const uint64_t at = host_endian_trfm<uint64_t>()(*(const uint64_t *) b.data());
+    const double d = double(at) - double(i + 1) * (nkeys / 2) / nranges;
+    ALWAYS_ASSERT(d > -0.05 * (nkeys / 2) && d < 0.05 * (nkeys / 2));
+  }
+
+  for (size_t i = 0; i < nkeys; i += 2)
+    ALWAYS_ASSERT(btr.remove(u64_varkey(i / 2)));
+  ALWAYS_ASSERT(!btr.remove(u64_varkey(0)));
+  ALWAYS_ASSERT(btr.size_estimate() == nkeys / 2);
+  btr.invariant_checker();
+
+  btr.clear();
+  ALWAYS_ASSERT(btr.size_estimate() == 0);
+  testing_concurrent_btree::bulk_builder b;
+  for (size_t i = 0; i < 1000; i++)
+    b.add(u64_varkey(i), (value_type) 0x1);
+  btr.bulk_load(b);
+  ALWAYS_ASSERT(btr.size_estimate() == 1000);
+  btr.invariant_checker();
+
+  // a small tree (a single leaf) is split by its own keys
+  testing_concurrent_btree small;
+  for (size_t i = 0; i < 4; i++)
+    small.insert(u64_varkey(i << 56), (value_type) 0x1);
+  const vector<string> sq = small.key_quantiles(2);
+  ALWAYS_ASSERT(sq.size() == 1);
+  ALWAYS_ASSERT(sq[0] == string(1, char(2)));
+
+  cout << "test_size_estimate passed" << endl;
+}
+
+static void
+test_mem_accounting()
+{
+  typedef typename testing_concurrent_btree::value_type value_type;
+
+  // gauges must outlive the trees accounting to them
+  static event_gauge *node_bytes =
+    new event_gauge("test_mem_accounting/node_bytes");
+  static event_gauge *suffix_bytes =
+    new event_gauge("test_mem_accounting/suffix_bytes");
+
+  fast_random r(5829);
+  set<string> keyset;
+  while (keyset.size() < 20000)
+    // a mix of short keys, suffixes and layers
+    keyset.insert(string(r.next() % 12, 'a') + r.next_string(r.next() % 24));
+
+  for (size_t hashed = 0; hashed < 2; hashed++) {
+    {
+      testing_concurrent_btree btr(false, hashed, node_bytes, suffix_bytes);
+      const auto check = [&]() {
+        const pair<size_t, size_t> u = btr.mem_usage();
+        ALWAYS_ASSERT(node_bytes->value() == int64_t(u.first));
+        ALWAYS_ASSERT(suffix_bytes->value() == int64_t(u.second));
+      };
+      check();
+
+      for (auto &k : keyset)
+        ALWAYS_ASSERT(btr.insert_if_absent(varkey(k), (value_type) 0x1));
+      check();
+      ALWAYS_ASSERT(hashed || suffix_bytes->value() > 0);
+
+      size_t i = 0;
+      for (auto &k : keyset)
+        if (i++ % 2)
+          ALWAYS_ASSERT(btr.remove(varkey(k)));
+      check();
+      for (auto &k : keyset)
+        btr.remove(varkey(k));
+      check();
+      ALWAYS_ASSERT(suffix_bytes->value() == 0);
+
+      for (auto &k : keyset)
+        btr.insert(varkey(k), (value_type) 0x1);
+      btr.clear();
+      check();
+
+      if (!hashed) {
+        testing_concurrent_btree::bulk_builder b;
+        for (auto &k : keyset)
+          b.add(varkey(k), (value_type) 0x1);
+        btr.bulk_load(b);
+        check();
+      }
+    }
+    ALWAYS_ASSERT(node_bytes->value() == 0);
+    ALWAYS_ASSERT(suffix_bytes->value() == 0);
+  }
+
+  cout << "test_mem_accounting passed" << endl;
+}
+#endif
+
 static void
 test_insert_remove_mix()
 {
@@ -1207,6 +2016,116 @@ mp_test_inserts_removes()
   }
 }
 
+namespace mp_test_mostly_append_ns {
+
+  static const size_t nthreads = 4;
+  static const size_t nkeys = 200000;
+  static const size_t window = 100;
+
+  static inline uint64_t
+  key(uint64_t range, uint64_t i)
+  {
+    return (range << 32) | i;
+  }
+
+  // appends to its own key range while removing from the front of it (like
+  // new_order), so the shared append hint keeps switching between leaves
+  // which split and merge underneath it
+  class worker : public btree_worker {
+  public:
+    worker(unsigned int id, testing_concurrent_btree &btr)
+      : btree_worker(btr), id(id) {}
+    virtual void run()
+    {
+      for (size_t i = 0; i < nkeys; i++) {
+        btr->insert(u64_varkey(key(id, i)),
+                    (typename testing_concurrent_btree::value_type) key(id, i));
+        if (i >= window)
+          ALWAYS_ASSERT(btr->remove(u64_varkey(key(id, i - window))));
+      }
+    }
+  private:
+    unsigned int id;
+  };
+}
+
+static void
+mp_test_mostly_append()
+{
+  using namespace mp_test_mostly_append_ns;
+  testing_concurrent_btree btr(true);
+  vector<unique_ptr<worker>> workers;
+  for (size_t i = 0; i < nthreads; i++)
+    workers.emplace_back(new worker(i, btr));
+  for (auto &p : workers)
+    p->start();
+  for (auto &p : workers)
+    p->join();
+  btr.invariant_checker();
+  for (size_t id = 0; id < nthreads; id++)
+    for (size_t i = 0; i < nkeys; i++) {
+      typename testing_concurrent_btree::value_type v = 0;
+      ALWAYS_ASSERT(btr.search(u64_varkey(key(id, i)), v) == (i >= nkeys - window));
+    }
+  ALWAYS_ASSERT(btr.size() == nthreads * window);
+}
+
+#if !defined(NDB_MASSTREE)
+namespace mp_test_hash_index_ns {
+
+  static const size_t nthreads = 4;
+  static const size_t nkeys = 50000;
+
+  // inserts its own keys (growing the table underneath everyone), then
+  // removes every other one, while reading back the keys of the other
+  // workers
+  class worker : public btree_worker {
+  public:
+    worker(unsigned int id, testing_concurrent_btree &btr)
+      : btree_worker(btr), id(id) {}
+    virtual void run()
+    {
+      typedef typename testing_concurrent_btree::value_type value_type;
+      fast_random r(id + 1);
+      for (size_t i = 0; i < nkeys; i++) {
+        const uint64_t k = i * nthreads + id;
+        ALWAYS_ASSERT(btr->insert_if_absent(u64_varkey(k), (value_type) k));
+        const uint64_t o = r.next() % (i * nthreads + id + 1);
+        value_type v = 0;
+        if (btr->search(u64_varkey(o), v))
+          ALWAYS_ASSERT(v == (value_type) o);
+        else
+          ALWAYS_ASSERT((o % nthreads) != id);
+      }
+      for (size_t i = 0; i < nkeys; i += 2)
+        ALWAYS_ASSERT(btr->remove(u64_varkey(i * nthreads + id)));
+    }
+  private:
+    unsigned int id;
+  };
+}
+
+static void
+mp_test_hash_index()
+{
+  using namespace mp_test_hash_index_ns;
+  testing_concurrent_btree btr(false, true);
+  vector<unique_ptr<worker>> workers;
+  for (size_t i = 0; i < nthreads; i++)
+    workers.emplace_back(new worker(i, btr));
+  for (auto &p : workers)
+    p->start();
+  for (auto &p : workers)
+    p->join();
+  btr.invariant_checker();
+  for (size_t k = 0; k < nkeys * nthreads; k++) {
+    typename testing_concurrent_btree::value_type v = 0;
+    ALWAYS_ASSERT(btr.search(u64_varkey(k), v) == ((k / nthreads) % 2 == 1));
+  }
+  ALWAYS_ASSERT(btr.size() == nthreads * nkeys / 2);
+}
+#endif
+
 namespace mp_test5_ns {
 
   static const size_t niters = 100000;
@@ -1817,6 +2736,51 @@ perf_test()
   }
 }
 
+static void key_search_perf_test() UNUSED;
+static void
+key_search_perf_test()
+{
+  using namespace btree_simd;
+  const kernel_t saved = g_kernel;
+  const size_t nkeys = 1000000;
+  const size_t nlookups = 10000000;
+
+  testing_concurrent_btree btr8;
+  for (size_t i = 0; i < nkeys; i++)
+    btr8.insert(u64_varkey(i), (typename testing_concurrent_btree::value_type) i);
+
+  fast_random r0(98234);
+  vector<string> varkeys;
+  testing_concurrent_btree btrvar;
+  for (size_t i = 0; i < nkeys; i++) {
+    varkeys.push_back(r0.next_readable_string(1 + r0.next() % 24));
+    btrvar.insert(varkey(varkeys.back()), (typename testing_concurrent_btree::value_type) i);
+  }
+
+  for (int kern = KERNEL_SCALAR; kern <= best_kernel(); kern++) {
+    set_kernel(kernel_t(kern));
+    const string name = kernel_name(kernel_t(kern));
+    {
+      fast_random r(5923);
+      scoped_rate_timer t("btree 8-byte key point lookups (" + name + ")", nlookups);
+      for (size_t i = 0; i < nlookups; i++) {
+        typename testing_concurrent_btree::value_type v = 0;
+        ALWAYS_ASSERT(btr8.search(u64_varkey(r.next() % nkeys), v));
+      }
+    }
+    {
+      fast_random r(5923);
+      scoped_rate_timer t("btree var-length key point lookups (" + name + ")", nlookups);
+      for (size_t i = 0; i < nlookups; i++) {
+        typename testing_concurrent_btree::value_type v = 0;
+        ALWAYS_ASSERT(btrvar.search(varkey(varkeys[r.next() % nkeys]), v));
+      }
+    }
+  }
+
+  set_kernel(saved);
+}
+
 namespace read_only_perf_test_ns {
   const size_t nkeys = 140000000; // 140M
   //const size_t nkeys = 100000; // 100K
@@ -1985,8 +2949,24 @@ TestConcurrentBtreeFast()
   test_null_keys_2();
   test_random_keys();
   test_insert_remove_mix();
+  test_simd_key_search();
+#if !defined(NDB_MASSTREE)
+  test_mostly_append();
+  test_batch_scan();
+  test_fanouts();
+  test_fixed_keys();
+  test_bulk_load();
+  test_hash_index();
+  test_suffix_compression();
+  test_size_estimate();
+  test_mem_accounting();
+#endif
   mp_test_pinning();
   mp_test_inserts_removes();
+  mp_test_mostly_append();
+#if !defined(NDB_MASSTREE)
+  mp_test_hash_index();
+#endif
   cout << "testing_concurrent_btree::TestFast passed" << endl;
 }
 
@@ -2004,6 +2984,7 @@ TestConcurrentBtreeSlow()
   mp_test8();
   mp_test_long_keys();
   //perf_test();
+  //key_search_perf_test();
   //read_only_perf_test();
   //write_only_perf_test();
   cout << "testing_concurrent_btree::TestSlow passed" << endl;
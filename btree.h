@@ -21,7 +21,10 @@
 #include "macros.h"
 #include "prefetch.h"
 #include "amd64.h"
+#include "btree_simd.h"
 #include "rcu.h"
+#include "core.h"
+#include "spinlock.h"
 #include "util.h"
 #include "small_vector.h"
 #include "ownership_checker.h"
@@ -477,19 +480,74 @@ public:
   }
 };
 
-struct base_btree_config {
-  static const unsigned int NKeysPerNode = 15;
+/**
+ * NKeysPerNode is the fanout of both leaf and internal nodes. Larger
+ * fanouts make for shallower trees at the expense of more work per node
+ * (see BTREE_NODE_SEARCH_LAYOUT in macros.h for how nodes are laid out)
+ *
+ * ScanPrefetchLeaves is how many leaves a range scan prefetches ahead of
+ * the leaf it is reading, once it has moved past its first leaf (0
+ * disables this)
+ *
+ * FixedKeys trees only hold keys which are exactly one key slice (8 bytes)
+ * long, eg u64_varkey()s (see fixed_key_btree_traits)
+ */
+template <unsigned int NKeys>
+struct btree_fanout_config {
+  static const unsigned int NKeysPerNode = NKeys;
+  static const unsigned int ScanPrefetchLeaves = 4;
   static const bool RcuRespCaller = true;
+  static const bool FixedKeys = false;
 };
 
-struct concurrent_btree_traits : public base_btree_config {
+typedef btree_fanout_config<15> base_btree_config;
+
+template <unsigned int NKeys>
+struct concurrent_btree_fanout_traits : public btree_fanout_config<NKeys> {
   typedef std::atomic<uint64_t> VersionType;
 };
 
-struct single_threaded_btree_traits : public base_btree_config {
+template <unsigned int NKeys>
+struct single_threaded_btree_fanout_traits : public btree_fanout_config<NKeys> {
   typedef uint64_t VersionType;
 };
 
+struct concurrent_btree_traits :
+  public concurrent_btree_fanout_traits<base_btree_config::NKeysPerNode> {};
+
+struct single_threaded_btree_traits :
+  public single_threaded_btree_fanout_traits<base_btree_config::NKeysPerNode> {};
+
+namespace private_ {
+  // shared by the btrees which are not given their own gauges (see btree())
+  inline event_gauge *
+  btree_default_node_bytes()
+  {
+    static event_gauge *s_gauge = new event_gauge("btree_node_bytes");
+    return s_gauge;
+  }
+
+  inline event_gauge *
+  btree_default_suffix_bytes()
+  {
+    static event_gauge *s_gauge = new event_gauge("btree_suffix_bytes");
+    return s_gauge;
+  }
+}
+
+/**
+ * Turns traits P into the traits of a tree whose keys are all exactly 8
+ * bytes (fixed width integer keys, stored big endian). Such a tree never
+ * has more than one key per key slice, so its leaves keep no key lengths,
+ * suffixes or layers, and a leaf search is a search over the slices alone.
+ * Inserting a key of any other length is an error. Searches, removes and
+ * scan bounds may still use keys of any length
+ */
+template <typename P>
+struct fixed_key_btree_traits : public P {
+  static const bool FixedKeys = true;
+};
+
 /**
  * A concurrent, variable key length b+-tree, optimized for read heavy
  * workloads.
@@ -502,6 +560,9 @@ struct single_threaded_btree_traits : public base_btree_config {
  * This b+-tree does not manage the memory pointed to by value_type. The
  * pointer is treated completely opaquely.
  *
+ * Trees whose keys are all 8 bytes long can use fixed_key_btree_traits
+ * instead, which drops the per key length and suffix bookkeeping.
+ *
  * So far, this b+-tree has only been tested on 64-bit intel x86 processors.
  * It's correctness, as it is implemented (not conceptually), requires the
  * semantics of total store order (TSO) for correctness. To fix this, we would
@@ -747,50 +808,287 @@ private:
     inline void prefetch() const;
   };
 
+  /**
+   * A key suffix (the bytes of a key past its first slice), as a prefix
+   * followed by a tail, neither of which it owns. Suffixes stored in a
+   * leaf (see suffix_block) share the prefix with the other suffixes of
+   * the leaf- suffixes which come from a key have an empty prefix
+   */
+  struct suffix_view {
+    const uint8_t *prefix_;
+    const uint8_t *tail_;
+    uint32_t prefix_len_;
+    uint32_t tail_len_;
+
+    suffix_view()
+      : prefix_(NULL), tail_(NULL), prefix_len_(0), tail_len_(0) {}
+
+    explicit suffix_view(const varkey &k)
+      : prefix_(NULL), tail_(k.data()), prefix_len_(0), tail_len_(k.size()) {}
+
+    suffix_view(const uint8_t *prefix, size_t prefix_len,
+                const uint8_t *tail, size_t tail_len)
+      : prefix_(prefix), tail_(tail),
+        prefix_len_(prefix_len), tail_len_(tail_len) {}
+
+    inline size_t
+    size() const
+    {
+      return prefix_len_ + tail_len_;
+    }
+
+    inline uint8_t
+    operator[](size_t i) const
+    {
+      INVARIANT(i < size());
+      return i < prefix_len_ ? prefix_[i] : tail_[i - prefix_len_];
+    }
+
+    // copies bytes [p, p + n) of the suffix into dest
+    inline void
+    copy(uint8_t *dest, size_t p, size_t n) const
+    {
+      INVARIANT(p + n <= size());
+      if (p < prefix_len_) {
+        const size_t m = std::min(n, size_t(prefix_len_ - p));
+        NDB_MEMCPY(dest, prefix_ + p, m);
+        dest += m;
+        n -= m;
+        p = 0;
+      } else {
+        p -= prefix_len_;
+      }
+      if (n)
+        NDB_MEMCPY(dest, tail_ + p, n);
+    }
+
+    // memcmp() of the suffix against k, over the first
+    // min(size(), k.size()) bytes
+    inline int
+    compare_bytes(const varkey &k) const
+    {
+      const size_t n0 = std::min(size_t(prefix_len_), k.size());
+      if (n0) {
+        const int r = memcmp(prefix_, k.data(), n0);
+        if (r || n0 == k.size())
+          return r;
+      }
+      const size_t n1 = std::min(size_t(tail_len_), k.size() - n0);
+      return n1 ? memcmp(tail_, k.data() + n0, n1) : 0;
+    }
+
+    inline bool
+    operator==(const varkey &k) const
+    {
+      if (size() != k.size())
+        return false;
+      return !memcmp(prefix_, k.data(), prefix_len_) &&
+             !memcmp(tail_, k.data() + prefix_len_, tail_len_);
+    }
+
+    inline bool
+    operator!=(const varkey &k) const
+    {
+      return !operator==(k);
+    }
+
+    inline bool
+    operator<(const varkey &k) const
+    {
+      const int r = compare_bytes(k);
+      return r < 0 || (r == 0 && size() < k.size());
+    }
+
+    inline bool
+    operator>=(const varkey &k) const
+    {
+      return !operator<(k);
+    }
+
+    // same as varkey::slice()
+    inline key_slice
+    slice() const
+    {
+      key_slice ret = 0;
+      copy((uint8_t *) &ret, 0, std::min(size(), size_t(8)));
+      return util::host_endian_trfm<key_slice>()(ret);
+    }
+
+    // same as varkey::shift()
+    inline suffix_view
+    shift() const
+    {
+      INVARIANT(size() >= 8);
+      if (prefix_len_ >= 8)
+        return suffix_view(prefix_ + 8, prefix_len_ - 8, tail_, tail_len_);
+      return suffix_view(NULL, 0, tail_ + (8 - prefix_len_),
+                         tail_len_ - (8 - prefix_len_));
+    }
+
+    inline void
+    append_to(string_type &s) const
+    {
+      s.append((const char *) prefix_, prefix_len_);
+      s.append((const char *) tail_, tail_len_);
+    }
+
+    inline string_type
+    str() const
+    {
+      string_type s;
+      append_to(s);
+      return s;
+    }
+  };
+
+  /**
+   * The suffixes of a leaf's keys, packed into a single allocation. The
+   * longest prefix shared by every suffix in the block is stored once, and
+   * each slot only keeps the rest of its suffix (its tail), so a leaf of
+   * composite keys only pays for the bytes which tell its keys apart. The
+   * prefix is kept at least one byte shorter than every suffix, so an empty
+   * tail always means the slot has no suffix (a short key, or a layer).
+   * Trailing slots w/o a suffix are not stored at all.
+   *
+   * Blocks are immutable once published in a leaf: writers build a new
+   * block (make()) and free the old one w/ RCU, so a reader can hold on to
+   * a suffix_view of a block while it validates the leaf version.
+   *
+   * layout: [ header | ends_[nslots_] | prefix | tails ], where
+   * ends_[i] is the end of slot i's tail (the start of slot i + 1's),
+   * relative to the start of the tails. ends_ are uint16_t unless the
+   * tails are longer than 64KB in total
+   */
+  struct suffix_block {
+    uint32_t prefix_len_;
+    uint8_t nslots_;
+    bool wide_; // ends_ are uint32_t
+    uint16_t unused_;
+    uint8_t data_[0];
+
+    inline size_t
+    end(size_t i) const
+    {
+      INVARIANT(i < nslots_);
+      return wide_ ? ((const uint32_t *) data_)[i] :
+                     ((const uint16_t *) data_)[i];
+    }
+
+    inline const uint8_t *
+    prefix() const
+    {
+      return data_ + nslots_ * (wide_ ? sizeof(uint32_t) : sizeof(uint16_t));
+    }
+
+    inline suffix_view
+    get(size_t i) const
+    {
+      if (i >= nslots_)
+        return suffix_view();
+      const size_t b = i ? end(i - 1) : 0;
+      const size_t e = end(i);
+      if (b == e)
+        return suffix_view();
+      const uint8_t * const p = prefix();
+      return suffix_view(p, prefix_len_, p + prefix_len_ + b, e - b);
+    }
+
+    inline size_t
+    alloc_size() const
+    {
+      return prefix() + prefix_len_ + end(nslots_ - 1) - (const uint8_t *) this;
+    }
+
+    // returns NULL if none of views[0, n) is a suffix
+    static suffix_block *make(const suffix_view *views, size_t n);
+
+    static inline void
+    release(suffix_block *b)
+    {
+      if (b)
+        rcu::s_instance.dealloc_rcu(b, b->alloc_size());
+    }
+  };
+
   struct leaf_node : public node {
     union value_or_node_ptr {
       value_type v_;
       node *n_;
     };
 
+    // FixedKeys trees don't keep lengths_ at all (every key is a full
+    // slice, and never a layer)
+    static const size_t NLengths = P::FixedKeys ? 0 : NKeysPerNode;
+
+#ifdef BTREE_NODE_SEARCH_LAYOUT
+    // everything key_search() looks at (hdr_, keys_, lengths_) is packed
+    // together at the front of the node, so a search touches
+    // ceil((8 + 9 * NKeysPerNode) / CACHELINE_SIZE) lines before the value
+    // is read
+
+    // format is:
+    // [ slice_length | type | unused ]
+    // [    0:4       |  4:5 |  5:8   ]
+    uint8_t lengths_[NLengths];
+
+    key_slice min_key_; // really is min_key's key slice
+
+    leaf_node *prev_;
+    leaf_node *next_;
+
+    // NULL if no key in the leaf has a suffix
+    suffix_block *suffixes_;
+
+    value_or_node_ptr values_[NKeysPerNode];
+#else
     key_slice min_key_; // really is min_key's key slice
     value_or_node_ptr values_[NKeysPerNode];
 
     // format is:
     // [ slice_length | type | unused ]
     // [    0:4       |  4:5 |  5:8   ]
-    uint8_t lengths_[NKeysPerNode];
+    uint8_t lengths_[NLengths];
 
     leaf_node *prev_;
     leaf_node *next_;
 
-    // starts out empty- once set, doesn't get freed until dtor (even if all
-    // keys w/ suffixes get removed)
-    imstring *suffixes_;
+    // NULL if no key in the leaf has a suffix
+    suffix_block *suffixes_;
+#endif
 
-    inline ALWAYS_INLINE varkey
+    inline ALWAYS_INLINE suffix_view
     suffix(size_t i) const
     {
-      return suffixes_ ? varkey(suffixes_[i]) : varkey();
+      if (P::FixedKeys)
+        return suffix_view();
+      const suffix_block * const b = suffixes_;
+      return b ? b->get(i) : suffix_view();
     }
 
-    //static event_counter g_evt_suffixes_array_created;
-
+    // views[i] = suffix(i), for i in [0, n)
     inline void
-    alloc_suffixes()
+    load_suffixes(suffix_view *views, size_t n) const
     {
-      INVARIANT(this->is_modifying());
-      INVARIANT(!suffixes_);
-      suffixes_ = new imstring[NKeysPerNode];
-      //++g_evt_suffixes_array_created;
+      for (size_t i = 0; i < n; i++)
+        views[i] = suffix(i);
     }
 
-    inline void
-    ensure_suffixes()
+    // replaces the suffixes of slots [0, n) w/ views[0, n) (views may
+    // point into the current block). the old block is freed w/ RCU.
+    // returns the change in bytes held by suffix blocks
+    inline ssize_t
+    store_suffixes(const suffix_view *views, size_t n)
     {
       INVARIANT(this->is_modifying());
-      if (!suffixes_)
-        alloc_suffixes();
+      INVARIANT(!P::FixedKeys);
+      suffix_block * const old = suffixes_;
+      suffix_block * const b = suffix_block::make(views, n);
+      COMPILER_MEMORY_FENCE;
+      suffixes_ = b;
+      const ssize_t delta =
+        ssize_t(b ? b->alloc_size() : 0) - ssize_t(old ? old->alloc_size() : 0);
+      suffix_block::release(old);
+      return delta;
     }
 
     leaf_node();
@@ -809,10 +1107,23 @@ private:
 #endif
     }
 
+    // prefetches every line of the node, for leaves a scan will only get
+    // to later (prefetch() leaves the first line to the demand load)
+    inline void
+    prefetch_ahead() const
+    {
+#ifdef BTREE_NODE_PREFETCH
+      for (size_t i = 0; i < sizeof(*this); i += CACHELINE_SIZE)
+        ::prefetch((const char *) this + i);
+#endif
+    }
+
     inline size_t
     keyslice_length(size_t n) const
     {
       INVARIANT(n < NKeysPerNode);
+      if (P::FixedKeys)
+        return 8;
       return lengths_[n] & LEN_LEN_MASK;
     }
 
@@ -823,6 +1134,10 @@ private:
       INVARIANT(this->is_modifying());
       INVARIANT(len <= 9);
       INVARIANT(!layer || len == 9);
+      if (P::FixedKeys) {
+        INVARIANT(len == 8);
+        return;
+      }
       lengths_[n] = (len | (layer ? LEN_TYPE_MASK : 0));
     }
 
@@ -830,6 +1145,8 @@ private:
     value_is_layer(size_t n) const
     {
       INVARIANT(n < NKeysPerNode);
+      if (P::FixedKeys)
+        return false;
       return lengths_[n] & LEN_TYPE_MASK;
     }
 
@@ -840,9 +1157,32 @@ private:
       INVARIANT(this->is_modifying());
       INVARIANT(keyslice_length(n) == 9);
       INVARIANT(!value_is_layer(n));
+      ALWAYS_ASSERT(!P::FixedKeys);
       lengths_[n] |= LEN_TYPE_MASK;
     }
 
+    /**
+     * number of keys_ < k (FixedKeys trees only, where slices are unique)
+     */
+    inline size_t
+    slice_lower_bound(key_slice k, size_t n) const
+    {
+#ifdef BTREE_NODE_SIMD_SEARCH
+      return btree_simd::count_less(this->keys_, n, k);
+#else
+      size_t lower = 0;
+      size_t upper = n;
+      while (lower < upper) {
+        const size_t i = (lower + upper) / 2;
+        if (this->keys_[i] < k)
+          lower = i + 1;
+        else
+          upper = i;
+      }
+      return lower;
+#endif
+    }
+
     /**
      * keys[key_search(k).first] == k if key_search(k).first != -1
      * key does not exist otherwise. considers key length also
@@ -851,6 +1191,24 @@ private:
     key_search(key_slice k, size_t len) const
     {
       size_t n = this->key_slots_used();
+      if (P::FixedKeys) {
+        const size_t i = slice_lower_bound(k, n);
+        return key_search_ret(
+            len == 8 && i < n && this->keys_[i] == k ? ssize_t(i) : -1, n);
+      }
+#ifdef BTREE_NODE_SIMD_SEARCH
+      // slots with slice k are contiguous (ordered by length) starting at
+      // the first slot >= k
+      for (size_t i = btree_simd::count_less(this->keys_, n, k);
+           i < n && this->keys_[i] == k; i++) {
+        const size_t len0 = this->keyslice_length(i);
+        if (len0 == len)
+          return key_search_ret(i, n);
+        if (len0 > len)
+          break;
+      }
+      return key_search_ret(-1, n);
+#else
       ssize_t lower = 0;
       ssize_t upper = n;
       while (lower < upper) {
@@ -865,6 +1223,7 @@ private:
           upper = i;
       }
       return key_search_ret(-1, n);
+#endif
     }
 
     /**
@@ -876,6 +1235,27 @@ private:
     {
       ssize_t ret = -1;
       size_t n = this->key_slots_used();
+      if (P::FixedKeys) {
+        // the key in slot i (if its slice is k) is 8 bytes long
+        const size_t i = slice_lower_bound(k, n);
+        if (i < n && this->keys_[i] == k && len >= 8)
+          return key_search_ret(i, n);
+        return key_search_ret(ssize_t(i) - 1, n);
+      }
+#ifdef BTREE_NODE_SIMD_SEARCH
+      size_t i = btree_simd::count_less(this->keys_, n, k);
+      ret = ssize_t(i) - 1;
+      for (; i < n && this->keys_[i] == k; i++) {
+        const size_t len0 = this->keyslice_length(i);
+        if (len0 < len)
+          ret = i;
+        else if (len0 == len)
+          return key_search_ret(i, n);
+        else
+          break;
+      }
+      return key_search_ret(ret, n);
+#else
       ssize_t lower = 0;
       ssize_t upper = n;
       while (lower < upper) {
@@ -892,6 +1272,7 @@ private:
         }
       }
       return key_search_ret(ret, n);
+#endif
     }
 
     void
@@ -961,6 +1342,10 @@ private:
     key_search(key_slice k) const
     {
       size_t n = this->key_slots_used();
+#ifdef BTREE_NODE_SIMD_SEARCH
+      const size_t i = btree_simd::count_less(this->keys_, n, k);
+      return key_search_ret(i < n && this->keys_[i] == k ? ssize_t(i) : -1, n);
+#else
       ssize_t lower = 0;
       ssize_t upper = n;
       while (lower < upper) {
@@ -974,6 +1359,7 @@ private:
           lower = i + 1;
       }
       return key_search_ret(-1, n);
+#endif
     }
 
     /**
@@ -985,6 +1371,13 @@ private:
     {
       ssize_t ret = -1;
       size_t n = this->key_slots_used();
+#ifdef BTREE_NODE_SIMD_SEARCH
+      const size_t i = btree_simd::count_less(this->keys_, n, k);
+      if (i < n && this->keys_[i] == k)
+        return key_search_ret(i, n);
+      ret = ssize_t(i) - 1;
+      return key_search_ret(ret, n);
+#else
       ssize_t lower = 0;
       ssize_t upper = n;
       while (lower < upper) {
@@ -1000,6 +1393,7 @@ private:
         }
       }
       return key_search_ret(ret, n);
+#endif
     }
 
     void
@@ -1041,6 +1435,159 @@ private:
 
   } PACKED;
 
+  /**
+   * Hash mode (see btree()) keeps every key in a chain hanging off one of a
+   * power of two number of buckets, and never touches the tree.
+   *
+   * A bucket starts with a version laid out exactly like node::hdr_, and
+   * follows the same protocol as a leaf: readers take a stable version and
+   * re-check it after walking the chain, writers lock the bucket and mark
+   * it modifying before linking/unlinking an entry (replacing the value of
+   * an existing entry does not bump the version). So a bucket can be handed
+   * out as a node_opaque_t (search_info, insert_info, tree_walk()), which
+   * is what gives the transaction layer phantom protection for absent keys.
+   * Buckets are tagged as internal nodes w/o any keys, which no real node
+   * ever is (see IsHashBucket()).
+   *
+   * Entries are immutable once linked (except for v_), and are RCU freed.
+   * Growing the table locks and marks deleting every bucket of the old
+   * table, relinks the entries into the new one, publishes it, and RCU
+   * frees the old bucket array.
+   */
+  struct hash_entry {
+    hash_entry *next_;
+    value_type v_;
+    uint32_t hash_; // low bits of HashKey()
+    uint32_t len_;
+    uint8_t key_[0];
+
+    inline bool
+    matches(uint32_t hash, const key_type &k) const
+    {
+      return hash_ == hash && len_ == k.size() &&
+             !memcmp(key_, k.data(), len_);
+    }
+
+    inline size_t
+    alloc_size() const
+    {
+      return sizeof(hash_entry) + len_;
+    }
+
+    static inline hash_entry *
+    alloc(uint32_t hash, const key_type &k, value_type v)
+    {
+      hash_entry * const e =
+        (hash_entry *) rcu::s_instance.alloc(sizeof(hash_entry) + k.size());
+      INVARIANT(e);
+      e->next_ = NULL;
+      e->v_ = v;
+      e->hash_ = hash;
+      e->len_ = k.size();
+      NDB_MEMCPY(e->key_, k.data(), k.size());
+      return e;
+    }
+
+    static inline void
+    release(hash_entry *e)
+    {
+      rcu::s_instance.dealloc_rcu(e, e->alloc_size());
+    }
+  };
+
+  struct hash_bucket {
+    typename P::VersionType hdr_;
+    hash_entry *head_;
+
+    hash_bucket() : hdr_(VersionManip::HDR_TYPE_MASK), head_(NULL) {}
+
+    inline void lock() { VersionManip::Lock(hdr_); }
+    inline void unlock() { VersionManip::Unlock(hdr_); }
+    inline bool is_locked() const { return VersionManip::IsLocked(hdr_); }
+    inline void mark_modifying() { VersionManip::MarkModifying(hdr_); }
+    inline bool is_deleting() const { return VersionManip::IsDeleting(hdr_); }
+    inline void mark_deleting() { VersionManip::MarkDeleting(hdr_); }
+    inline uint64_t unstable_version() const { return VersionManip::UnstableVersion(hdr_); }
+    inline uint64_t stable_version() const { return VersionManip::StableVersion(hdr_); }
+    inline bool check_version(uint64_t version) const { return VersionManip::CheckVersion(hdr_, version); }
+  };
+
+  struct hash_table {
+    size_t mask_; // # of buckets - 1
+    size_t alloc_size_;
+
+    inline hash_bucket *
+    buckets()
+    {
+      return reinterpret_cast<hash_bucket *>(this + 1);
+    }
+
+    inline const hash_bucket *
+    buckets() const
+    {
+      return reinterpret_cast<const hash_bucket *>(this + 1);
+    }
+
+    inline hash_bucket &
+    bucket(uint32_t hash)
+    {
+      return buckets()[hash & mask_];
+    }
+
+    static hash_table *
+    alloc(size_t nbuckets)
+    {
+      INVARIANT(nbuckets && !(nbuckets & (nbuckets - 1)));
+      const size_t sz = sizeof(hash_table) + nbuckets * sizeof(hash_bucket);
+      hash_table * const t = (hash_table *) rcu::s_instance.alloc(sz);
+      INVARIANT(t);
+      t->mask_ = nbuckets - 1;
+      t->alloc_size_ = sz;
+      for (size_t i = 0; i < nbuckets; i++)
+        new (&t->buckets()[i]) hash_bucket;
+      return t;
+    }
+  };
+
+  // keeps buckets from straddling cache lines
+  static_assert(sizeof(hash_table) % sizeof(hash_bucket) == 0, "XX");
+
+  static const size_t HashInitialBuckets = 64;
+
+  // the table doubles once it holds more than HashMaxLoad entries per
+  // bucket. each core keeps its own running entry count, which is only
+  // summed up every HashCountCheckInterval inserts on that core
+  static const size_t HashMaxLoad = 1;
+
+  static const size_t HashCountCheckInterval = 64;
+
+  static inline uint64_t
+  HashKey(const key_type &k)
+  {
+    const uint8_t *p = k.data();
+    size_t n = k.size();
+    uint64_t h = n * 0x9e3779b97f4a7c15ULL;
+    while (n) {
+      uint64_t w = 0;
+      const size_t nb = std::min(n, sizeof(w));
+      NDB_MEMCPY(&w, p, nb);
+      h = (h ^ w) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+      p += nb;
+      n -= nb;
+    }
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 29;
+    return h;
+  }
+
+  static inline bool
+  IsHashBucket(uint64_t v)
+  {
+    return RawVersionManip::IsInternalNode(v) &&
+           !RawVersionManip::KeySlotsUsed(v);
+  }
+
 #ifdef BTREE_LOCK_OWNERSHIP_CHECKING
 public:
   static inline void
@@ -1163,8 +1710,89 @@ private:
    */
   static void recursive_delete(node *n);
 
+  // bytes held by the nodes and by the suffix blocks reachable from n,
+  // w/ the same caveats as recursive_delete()
+  static std::pair<size_t, size_t> MemUsage(const node *n);
+
+  // bytes held by hash table t and its entries (not thread safe either)
+  static size_t HashMemUsage(const hash_table *t);
+
+  // nodes (of the tree, or the hash table and its entries in hash mode) and
+  // suffix blocks are allocated and released through these, so they are
+  // accounted to node_bytes_ and suffix_bytes_. a released leaf takes its
+  // suffix block w/ it
+  inline leaf_node *
+  alloc_leaf_node()
+  {
+    node_bytes_->add(LeafNodeAllocSize);
+    return leaf_node::alloc();
+  }
+
+  inline void
+  release_leaf_node(leaf_node *n)
+  {
+    INVARIANT(n);
+    node_bytes_->add(-ssize_t(LeafNodeAllocSize));
+    if (n->suffixes_)
+      suffix_bytes_->add(-ssize_t(n->suffixes_->alloc_size()));
+    leaf_node::release(n);
+  }
+
+  inline internal_node *
+  alloc_internal_node()
+  {
+    node_bytes_->add(InternalNodeAllocSize);
+    return internal_node::alloc();
+  }
+
+  inline void
+  release_internal_node(internal_node *n)
+  {
+    INVARIANT(n);
+    node_bytes_->add(-ssize_t(InternalNodeAllocSize));
+    internal_node::release(n);
+  }
+
+  inline void
+  store_suffixes(leaf_node *leaf, const suffix_view *views, size_t n)
+  {
+    suffix_bytes_->add(leaf->store_suffixes(views, n));
+  }
+
+  // drops the accounting of everything reachable from root_ and hash_, for
+  // clear() and ~btree()
+  inline void
+  unaccount_all()
+  {
+    const std::pair<size_t, size_t> u = mem_usage();
+    node_bytes_->add(-ssize_t(u.first));
+    suffix_bytes_->add(-ssize_t(u.second));
+  }
+
   node *volatile root_;
 
+  // set for trees whose keys are mostly inserted in increasing order (see
+  // btree()). append_hint_ caches the top layer leaf which most recently had
+  // a key appended to its end, so the next append can skip the descent from
+  // the root. it is only written while holding the lock on the leaf it
+  // points to, and is cleared before that leaf is released
+  const bool mostly_append_;
+  leaf_node *volatile append_hint_;
+
+  // NULL unless this btree is in hash mode
+  hash_table *volatile hash_;
+  spinlock hash_grow_lock_;
+
+  // the number of keys in the btree, spread over per-core counters which
+  // are each only updated by their own core (so a core's count can go
+  // negative). see size_estimate()
+  percore<ssize_t, false, false> *count_;
+
+  // where the bytes of our nodes and suffix blocks are accounted (see
+  // btree())
+  event_gauge *const node_bytes_;
+  event_gauge *const suffix_bytes_;
+
 public:
 
   // XXX(stephentu): trying out a very opaque node API for now
@@ -1176,7 +1804,34 @@ public:
     uint64_t new_version;
   };
 
-  btree() : root_(leaf_node::alloc())
+  /**
+   * mostly_append hints that keys are mostly inserted in increasing order
+   * (not necessarily globally- eg increasing within each of a number of
+   * disjoint key ranges). in this case full leaves are split right after
+   * the newly inserted key instead of in the middle, so the left leaf stays
+   * full and the next key of the run lands at the end of a leaf
+   *
+   * hashed puts the btree in hash mode, for indexes which are only ever
+   * accessed by key: search(), insert(), insert_if_absent() and remove()
+   * go to a resizable hash table (see hash_bucket) instead of the tree, and
+   * range scans and bulk loads are not supported. mostly_append has no
+   * effect on a hashed btree
+   *
+   * the bytes held by the nodes (or by the hash table) are added to
+   * node_bytes, and those held by key suffix blocks to suffix_bytes. trees
+   * which are not given gauges share the btree_node_bytes and
+   * btree_suffix_bytes gauges
+   */
+  explicit btree(bool mostly_append = false, bool hashed = false,
+                 event_gauge *node_bytes = NULL,
+                 event_gauge *suffix_bytes = NULL)
+    : root_(leaf_node::alloc()),
+      mostly_append_(mostly_append),
+      append_hint_(NULL),
+      hash_(hashed ? hash_table::alloc(HashInitialBuckets) : NULL),
+      count_(new percore<ssize_t, false, false>),
+      node_bytes_(node_bytes ? node_bytes : private_::btree_default_node_bytes()),
+      suffix_bytes_(suffix_bytes ? suffix_bytes : private_::btree_default_suffix_bytes())
   {
     static_assert(
         NKeysPerNode > (sizeof(key_slice) + 2), "XX"); // so we can always do a split
@@ -1191,6 +1846,7 @@ public:
 #else
     root_->set_root();
 #endif /* CHECK_INVARIANTS */
+    node_bytes_->add(LeafNodeAllocSize + (hash_ ? HashMemUsage(hash_) : 0));
   }
 
   ~btree()
@@ -1198,8 +1854,14 @@ public:
     // NOTE: it is assumed on deletion time there are no
     // outstanding requests to the btree, so deletion proceeds
     // in a non-threadsafe manner
+    unaccount_all();
     recursive_delete(root_);
     root_ = NULL;
+    if (hash_) {
+      HashDelete(hash_);
+      hash_ = NULL;
+    }
+    delete count_;
   }
 
   /**
@@ -1208,6 +1870,14 @@ public:
   inline void
   clear()
   {
+    append_hint_ = NULL;
+    unaccount_all();
+    if (hash_) {
+      HashDelete(hash_);
+      hash_ = hash_table::alloc(HashInitialBuckets);
+    }
+    for (size_t i = 0; i < count_->size(); i++)
+      (*count_)[i] = 0;
     recursive_delete(root_);
     root_ = leaf_node::alloc();
 #ifdef CHECK_INVARIANTS
@@ -1217,13 +1887,18 @@ public:
 #else
     root_->set_root();
 #endif /* CHECK_INVARIANTS */
+    node_bytes_->add(LeafNodeAllocSize + (hash_ ? HashMemUsage(hash_) : 0));
   }
 
   /** Note: invariant checking is not thread safe */
   inline void
   invariant_checker() const
   {
+    if (hash_)
+      hash_invariant_checker();
     root_->invariant_checker(NULL, NULL, NULL, NULL, true);
+    if (!hash_)
+      ALWAYS_ASSERT(size_estimate() == size());
   }
 
           /** NOTE: the public interface assumes that the caller has taken care
@@ -1234,6 +1909,8 @@ public:
          versioned_node_t *search_info = nullptr) const
   {
     rcu_region guard;
+    if (hash_)
+      return hash_search(k, v, search_info);
     typename util::vec<leaf_node *>::type ns;
     return search_impl(k, v, ns, search_info);
   }
@@ -1262,6 +1939,20 @@ public:
      */
     virtual bool invoke(const string_type &k, value_type v,
                         const node_opaque_t *n, uint64_t version) = 0;
+
+    /**
+     * The values of the next batch of invoke() calls (all read from the
+     * same leaf node), before any of them is made. Some may end up
+     * outside the scan range. Lets callbacks prefetch what values point
+     * to, so the misses overlap instead of happening one key at a time
+     */
+    virtual void on_leaf_values(const value_type *values, size_t n) {}
+
+    /**
+     * Called once the keys read from a leaf node have all been passed to
+     * invoke(). Return false to stop the scan
+     */
+    virtual bool on_leaf_end() { return true; }
   };
 
   /**
@@ -1284,6 +1975,56 @@ public:
     virtual bool invoke(const string_type &k, value_type v) = 0;
   };
 
+  /**
+   * Hands out the pairs of a scan in batches rather than one at a time,
+   * one batch per leaf node (with layers, a batch can also carry the keys
+   * of the enclosing leaf which preceded the layer). Key i of a batch is
+   * [keys + key_offsets[i], keys + key_offsets[i + 1])
+   */
+  class batch_search_range_callback : public low_level_search_range_callback {
+  public:
+    virtual void
+    on_resp_node(const node_opaque_t *n, uint64_t version)
+    {
+    }
+
+    virtual bool
+    invoke(const string_type &k, value_type v,
+           const node_opaque_t *n, uint64_t version)
+    {
+      if (key_offsets_.empty())
+        key_offsets_.push_back(0);
+      keys_.append(k);
+      key_offsets_.push_back(keys_.size());
+      values_.push_back(v);
+      return true;
+    }
+
+    virtual bool
+    on_leaf_end()
+    {
+      if (values_.empty())
+        return true;
+      const bool ret = invoke_batch(
+          keys_.data(), key_offsets_.data(), values_.data(), values_.size());
+      keys_.clear();
+      key_offsets_.clear();
+      values_.clear();
+      return ret;
+    }
+
+    /**
+     * Return false to stop the scan after this batch
+     */
+    virtual bool invoke_batch(const char *keys, const size_t *key_offsets,
+                              const value_type *values, size_t n) = 0;
+
+  private:
+    string_type keys_;
+    std::vector<size_t> key_offsets_;
+    std::vector<value_type> values_;
+  };
+
 private:
   template <typename T>
   class type_callback_wrapper : public search_range_callback {
@@ -1304,13 +2045,13 @@ private:
     typename leaf_node::value_or_node_ptr vn_;
     bool layer_;
     size_t length_;
-    varkey suffix_;
+    suffix_view suffix_;
     leaf_kvinfo() {} // for STL
     leaf_kvinfo(key_slice key,
                 typename leaf_node::value_or_node_ptr vn,
                 bool layer,
                 size_t length,
-                const varkey &suffix)
+                const suffix_view &suffix)
       : key_(key), key_big_endian_(util::big_endian_trfm<key_slice>()(key)),
         vn_(vn), layer_(layer), length_(length), suffix_(suffix)
     {}
@@ -1429,7 +2170,12 @@ public:
          insert_info_t *insert_info = NULL)
   {
     rcu_region guard;
-    return insert_stable_location((node **) &root_, k, v, false, old_v, insert_info);
+    if (hash_)
+      return hash_insert(k, v, false, old_v, insert_info);
+    if (!insert_stable_location((node **) &root_, k, v, false, old_v, insert_info))
+      return false;
+    count_->my()++;
+    return true;
   }
 
   /**
@@ -1441,7 +2187,12 @@ public:
                    insert_info_t *insert_info = NULL)
   {
     rcu_region guard;
-    return insert_stable_location((node **) &root_, k, v, true, NULL, insert_info);
+    if (hash_)
+      return hash_insert(k, v, true, NULL, insert_info);
+    if (!insert_stable_location((node **) &root_, k, v, true, NULL, insert_info))
+      return false;
+    count_->my()++;
+    return true;
   }
 
   /**
@@ -1454,9 +2205,104 @@ public:
   remove(const key_type &k, value_type *old_v = NULL)
   {
     rcu_region guard;
-    return remove_stable_location((node **) &root_, k, old_v);
+    if (hash_)
+      return hash_remove(k, old_v);
+    if (!remove_stable_location((node **) &root_, k, old_v))
+      return false;
+    count_->my()--;
+    return true;
+  }
+
+  /**
+   * Builds a run of packed leaf nodes bottom-up from keys fed in strictly
+   * ascending order, w/o any traversals, locking or splits. bulk_load()
+   * then builds the internal nodes above one or more runs.
+   *
+   * Builders for disjoint key ranges can be filled in parallel (one thread
+   * per builder). A builder is not thread safe.
+   */
+  class bulk_builder {
+    friend class btree;
+  public:
+    // leaf_fill is the max # of slots used per leaf- it must be large
+    // enough to hold every key sharing a key slice (up to 10 slots)
+    bulk_builder(size_t leaf_fill = NKeysPerNode);
+    ~bulk_builder();
+
+    bulk_builder(const bulk_builder &) = delete;
+    bulk_builder(bulk_builder &&) = delete;
+    bulk_builder &operator=(const bulk_builder &) = delete;
+
+    // k must be greater than every key previously added
+    void add(const key_type &k, value_type v);
+
+    // # of keys added (in this layer)
+    inline size_t
+    size() const
+    {
+      return nkeys_;
+    }
+
+  private:
+    // flushes the pending key slice group into the leaves
+    void flush_group();
+    void finish();
+
+    void append_slot(key_slice k, size_t len,
+                     typename leaf_node::value_or_node_ptr v,
+                     bool layer, const std::string *suffix);
+
+    // packs the suffixes of last_ and seals it
+    void seal_last();
+
+    const size_t leaf_fill_;
+
+    // keys sharing the current slice are buffered until the slice changes,
+    // since keys longer than 8 bytes either get a suffix (if there is one)
+    // or a new layer (if there is more than one)
+    bool has_group_;
+    key_slice group_slice_;
+    std::vector<std::pair<size_t, value_type>> group_short_; // (len, v)
+    std::vector<std::pair<std::string, value_type>> group_long_; // (key[8:], v)
+
+    leaf_node *first_;
+    leaf_node *last_;
+    std::vector<std::pair<size_t, std::string>> last_suffixes_; // (slot, key[8:])
+    size_t nleaves_;
+    size_t nkeys_;
+  };
+
+  /**
+   * Replaces the contents of this tree, which must be empty, with the runs
+   * built by builders. builders must be in ascending key order, and the
+   * ranges must not share a key slice (the first 8 bytes of a key) across
+   * two builders. The builders are left empty.
+   *
+   * NOT THREAD SAFE
+   */
+  void bulk_load(const std::vector<bulk_builder *> &builders);
+
+  inline void
+  bulk_load(bulk_builder &builder)
+  {
+    bulk_load(std::vector<bulk_builder *>(1, &builder));
   }
 
+private:
+  // builds the internal levels above a chain of nleaves (> 0) leaves,
+  // returning the root (which is not marked as such)
+  static node *BulkBuildInternalLevels(leaf_node *first, size_t nleaves);
+
+  // builds one level of internal nodes over nchildren children, given by
+  // successive calls to next() => (child, min key slice of child)
+  template <typename NextFn>
+  static std::vector<std::pair<node *, key_slice>>
+  BulkBuildLevel(size_t nchildren, NextFn next);
+
+  static leaf_node *BulkAllocLeaf();
+  static void BulkSealNode(node *n);
+  static void BulkSetRoot(node *n);
+
 private:
   bool
   insert_stable_location(node **root_location, const key_type &k, value_type v,
@@ -1466,6 +2312,20 @@ private:
   bool
   remove_stable_location(node **root_location, const key_type &k, value_type *old_v);
 
+  // hash mode counterparts of the above
+  bool hash_search(const key_type &k, value_type &v,
+                   versioned_node_t *search_info) const;
+  bool hash_insert(const key_type &k, value_type v, bool only_if_absent,
+                   value_type *old_v, insert_info_t *insert_info);
+  bool hash_remove(const key_type &k, value_type *old_v);
+
+  // doubles the size of t, unless some other thread already replaced it
+  void hash_grow(hash_table *t);
+  void hash_invariant_checker() const;
+
+  // NOT THREAD SAFE. frees t along with all of its entries
+  static void HashDelete(hash_table *t);
+
 public:
 
   /**
@@ -1492,6 +2352,8 @@ public:
   void tree_walk(tree_walk_callback &callback) const;
 
 private:
+  void hash_tree_walk(tree_walk_callback &callback) const;
+
   class size_walk_callback : public tree_walk_callback {
   public:
     size_walk_callback() : spec_size_(0), size_(0) {}
@@ -1518,6 +2380,52 @@ public:
     return c.get_size();
   }
 
+  /**
+   * [node bytes, suffix bytes] held by this tree, by walking it. this is
+   * what the tree accounts to its gauges (see btree()). Is not thread safe
+   */
+  inline std::pair<size_t, size_t>
+  mem_usage() const
+  {
+    std::pair<size_t, size_t> ret = MemUsage(root_);
+    if (hash_)
+      ret.first += HashMemUsage(hash_);
+    return ret;
+  }
+
+  /**
+   * The number of keys in the btree, from per-core counters of inserts and
+   * removes instead of a tree walk- cheap enough to poll often. Exact
+   * when there are no concurrent modifications, otherwise it may miss
+   * modifications which are in progress
+   */
+  inline size_t
+  size_estimate() const
+  {
+    ssize_t total = 0;
+    for (size_t i = 0; i < count_->size(); i++)
+      total += (*count_)[i];
+    return std::max(total, ssize_t(0));
+  }
+
+  /**
+   * Returns (at most) n - 1 keys, in increasing order, which split the
+   * btree into n key ranges of about the same number of keys, eg for
+   * partitioning a scan over n workers: range i is [ret[i - 1], ret[i]).
+   *
+   * The boundaries are sampled from the separator keys of the shallowest
+   * level of the btree which has at least QuantileSamplesPerRange * n
+   * nodes, so this only reads the top few levels, but how even the ranges
+   * are depends on how evenly full the nodes below are. Boundaries are
+   * prefixes of at most 8 bytes (a key slice), so keys sharing their first
+   * 8 bytes always end up in the same range.
+   *
+   * Is thread-safe. Not supported in hash mode
+   */
+  std::vector<string_type> key_quantiles(size_t n) const;
+
+  static const size_t QuantileSamplesPerRange = 8;
+
   static inline uint64_t
   ExtractVersionNumber(const node_opaque_t *n)
   {
@@ -1531,6 +2439,11 @@ public:
   static std::vector< std::pair<value_type, bool> >
   ExtractValues(const node_opaque_t *n);
 
+  // bytes n keeps outside of the node for its keys' suffixes (0 for nodes
+  // other than leaves)
+  static size_t
+  ExtractSuffixBytes(const node_opaque_t *n);
+
   void print() {
   }
 
@@ -1570,18 +2483,6 @@ private:
       array[i] = array[i - k];
   }
 
-  // use swap() to do moves, for efficiency- avoid this
-  // variant when using primitive arrays
-  template <typename T>
-  static inline ALWAYS_INLINE void
-  sift_swap_right(T *array, size_t p, size_t n, size_t k = 1)
-  {
-    if (k == 0)
-      return;
-    for (size_t i = n + k - 1; i > p + k - 1; i--)
-      array[i].swap(array[i - k]);
-  }
-
   /**
    * Move the array slice from [p + k, n) to the left by k positions, occupying [p, n - k),
    * overwriting array[p]..array[p+k-1] Has no effect if p + k >= n
@@ -1596,16 +2497,6 @@ private:
       array[i] = array[i + k];
   }
 
-  template <typename T>
-  static inline ALWAYS_INLINE void
-  sift_swap_left(T *array, size_t p, size_t n, size_t k = 1)
-  {
-    if (unlikely(p + k >= n))
-      return;
-    for (size_t i = p; i < n - k; i++)
-      array[i].swap(array[i + k]);
-  }
-
   /**
    * Copy [p, n) from source into dest. Has no effect if p >= n
    */
@@ -1617,14 +2508,6 @@ private:
       *dest++ = source[i];
   }
 
-  template <typename T>
-  static inline ALWAYS_INLINE void
-  swap_with(T *dest, T *source, size_t p, size_t n)
-  {
-    for (size_t i = p; i < n; i++)
-      (dest++)->swap(source[i]);
-  }
-
   leaf_node *leftmost_descend_layer(node *n) const;
 
   /**
@@ -1688,7 +2571,20 @@ private:
           key_slice &min_key,
           node *&new_node,
           typename util::vec<insert_parent_entry>::type &parents,
-          typename util::vec<node *>::type &locked_nodes);
+          typename util::vec<node *>::type &locked_nodes,
+          bool top_layer);
+
+  // split point for a mostly_append insert of kslice at pos into a full leaf,
+  // which keeps the new key last in the left leaf. 0 if the key slices in the
+  // leaf do not allow splitting there
+  static size_t AppendSplitPoint(const leaf_node *leaf, size_t pos, key_slice kslice);
+
+  inline ALWAYS_INLINE void
+  clear_append_hint(const leaf_node *leaf)
+  {
+    if (unlikely(append_hint_ == leaf))
+      append_hint_ = NULL;
+  }
 
   enum remove_status {
     R_NONE_NOMOD,
@@ -1713,16 +2609,21 @@ private:
       leaf->values_[pos].n_->mark_deleting();
       INVARIANT(leaf->values_[pos].n_->is_leaf_node());
       INVARIANT(leaf->values_[pos].n_->key_slots_used() == 0);
-      leaf_node::release((leaf_node *) leaf->values_[pos].n_);
+      release_leaf_node((leaf_node *) leaf->values_[pos].n_);
 #ifdef CHECK_INVARIANTS
       leaf->values_[pos].n_->unlock();
 #endif
     }
     sift_left(leaf->keys_, pos, n);
     sift_left(leaf->values_, pos, n);
-    sift_left(leaf->lengths_, pos, n);
-    if (leaf->suffixes_)
-      sift_swap_left(leaf->suffixes_, pos, n);
+    if (!P::FixedKeys)
+      sift_left(leaf->lengths_, pos, n);
+    if (leaf->suffixes_) {
+      suffix_view sv[NKeysPerNode];
+      leaf->load_suffixes(sv, n);
+      sift_left(sv, pos, n);
+      store_suffixes(leaf, sv, n - 1);
+    }
     leaf->dec_key_slots_used();
   }
 
@@ -1791,4 +2692,8 @@ extern void TestConcurrentBtreeSlow();
 #if !NDB_MASSTREE
 typedef btree<concurrent_btree_traits> concurrent_btree;
 typedef btree<single_threaded_btree_traits> single_threaded_btree;
+typedef btree<fixed_key_btree_traits<concurrent_btree_traits>>
+  concurrent_fixed_key_btree;
+typedef btree<fixed_key_btree_traits<single_threaded_btree_traits>>
+  single_threaded_fixed_key_btree;
 #endif
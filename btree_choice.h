@@ -2,6 +2,9 @@
 
 #if NDB_MASSTREE
 #include "masstree_btree.h"
+// masstree has no fixed width key specialization
+typedef concurrent_btree concurrent_fixed_key_btree;
+typedef single_threaded_btree single_threaded_fixed_key_btree;
 #else
 #include "btree.h"
 #include "btree_impl.h"
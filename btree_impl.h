@@ -32,21 +32,21 @@ btree<P>::node::base_invariant_unique_keys_check() const
     prev.first = keys_[0];
     prev.second = leaf->keyslice_length(0);
     ALWAYS_ASSERT(prev.second <= 9);
-    ALWAYS_ASSERT(!leaf->is_layer(0) || prev.second == 9);
-    if (!leaf->is_layer(0) && prev.second == 9) {
-      ALWAYS_ASSERT(leaf->suffixes_);
-      ALWAYS_ASSERT(leaf->suffixes_[0].size() >= 1);
-    }
+    ALWAYS_ASSERT(!leaf->value_is_layer(0) || prev.second == 9);
+    if (!leaf->value_is_layer(0) && prev.second == 9)
+      ALWAYS_ASSERT(leaf->suffix(0).size() >= 1);
+    else
+      ALWAYS_ASSERT(!leaf->suffix(0).size());
     for (size_t i = 1; i < n; i++) {
       leaf_key cur_key;
       cur_key.first = keys_[i];
       cur_key.second = leaf->keyslice_length(i);
       ALWAYS_ASSERT(cur_key.second <= 9);
-      ALWAYS_ASSERT(!leaf->is_layer(i) || cur_key.second == 9);
-      if (!leaf->is_layer(i) && cur_key.second == 9) {
-        ALWAYS_ASSERT(leaf->suffixes_);
-        ALWAYS_ASSERT(leaf->suffixes_[i].size() >= 1);
-      }
+      ALWAYS_ASSERT(!leaf->value_is_layer(i) || cur_key.second == 9);
+      if (!leaf->value_is_layer(i) && cur_key.second == 9)
+        ALWAYS_ASSERT(leaf->suffix(i).size() >= 1);
+      else
+        ALWAYS_ASSERT(!leaf->suffix(i).size());
       ALWAYS_ASSERT(cur_key > prev);
       prev = cur_key;
     }
@@ -103,8 +103,6 @@ btree<P>::node::invariant_checker(const key_slice *min_key,
 //static event_counter evt_btree_leaf_node_creates("btree_leaf_node_creates");
 //static event_counter evt_btree_leaf_node_deletes("btree_leaf_node_deletes");
 
-//event_counter btree<P>::leaf_node::g_evt_suffixes_array_created("btree_leaf_node_suffix_array_creates");
-
 template <typename P>
 btree<P>::leaf_node::leaf_node()
   : node(), min_key_(0), prev_(NULL), next_(NULL), suffixes_(NULL)
@@ -116,11 +114,75 @@ template <typename P>
 btree<P>::leaf_node::~leaf_node()
 {
   if (suffixes_)
-    delete [] suffixes_;
-  //suffixes_ = NULL;
+    rcu::s_instance.dealloc(suffixes_, suffixes_->alloc_size());
   //++evt_btree_leaf_node_deletes;
 }
 
+template <typename P>
+typename btree<P>::suffix_block *
+btree<P>::suffix_block::make(const suffix_view *views, size_t n)
+{
+  while (n && !views[n - 1].size())
+    n--;
+  if (!n)
+    return NULL;
+  INVARIANT(n <= NKeysPerNode);
+
+  // the prefix is the longest prefix common to all suffixes, minus
+  // however much it takes to leave every tail at least one byte
+  const suffix_view *first = NULL;
+  size_t prefix_len = 0;
+  for (size_t i = 0; i < n; i++) {
+    const suffix_view &v = views[i];
+    if (!v.size())
+      continue;
+    if (!first) {
+      first = &v;
+      prefix_len = v.size() - 1;
+      continue;
+    }
+    prefix_len = std::min(prefix_len, v.size() - 1);
+    // views of the same block share its prefix
+    size_t j = v.prefix_ == first->prefix_ ?
+      std::min(prefix_len, size_t(std::min(v.prefix_len_, first->prefix_len_))) : 0;
+    while (j < prefix_len && v[j] == (*first)[j])
+      j++;
+    prefix_len = j;
+  }
+
+  size_t tails_len = 0;
+  for (size_t i = 0; i < n; i++)
+    if (views[i].size())
+      tails_len += views[i].size() - prefix_len;
+  const bool wide = tails_len > std::numeric_limits<uint16_t>::max();
+  const size_t ends_len = n * (wide ? sizeof(uint32_t) : sizeof(uint16_t));
+  const size_t sz = sizeof(suffix_block) + ends_len + prefix_len + tails_len;
+
+  suffix_block * const b = (suffix_block *) rcu::s_instance.alloc(sz);
+  INVARIANT(b);
+  b->prefix_len_ = prefix_len;
+  b->nslots_ = n;
+  b->wide_ = wide;
+  b->unused_ = 0;
+  uint8_t * const prefix = b->data_ + ends_len;
+  first->copy(prefix, 0, prefix_len);
+  uint8_t * const tails = prefix + prefix_len;
+  size_t end = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (views[i].size()) {
+      const size_t len = views[i].size() - prefix_len;
+      views[i].copy(tails + end, prefix_len, len);
+      end += len;
+    }
+    if (wide)
+      ((uint32_t *) b->data_)[i] = end;
+    else
+      ((uint16_t *) b->data_)[i] = end;
+  }
+  INVARIANT(b->alloc_size() == sz);
+  return b;
+}
+
 template <typename P>
 void
 btree<P>::leaf_node::invariant_checker_impl(const key_slice *min_key,
@@ -134,9 +196,10 @@ btree<P>::leaf_node::invariant_checker_impl(const key_slice *min_key,
   ALWAYS_ASSERT(!is_root || min_key == NULL);
   ALWAYS_ASSERT(!is_root || max_key == NULL);
   ALWAYS_ASSERT(is_root || this->key_slots_used() > 0);
+  ALWAYS_ASSERT(!P::FixedKeys || !suffixes_);
   size_t n = this->key_slots_used();
   for (size_t i = 0; i < n; i++)
-    if (this->is_layer(i))
+    if (this->value_is_layer(i))
       this->values_[i].n_->invariant_checker(NULL, NULL, NULL, NULL, true);
 }
 
@@ -210,7 +273,7 @@ btree<P>::recursive_delete(node *n)
 #endif
     size_t n = leaf->key_slots_used();
     for (size_t i = 0; i < n; i++)
-      if (leaf->is_layer(i))
+      if (leaf->value_is_layer(i))
         recursive_delete(leaf->values_[i].n_);
     leaf_node::deleter(leaf);
   } else {
@@ -227,6 +290,46 @@ btree<P>::recursive_delete(node *n)
   }
 }
 
+template <typename P>
+std::pair<size_t, size_t>
+btree<P>::MemUsage(const node *n)
+{
+  std::pair<size_t, size_t> ret(0, 0);
+  if (const leaf_node *leaf = AsLeafCheck(n)) {
+    ret.first += LeafNodeAllocSize;
+    if (leaf->suffixes_)
+      ret.second += leaf->suffixes_->alloc_size();
+    const size_t n = leaf->key_slots_used();
+    for (size_t i = 0; i < n; i++)
+      if (leaf->value_is_layer(i)) {
+        const std::pair<size_t, size_t> l = MemUsage(leaf->values_[i].n_);
+        ret.first += l.first;
+        ret.second += l.second;
+      }
+  } else {
+    const internal_node *internal = AsInternal(n);
+    ret.first += InternalNodeAllocSize;
+    const size_t n = internal->key_slots_used();
+    for (size_t i = 0; i < n + 1; i++) {
+      const std::pair<size_t, size_t> c = MemUsage(internal->children_[i]);
+      ret.first += c.first;
+      ret.second += c.second;
+    }
+  }
+  return ret;
+}
+
+template <typename P>
+size_t
+btree<P>::HashMemUsage(const hash_table *t)
+{
+  size_t ret = t->alloc_size_;
+  for (size_t i = 0; i <= t->mask_; i++)
+    for (const hash_entry *e = t->buckets()[i].head_; e; e = e->next_)
+      ret += e->alloc_size();
+  return ret;
+}
+
 //STATIC_COUNTER_DECL(scopedperf::tsc_ctr, btree_search_impl_tsc, btree_search_impl_perf_cg);
 
 template <typename P>
@@ -278,9 +381,9 @@ process:
       if (ret != -1) {
         // found
         typename leaf_node::value_or_node_ptr vn = leaf->values_[ret];
-        const bool is_layer = leaf->is_layer(ret);
+        const bool is_layer = leaf->value_is_layer(ret);
         INVARIANT(!is_layer || kslicelen == 9);
-        varkey suffix(leaf->suffix(ret));
+        const suffix_view suffix(leaf->suffix(ret));
         if (unlikely(!leaf->check_version(version)))
           goto process;
         leaf_nodes.push_back(leaf);
@@ -404,6 +507,18 @@ btree<P>::search_range_at_layer(
   //prefix.reserve(prefix_size + 8); // allow for next layer
   const uint64_t upper_slice = upper ? upper->slice() : 0;
   string_restore<string_type> restorer(prefix, prefix_size);
+
+  // once the scan moves past its first leaf, we keep the next few leaves
+  // prefetched: prefetch_cursor is the last leaf prefetched, nahead how
+  // many leaves past leaf it is. each step only reads the next_ pointer
+  // of a leaf which was prefetched on an earlier step, so the scan is not
+  // stuck behind one dependent miss per leaf. like readahead, the window
+  // grows by one leaf per leaf scanned (up to ScanPrefetchLeaves), so
+  // short scans don't pull in leaves they never get to. these are racy
+  // reads, but only ever used as prefetch hints
+  const leaf_node *prefetch_cursor = nullptr;
+  size_t nahead = 0, window = 0;
+
   while (!upper || next_key <= upper_slice) {
     leaf->prefetch();
 
@@ -419,9 +534,27 @@ btree<P>::search_range_at_layer(
       // try from left_sibling
       leaf = left_sibling;
       INVARIANT(leaf);
+      if (prefetch_cursor) {
+        prefetch_cursor = leaf;
+        nahead = 0;
+      }
       continue;
     }
 
+    if (prefetch_cursor) {
+      while (nahead < window) {
+        const leaf_node *const n = prefetch_cursor->next_;
+        if (!n || (upper && n->min_key_ > upper_slice))
+          break;
+        n->prefetch_ahead();
+        prefetch_cursor = n;
+        nahead++;
+      }
+    }
+
+    value_type values[NKeysPerNode];
+    size_t nvalues = 0;
+
     // grab all keys in [lower_slice, upper_slice]. we'll do boundary condition
     // checking later (outside of the critical section)
     for (size_t i = 0; i < leaf->key_slots_used(); i++) {
@@ -430,13 +563,16 @@ btree<P>::search_range_at_layer(
       if ((leaf->keys_[i] > lower_slice ||
            (leaf->keys_[i] == lower_slice &&
             leaf->keyslice_length(i) >= std::min(lower.size(), size_t(9)))) &&
-          (!upper || leaf->keys_[i] <= upper_slice))
+          (!upper || leaf->keys_[i] <= upper_slice)) {
         buf.emplace_back(
             leaf->keys_[i],
             leaf->values_[i],
-            leaf->is_layer(i),
+            leaf->value_is_layer(i),
             leaf->keyslice_length(i),
             leaf->suffix(i));
+        if (!buf.back().layer_)
+          values[nvalues++] = buf.back().vn_.v_;
+      }
     }
 
     leaf_node *const right_sibling = leaf->next_;
@@ -446,6 +582,8 @@ btree<P>::search_range_at_layer(
       continue;
 
     callback.on_resp_node(leaf, RawVersionManip::Version(version));
+    if (nvalues)
+      callback.on_leaf_values(&values[0], nvalues);
 
     for (size_t i = 0; i < buf.size(); i++) {
       // check to see if we already omitted a key <= buf[i]: if so, don't omit it
@@ -493,7 +631,7 @@ btree<P>::search_range_at_layer(
           }
         }
         if (buf[i].length_ == 9)
-          prefix.append((const char *) buf[i].suffix_.data(), buf[i].suffix_.size());
+          buf[i].suffix_.append_to(prefix);
         // we give the actual version # minus all the other bits, b/c they are not
         // important here and make comparison easier at higher layers
         if (!callback.invoke(prefix, buf[i].vn_.v_, leaf, RawVersionManip::Version(version)))
@@ -504,10 +642,26 @@ btree<P>::search_range_at_layer(
       emitted_last_keyslice = true;
     }
 
+    if (!callback.on_leaf_end())
+      return false;
+
     if (!right_sibling)
       // we're done
       return true;
 
+    if (P::ScanPrefetchLeaves) {
+      if (!prefetch_cursor) {
+        prefetch_cursor = leaf;
+        nahead = 0;
+      }
+      if (nahead)
+        nahead--;
+      else
+        prefetch_cursor = right_sibling;
+      if (window < P::ScanPrefetchLeaves)
+        window++;
+    }
+
     next_key = leaf_max_key;
     leaf = right_sibling;
   }
@@ -524,6 +678,8 @@ btree<P>::search_range_call(const key_type &lower,
 {
   rcu_region guard;
   INVARIANT(rcu::s_instance.in_rcu_region());
+  // hash mode keeps no key order to scan in
+  ALWAYS_ASSERT(!hash_);
   if (unlikely(upper && *upper <= lower))
     return;
   typename util::vec<leaf_node *>::type leaf_nodes;
@@ -614,6 +770,243 @@ retry:
   return false;
 }
 
+template <typename P>
+bool
+btree<P>::hash_search(const key_type &k, value_type &v,
+                      versioned_node_t *search_info) const
+{
+  INVARIANT(rcu::s_instance.in_rcu_region());
+  const uint32_t h = HashKey(k);
+retry:
+  const hash_bucket &b = hash_->bucket(h);
+  const uint64_t version = b.stable_version();
+  if (unlikely(RawVersionManip::IsDeleting(version))) {
+    // the table is being grown
+    nop_pause();
+    goto retry;
+  }
+  const hash_entry *e = b.head_;
+  value_type ev = 0;
+  for (; e; e = e->next_) {
+    if (e->matches(h, k)) {
+      ev = e->v_;
+      break;
+    }
+  }
+  if (unlikely(!b.check_version(version)))
+    goto retry;
+  if (search_info) {
+    search_info->first = (const node_opaque_t *) &b;
+    search_info->second = RawVersionManip::Version(version);
+  }
+  if (!e)
+    return false;
+  v = ev;
+  return true;
+}
+
+template <typename P>
+bool
+btree<P>::hash_insert(const key_type &k, value_type v, bool only_if_absent,
+                      value_type *old_v, insert_info_t *insert_info)
+{
+  INVARIANT(rcu::s_instance.in_rcu_region());
+  const uint32_t h = HashKey(k);
+retry:
+  hash_table * const t = hash_;
+  hash_bucket &b = t->bucket(h);
+  b.lock();
+  if (unlikely(b.is_deleting())) {
+    b.unlock();
+    goto retry;
+  }
+  for (hash_entry *e = b.head_; e; e = e->next_) {
+    if (e->matches(h, k)) {
+      if (!only_if_absent) {
+        if (old_v)
+          *old_v = e->v_;
+        // not a structural change, so no version bump (same as the tree)
+        e->v_ = v;
+      }
+      b.unlock();
+      return false;
+    }
+  }
+  hash_entry * const e = hash_entry::alloc(h, k, v);
+  node_bytes_->add(e->alloc_size());
+  b.mark_modifying();
+  e->next_ = b.head_;
+  b.head_ = e;
+  if (insert_info) {
+    insert_info->node = (const node_opaque_t *) &b;
+    insert_info->old_version = RawVersionManip::Version(b.unstable_version()); // we hold lock on bucket
+    insert_info->new_version = insert_info->old_version + 1;
+  }
+  b.unlock();
+  ssize_t &count = count_->my();
+  if (unlikely(!(++count % ssize_t(HashCountCheckInterval))) &&
+      size_estimate() > HashMaxLoad * (t->mask_ + 1))
+    hash_grow(t);
+  return true;
+}
+
+template <typename P>
+bool
+btree<P>::hash_remove(const key_type &k, value_type *old_v)
+{
+  INVARIANT(rcu::s_instance.in_rcu_region());
+  const uint32_t h = HashKey(k);
+retry:
+  hash_bucket &b = hash_->bucket(h);
+  b.lock();
+  if (unlikely(b.is_deleting())) {
+    b.unlock();
+    goto retry;
+  }
+  for (hash_entry **pe = &b.head_; *pe; pe = &(*pe)->next_) {
+    hash_entry * const e = *pe;
+    if (!e->matches(h, k))
+      continue;
+    b.mark_modifying();
+    *pe = e->next_;
+    b.unlock();
+    if (old_v)
+      *old_v = e->v_;
+    node_bytes_->add(-ssize_t(e->alloc_size()));
+    hash_entry::release(e);
+    count_->my()--;
+    return true;
+  }
+  b.unlock();
+  return false;
+}
+
+template <typename P>
+void
+btree<P>::hash_grow(hash_table *t)
+{
+  INVARIANT(rcu::s_instance.in_rcu_region());
+  if (!hash_grow_lock_.try_lock())
+    // somebody else is growing the table
+    return;
+  if (hash_ != t) {
+    hash_grow_lock_.unlock();
+    return;
+  }
+  const size_t n = t->mask_ + 1;
+  hash_table * const nt = hash_table::alloc(2 * n);
+  node_bytes_->add(ssize_t(nt->alloc_size_) - ssize_t(t->alloc_size_));
+  // readers which are in the middle of a chain when it gets relinked can
+  // wander off into a chain of the new table, but they will not pass the
+  // version check of the old bucket. nobody can write to nt before it is
+  // published, so its buckets need no locking
+  for (size_t i = 0; i < n; i++) {
+    hash_bucket &b = t->buckets()[i];
+    b.lock();
+    b.mark_deleting();
+    hash_entry *e = b.head_;
+    while (e) {
+      hash_entry * const next = e->next_;
+      hash_bucket &nb = nt->bucket(e->hash_);
+      e->next_ = nb.head_;
+      nb.head_ = e;
+      e = next;
+    }
+  }
+  COMPILER_MEMORY_FENCE;
+  hash_ = nt;
+  // bumps the versions of the old buckets, so transactions which read an
+  // absent key from one of them will abort
+  for (size_t i = 0; i < n; i++)
+    t->buckets()[i].unlock();
+  rcu::s_instance.dealloc_rcu(t, t->alloc_size_);
+  hash_grow_lock_.unlock();
+}
+
+template <typename P>
+void
+btree<P>::hash_tree_walk(tree_walk_callback &callback) const
+{
+  INVARIANT(rcu::s_instance.in_rcu_region());
+  // the table can only grow while we walk it, and bucket j of a larger
+  // table only holds entries which used to be in bucket (j & mask) of a
+  // smaller one. so for each table we moved off of, we remember (mask, # of
+  // its buckets walked), and skip the buckets of later tables which were
+  // already covered
+  std::vector<std::pair<size_t, size_t>> walked;
+  const hash_table *t = hash_;
+  size_t i = 0;
+  while (i <= t->mask_) {
+    bool skip = false;
+    for (auto &w : walked)
+      if ((i & w.first) < w.second) {
+        skip = true;
+        break;
+      }
+    if (skip) {
+      i++;
+      continue;
+    }
+    const hash_bucket &b = t->buckets()[i];
+  process:
+    const uint64_t version = b.stable_version();
+    if (unlikely(RawVersionManip::IsDeleting(version))) {
+      walked.emplace_back(t->mask_, i);
+      while (hash_ == t)
+        nop_pause();
+      t = hash_;
+      i = 0;
+      continue;
+    }
+    callback.on_node_begin((const node_opaque_t *) &b);
+    if (unlikely(!b.check_version(version))) {
+      callback.on_node_failure();
+      goto process;
+    }
+    callback.on_node_success();
+    i++;
+  }
+}
+
+template <typename P>
+void
+btree<P>::hash_invariant_checker() const
+{
+  const hash_table * const t = hash_;
+  ALWAYS_ASSERT(t->mask_ + 1 >= HashInitialBuckets);
+  ALWAYS_ASSERT(!(t->mask_ & (t->mask_ + 1)));
+  size_t nentries = 0;
+  for (size_t i = 0; i <= t->mask_; i++) {
+    const hash_bucket &b = t->buckets()[i];
+    ALWAYS_ASSERT(!b.is_locked());
+    ALWAYS_ASSERT(!b.is_deleting());
+    ALWAYS_ASSERT(IsHashBucket(b.unstable_version()));
+    for (const hash_entry *e = b.head_; e; e = e->next_) {
+      ALWAYS_ASSERT((e->hash_ & t->mask_) == i);
+      ALWAYS_ASSERT(e->hash_ == uint32_t(HashKey(varkey(e->key_, e->len_))));
+      for (const hash_entry *e0 = b.head_; e0 != e; e0 = e0->next_)
+        ALWAYS_ASSERT(!e0->matches(e->hash_, varkey(e->key_, e->len_)));
+      nentries++;
+    }
+  }
+  ALWAYS_ASSERT(size_estimate() == nentries);
+}
+
+template <typename P>
+void
+btree<P>::HashDelete(hash_table *t)
+{
+  for (size_t i = 0; i <= t->mask_; i++) {
+    hash_entry *e = t->buckets()[i].head_;
+    while (e) {
+      hash_entry * const next = e->next_;
+      rcu::s_instance.dealloc(e, e->alloc_size());
+      e = next;
+    }
+  }
+  rcu::s_instance.dealloc(t, t->alloc_size_);
+}
+
 template <typename P>
 typename btree<P>::leaf_node *
 btree<P>::leftmost_descend_layer(node *n) const
@@ -637,6 +1030,10 @@ btree<P>::tree_walk(tree_walk_callback &callback) const
 {
   rcu_region guard;
   INVARIANT(rcu::s_instance.in_rcu_region());
+  if (hash_) {
+    hash_tree_walk(callback);
+    return;
+  }
   std::vector<node *> q;
   // XXX: not sure if cast is safe
   q.push_back((node *) root_);
@@ -653,7 +1050,7 @@ btree<P>::tree_walk(tree_walk_callback &callback) const
       const size_t n = leaf->key_slots_used();
       std::vector<node *> layers;
       for (size_t i = 0; i < n; i++)
-        if (leaf->is_layer(i))
+        if (leaf->value_is_layer(i))
           layers.push_back(leaf->values_[i].n_);
       leaf_node *next = leaf->next_;
       callback.on_node_begin(leaf);
@@ -672,12 +1069,17 @@ template <typename P>
 void
 btree<P>::size_walk_callback::on_node_begin(const node_opaque_t *n)
 {
-  INVARIANT(n->is_leaf_node());
   INVARIANT(spec_size_ == 0);
+  if (IsHashBucket(n->unstable_version())) {
+    for (const hash_entry *e = ((const hash_bucket *) n)->head_; e; e = e->next_)
+      spec_size_++;
+    return;
+  }
+  INVARIANT(n->is_leaf_node());
   const leaf_node *leaf = (const leaf_node *) n;
   const size_t sz = leaf->key_slots_used();
   for (size_t i = 0; i < sz; i++)
-    if (!leaf->is_layer(i))
+    if (!leaf->value_is_layer(i))
       spec_size_++;
 }
 
@@ -822,7 +1224,8 @@ btree<P>::insert0(node *np,
                   key_slice &min_key,
                   node *&new_node,
                   typename util::vec<insert_parent_entry>::type &parents,
-                  typename util::vec<node *>::type &locked_nodes)
+                  typename util::vec<node *>::type &locked_nodes,
+                  bool top_layer)
 {
   uint64_t kslice = k.slice();
   size_t kslicelen = std::min(k.size(), size_t(9));
@@ -843,7 +1246,7 @@ retry_cur_leaf:
     if (lenmatch != -1) {
       // exact match case
       if (kslicelen <= 8 ||
-          (!resp_leaf->is_layer(lenmatch) &&
+          (!resp_leaf->value_is_layer(lenmatch) &&
            resp_leaf->suffix(lenmatch) == k.shift())) {
         const uint64_t locked_version = resp_leaf->lock();
         if (unlikely(!btree::CheckVersion(version, locked_version))) {
@@ -861,7 +1264,7 @@ retry_cur_leaf:
         return UnlockAndReturn(locked_nodes, I_NONE_NOMOD);
       }
       INVARIANT(kslicelen == 9);
-      if (resp_leaf->is_layer(lenmatch)) {
+      if (resp_leaf->value_is_layer(lenmatch)) {
         node *subroot = resp_leaf->values_[lenmatch].n_;
         INVARIANT(subroot);
         if (unlikely(!resp_leaf->check_version(version)))
@@ -872,7 +1275,7 @@ retry_cur_leaf:
         typename util::vec<node *>::type sub_locked_nodes;
         const insert_status status =
           insert0(subroot, k.shift(), v, only_if_absent, old_v, insert_info,
-              mk, ret, subparents, sub_locked_nodes);
+              mk, ret, subparents, sub_locked_nodes, false);
 
         switch (status) {
         case I_NONE_NOMOD:
@@ -900,13 +1303,13 @@ retry_cur_leaf:
           }
 
           INVARIANT(lenmatch != -1);
-          INVARIANT(resp_leaf->is_layer(lenmatch));
+          INVARIANT(resp_leaf->value_is_layer(lenmatch));
           subroot = resp_leaf->values_[lenmatch].n_;
           INVARIANT(subroot->is_modifying());
           INVARIANT(subroot->is_lock_owner());
           INVARIANT(subroot->is_root());
 
-          internal_node *new_root = internal_node::alloc();
+          internal_node *new_root = alloc_internal_node();
 #ifdef CHECK_INVARIANTS
           new_root->lock();
           new_root->mark_modifying();
@@ -934,7 +1337,7 @@ retry_cur_leaf:
         }
         locked_nodes.push_back(resp_leaf);
 
-        INVARIANT(resp_leaf->suffixes_); // b/c lenmatch != -1 and this is not a layer
+        INVARIANT(resp_leaf->suffix(lenmatch).size()); // b/c lenmatch != -1 and this is not a layer
         // need to create a new btree layer, and add both existing key and
         // new key to it
 
@@ -942,26 +1345,27 @@ retry_cur_leaf:
         // value and the type atomically
         resp_leaf->mark_modifying();
 
-        leaf_node *new_root = leaf_node::alloc();
+        leaf_node *new_root = alloc_leaf_node();
 #ifdef CHECK_INVARIANTS
         new_root->lock();
         new_root->mark_modifying();
 #endif /* CHECK_INVARIANTS */
         new_root->set_root();
-        varkey old_slice(resp_leaf->suffix(lenmatch));
+        const suffix_view old_slice(resp_leaf->suffix(lenmatch));
         new_root->keys_[0] = old_slice.slice();
         new_root->values_[0] = resp_leaf->values_[lenmatch];
         new_root->keyslice_set_length(0, std::min(old_slice.size(), size_t(9)), false);
         new_root->inc_key_slots_used();
         if (new_root->keyslice_length(0) == 9) {
-          new_root->alloc_suffixes();
-          rcu_imstring i(old_slice.data() + 8, old_slice.size() - 8);
-          new_root->suffixes_[0].swap(i);
+          const suffix_view sv(old_slice.shift());
+          store_suffixes(new_root, &sv, 1);
         }
         resp_leaf->values_[lenmatch].n_ = new_root;
         {
-          rcu_imstring i;
-          resp_leaf->suffixes_[lenmatch].swap(i);
+          suffix_view sv[NKeysPerNode];
+          resp_leaf->load_suffixes(sv, n);
+          sv[lenmatch] = suffix_view();
+          store_suffixes(resp_leaf, sv, n);
         }
         resp_leaf->value_set_layer(lenmatch);
 #ifdef CHECK_INVARIANTS
@@ -974,10 +1378,17 @@ retry_cur_leaf:
         typename util::vec<node *>::type sub_locked_nodes;
         const insert_status status =
           insert0(new_root, k.shift(), v, only_if_absent, old_v, insert_info,
-              mk, ret, subparents, sub_locked_nodes);
+              mk, ret, subparents, sub_locked_nodes, false);
         if (status != I_NONE_MOD)
           INVARIANT(false);
         INVARIANT(sub_locked_nodes.empty());
+        if (insert_info) {
+          // nobody can have read new_root yet, but resp_leaf changed (and may
+          // be in the caller's absent set), so report resp_leaf instead
+          insert_info->node = resp_leaf;
+          insert_info->old_version = RawVersionManip::Version(resp_leaf->unstable_version()); // we hold lock on leaf
+          insert_info->new_version = insert_info->old_version + 1;
+        }
         return UnlockAndReturn(locked_nodes, I_NONE_MOD);
       }
     }
@@ -999,19 +1410,20 @@ retry_cur_leaf:
       resp_leaf->keys_[lenlowerbound + 1] = kslice;
       sift_right(resp_leaf->values_, lenlowerbound + 1, n);
       resp_leaf->values_[lenlowerbound + 1].v_ = v;
-      sift_right(resp_leaf->lengths_, lenlowerbound + 1, n);
+      if (!P::FixedKeys)
+        sift_right(resp_leaf->lengths_, lenlowerbound + 1, n);
       resp_leaf->keyslice_set_length(lenlowerbound + 1, kslicelen, false);
-      if (resp_leaf->suffixes_)
-        sift_swap_right(resp_leaf->suffixes_, lenlowerbound + 1, n);
-      if (kslicelen == 9) {
-        resp_leaf->ensure_suffixes();
-        rcu_imstring i(k.data() + 8, k.size() - 8);
-        resp_leaf->suffixes_[lenlowerbound + 1].swap(i);
-      } else if (resp_leaf->suffixes_) {
-        rcu_imstring i;
-        resp_leaf->suffixes_[lenlowerbound + 1].swap(i);
+      if (kslicelen == 9 || resp_leaf->suffixes_) {
+        suffix_view sv[NKeysPerNode];
+        resp_leaf->load_suffixes(sv, n);
+        sift_right(sv, lenlowerbound + 1, n);
+        sv[lenlowerbound + 1] =
+          kslicelen == 9 ? suffix_view(k.shift()) : suffix_view();
+        store_suffixes(resp_leaf, sv, n + 1);
       }
       resp_leaf->inc_key_slots_used();
+      if (mostly_append_ && top_layer && size_t(lenlowerbound + 1) == n)
+        append_hint_ = resp_leaf;
 
 //#ifdef CHECK_INVARIANTS
 //      resp_leaf->base_invariant_unique_keys_check();
@@ -1079,7 +1491,7 @@ retry_cur_leaf:
       // modulo the new nodes to be created
       resp_leaf->mark_modifying();
 
-      leaf_node *new_leaf = leaf_node::alloc();
+      leaf_node *new_leaf = alloc_leaf_node();
       new_leaf->prefetch();
 
 #ifdef CHECK_INVARIANTS
@@ -1088,7 +1500,8 @@ retry_cur_leaf:
       locked_nodes.push_back(new_leaf);
 #endif /* CHECK_INVARIANTS */
 
-      if (!resp_leaf->next_ && resp_leaf->keys_[n - 1] < kslice) {
+      if ((!resp_leaf->next_ || mostly_append_) &&
+          resp_leaf->keys_[n - 1] < kslice) {
         // sequential insert optimization- in this case, we don't bother
         // splitting the node. instead, keep the current leaf node full, and
         // insert the new key into the new leaf node (violating the btree invariant)
@@ -1096,16 +1509,21 @@ retry_cur_leaf:
         // this optimization is commonly implemented, including in masstree and
         // berkeley db- w/o this optimization, sequential inserts leave the all
         // nodes half full
+        //
+        // for mostly_append trees we do this for appends to any leaf, not just
+        // the rightmost one, since keys usually increase within many disjoint
+        // ranges of the tree (eg per district) rather than globally
 
         new_leaf->keys_[0] = kslice;
         new_leaf->values_[0].v_ = v;
         new_leaf->keyslice_set_length(0, kslicelen, false);
         if (kslicelen == 9) {
-          new_leaf->alloc_suffixes();
-          rcu_imstring i(k.data() + 8, k.size() - 8);
-          new_leaf->suffixes_[0].swap(i);
+          const suffix_view sv(k.shift());
+          store_suffixes(new_leaf, &sv, 1);
         }
         new_leaf->set_key_slots_used(1);
+        if (mostly_append_ && top_layer)
+          append_hint_ = new_leaf;
 
       } else {
         // regular case
@@ -1145,7 +1563,18 @@ retry_cur_leaf:
         else
           split_point = left_split_point;
 
-        if (split_point <= size_t(lenlowerbound + 1) && resp_leaf->keys_[split_point - 1] != kslice) {
+        // for mostly_append trees, the new key is most likely the end of an
+        // increasing run of keys (which is followed by the start of the next
+        // run in this leaf), so split right after it- the left leaf stays
+        // full, and subsequent appends to the run go to the end of a leaf
+        const size_t append_split_point = mostly_append_ ?
+          AppendSplitPoint(resp_leaf, lenlowerbound + 1, kslice) : 0;
+        if (append_split_point)
+          split_point = append_split_point;
+
+        if (!append_split_point &&
+            split_point <= size_t(lenlowerbound + 1) &&
+            resp_leaf->keys_[split_point - 1] != kslice) {
           // put new key in new leaf (right)
           size_t pos = lenlowerbound + 1 - split_point;
 
@@ -1157,25 +1586,20 @@ retry_cur_leaf:
           new_leaf->values_[pos].v_ = v;
           copy_into(&new_leaf->values_[pos + 1], resp_leaf->values_, lenlowerbound + 1, NKeysPerNode);
 
-          copy_into(&new_leaf->lengths_[0], resp_leaf->lengths_, split_point, lenlowerbound + 1);
+          if (!P::FixedKeys)
+            copy_into(&new_leaf->lengths_[0], resp_leaf->lengths_, split_point, lenlowerbound + 1);
           new_leaf->keyslice_set_length(pos, kslicelen, false);
-          copy_into(&new_leaf->lengths_[pos + 1], resp_leaf->lengths_, lenlowerbound + 1, NKeysPerNode);
-
-          if (resp_leaf->suffixes_) {
-            new_leaf->ensure_suffixes();
-            swap_with(&new_leaf->suffixes_[0], resp_leaf->suffixes_, split_point, lenlowerbound + 1);
-          }
-          if (kslicelen == 9) {
-            new_leaf->ensure_suffixes();
-            rcu_imstring i(k.data() + 8, k.size() - 8);
-            new_leaf->suffixes_[pos].swap(i);
-          } else if (new_leaf->suffixes_) {
-            rcu_imstring i;
-            new_leaf->suffixes_[pos].swap(i);
-          }
-          if (resp_leaf->suffixes_) {
-            new_leaf->ensure_suffixes();
-            swap_with(&new_leaf->suffixes_[pos + 1], resp_leaf->suffixes_, lenlowerbound + 1, NKeysPerNode);
+          if (!P::FixedKeys)
+            copy_into(&new_leaf->lengths_[pos + 1], resp_leaf->lengths_, lenlowerbound + 1, NKeysPerNode);
+
+          if (kslicelen == 9 || resp_leaf->suffixes_) {
+            suffix_view sv[NKeysPerNode + 1];
+            resp_leaf->load_suffixes(sv, NKeysPerNode);
+            sift_right(sv, lenlowerbound + 1, NKeysPerNode);
+            sv[lenlowerbound + 1] =
+              kslicelen == 9 ? suffix_view(k.shift()) : suffix_view();
+            store_suffixes(new_leaf, &sv[split_point], NKeysPerNode - split_point + 1);
+            store_suffixes(resp_leaf, sv, split_point);
           }
 
           resp_leaf->set_key_slots_used(split_point);
@@ -1195,28 +1619,25 @@ retry_cur_leaf:
           // put new key in original leaf
           copy_into(&new_leaf->keys_[0], resp_leaf->keys_, split_point, NKeysPerNode);
           copy_into(&new_leaf->values_[0], resp_leaf->values_, split_point, NKeysPerNode);
-          copy_into(&new_leaf->lengths_[0], resp_leaf->lengths_, split_point, NKeysPerNode);
-          if (resp_leaf->suffixes_) {
-            new_leaf->ensure_suffixes();
-            swap_with(&new_leaf->suffixes_[0], resp_leaf->suffixes_, split_point, NKeysPerNode);
+          if (!P::FixedKeys)
+            copy_into(&new_leaf->lengths_[0], resp_leaf->lengths_, split_point, NKeysPerNode);
+          if (kslicelen == 9 || resp_leaf->suffixes_) {
+            suffix_view sv[NKeysPerNode + 1];
+            resp_leaf->load_suffixes(sv, NKeysPerNode);
+            sift_right(sv, lenlowerbound + 1, NKeysPerNode);
+            sv[lenlowerbound + 1] =
+              kslicelen == 9 ? suffix_view(k.shift()) : suffix_view();
+            store_suffixes(new_leaf, &sv[split_point + 1], NKeysPerNode - split_point);
+            store_suffixes(resp_leaf, sv, split_point + 1);
           }
 
           sift_right(resp_leaf->keys_, lenlowerbound + 1, split_point);
           resp_leaf->keys_[lenlowerbound + 1] = kslice;
           sift_right(resp_leaf->values_, lenlowerbound + 1, split_point);
           resp_leaf->values_[lenlowerbound + 1].v_ = v;
-          sift_right(resp_leaf->lengths_, lenlowerbound + 1, split_point);
+          if (!P::FixedKeys)
+            sift_right(resp_leaf->lengths_, lenlowerbound + 1, split_point);
           resp_leaf->keyslice_set_length(lenlowerbound + 1, kslicelen, false);
-          if (resp_leaf->suffixes_)
-            sift_swap_right(resp_leaf->suffixes_, lenlowerbound + 1, split_point);
-          if (kslicelen == 9) {
-            resp_leaf->ensure_suffixes();
-            rcu_imstring i(k.data() + 8, k.size() - 8);
-            resp_leaf->suffixes_[lenlowerbound + 1].swap(i);
-          } else if (resp_leaf->suffixes_) {
-            rcu_imstring i;
-            resp_leaf->suffixes_[lenlowerbound + 1].swap(i);
-          }
 
           resp_leaf->set_key_slots_used(split_point + 1);
           new_leaf->set_key_slots_used(NKeysPerNode - split_point);
@@ -1265,7 +1686,7 @@ retry_cur_leaf:
     node *new_child = NULL;
     insert_status status =
       insert0(child_ptr, k, v, only_if_absent, old_v, insert_info,
-              mk, new_child, parents, locked_nodes);
+              mk, new_child, parents, locked_nodes, top_layer);
     if (status != I_SPLIT) {
       INVARIANT(locked_nodes.empty());
       return status;
@@ -1288,7 +1709,7 @@ retry_cur_leaf:
       INVARIANT(n == NKeysPerNode);
       INVARIANT(ret == internal->key_lower_bound_search(mk).first);
 
-      internal_node *new_internal = internal_node::alloc();
+      internal_node *new_internal = alloc_internal_node();
       new_internal->prefetch();
 #ifdef CHECK_INVARIANTS
       new_internal->lock();
@@ -1351,6 +1772,21 @@ retry_cur_leaf:
   }
 }
 
+template <typename P>
+size_t
+btree<P>::AppendSplitPoint(const leaf_node *leaf, size_t pos, key_slice kslice)
+{
+  INVARIANT(leaf->key_slots_used() == NKeysPerNode);
+  // both sides must be non-empty, and key slices constrain splits: the
+  // slices on either side of pos must differ, and the new key cannot share
+  // a slice with the keys moving right
+  if (pos == 0 || pos >= NKeysPerNode)
+    return 0;
+  if (leaf->keys_[pos - 1] == leaf->keys_[pos] || leaf->keys_[pos] == kslice)
+    return 0;
+  return pos;
+}
+
 template <typename P>
 bool
 btree<P>::insert_stable_location(
@@ -1359,15 +1795,28 @@ btree<P>::insert_stable_location(
     insert_info_t *insert_info)
 {
   INVARIANT(rcu::s_instance.in_rcu_region());
+  ALWAYS_ASSERT(!P::FixedKeys || k.size() == 8);
+  // for mostly_append trees, first try starting at the leaf the previous
+  // append went to. if it turns out that leaf is not responsible for k, or
+  // that it must split (we have no parents to lock), insert0() returns
+  // I_RETRY and we start over from the root
+  leaf_node *hint = mostly_append_ ? append_hint_ : NULL;
 retry:
   key_slice mk;
   node *ret;
   typename util::vec<insert_parent_entry>::type parents;
   typename util::vec<node *>::type locked_nodes;
   node *local_root = *root_location;
+  if (hint) {
+    const key_slice kslice = k.slice();
+    const leaf_node * const right = hint->next_;
+    if (kslice >= hint->min_key_ && (!right || kslice < right->min_key_))
+      local_root = hint;
+    hint = NULL;
+  }
   const insert_status status =
     insert0(local_root, k, v, only_if_absent, old_v, insert_info,
-            mk, ret, parents, locked_nodes);
+            mk, ret, parents, locked_nodes, root_location == (node **) &root_);
   INVARIANT(status == I_SPLIT || locked_nodes.empty());
   switch (status) {
   case I_NONE_NOMOD:
@@ -1383,7 +1832,7 @@ retry:
     INVARIANT(local_root->is_lock_owner());
     INVARIANT(local_root->is_root());
     INVARIANT(local_root == *root_location);
-    internal_node *new_root = internal_node::alloc();
+    internal_node *new_root = alloc_internal_node();
 #ifdef CHECK_INVARIANTS
     new_root->lock();
     new_root->mark_modifying();
@@ -1446,7 +1895,7 @@ retry_cur_leaf:
       return UnlockAndReturn(locked_nodes, R_NONE_NOMOD);
     }
     if (kslicelen == 9) {
-      if (resp_leaf->is_layer(ret)) {
+      if (resp_leaf->value_is_layer(ret)) {
         node *subroot = resp_leaf->values_[ret].n_;
         INVARIANT(subroot);
         if (unlikely(!resp_leaf->check_version(version)))
@@ -1516,7 +1965,7 @@ retry_cur_leaf:
       }
     }
 
-    //INVARIANT(!resp_leaf->is_layer(ret));
+    //INVARIANT(!resp_leaf->value_is_layer(ret));
     if (n > NMinKeysPerNode) {
       const uint64_t locked_version = resp_leaf->lock();
       if (unlikely(!btree::CheckVersion(version, locked_version))) {
@@ -1636,20 +2085,25 @@ retry_cur_leaf:
             copy_into(&leaf->keys_[n - 1], right_sibling->keys_, 0, steal_point);
             sift_left(leaf->values_, ret, n);
             copy_into(&leaf->values_[n - 1], right_sibling->values_, 0, steal_point);
-            sift_left(leaf->lengths_, ret, n);
-            copy_into(&leaf->lengths_[n - 1], right_sibling->lengths_, 0, steal_point);
-            if (leaf->suffixes_)
-              sift_swap_left(leaf->suffixes_, ret, n);
-            if (right_sibling->suffixes_) {
-              leaf->ensure_suffixes();
-              swap_with(&leaf->suffixes_[n - 1], right_sibling->suffixes_, 0, steal_point);
+            if (!P::FixedKeys) {
+              sift_left(leaf->lengths_, ret, n);
+              copy_into(&leaf->lengths_[n - 1], right_sibling->lengths_, 0, steal_point);
+            }
+            if (leaf->suffixes_ || right_sibling->suffixes_) {
+              suffix_view sv[NKeysPerNode], right_sv[NKeysPerNode];
+              leaf->load_suffixes(sv, n);
+              right_sibling->load_suffixes(right_sv, right_n);
+              sift_left(sv, ret, n);
+              copy_into(&sv[n - 1], right_sv, 0, steal_point);
+              sift_left(right_sv, 0, right_n, steal_point);
+              store_suffixes(leaf, sv, n - 1 + steal_point);
+              store_suffixes(right_sibling, right_sv, right_n - steal_point);
             }
 
             sift_left(right_sibling->keys_, 0, right_n, steal_point);
             sift_left(right_sibling->values_, 0, right_n, steal_point);
-            sift_left(right_sibling->lengths_, 0, right_n, steal_point);
-            if (right_sibling->suffixes_)
-              sift_swap_left(right_sibling->suffixes_, 0, right_n, steal_point);
+            if (!P::FixedKeys)
+              sift_left(right_sibling->lengths_, 0, right_n, steal_point);
             leaf->set_key_slots_used(n - 1 + steal_point);
             right_sibling->set_key_slots_used(right_n - steal_point);
             new_key = right_sibling->keys_[0];
@@ -1684,15 +2138,17 @@ retry_cur_leaf:
         sift_left(leaf->values_, ret, n);
         copy_into(&leaf->values_[n - 1], right_sibling->values_, 0, right_n);
 
-        sift_left(leaf->lengths_, ret, n);
-        copy_into(&leaf->lengths_[n - 1], right_sibling->lengths_, 0, right_n);
-
-        if (leaf->suffixes_)
-          sift_swap_left(leaf->suffixes_, ret, n);
+        if (!P::FixedKeys) {
+          sift_left(leaf->lengths_, ret, n);
+          copy_into(&leaf->lengths_[n - 1], right_sibling->lengths_, 0, right_n);
+        }
 
-        if (right_sibling->suffixes_) {
-          leaf->ensure_suffixes();
-          swap_with(&leaf->suffixes_[n - 1], right_sibling->suffixes_, 0, right_n);
+        if (leaf->suffixes_ || right_sibling->suffixes_) {
+          suffix_view sv[NKeysPerNode];
+          leaf->load_suffixes(sv, n);
+          sift_left(sv, ret, n);
+          right_sibling->load_suffixes(&sv[n - 1], right_n);
+          store_suffixes(leaf, sv, right_n + (n - 1));
         }
 
         leaf->set_key_slots_used(right_n + (n - 1));
@@ -1712,7 +2168,8 @@ retry_cur_leaf:
 //#ifdef CHECK_INVARIANTS
 //        leaf->base_invariant_unique_keys_check();
 //#endif
-        leaf_node::release(right_sibling);
+        clear_append_hint(right_sibling);
+        release_leaf_node(right_sibling);
         return R_MERGE_WITH_RIGHT;
       }
 
@@ -1742,17 +2199,21 @@ retry_cur_leaf:
             sift_right(leaf->values_, 0, ret, nstolen);
             copy_into(&leaf->values_[0], &left_sibling->values_[0], left_n - nstolen, left_n);
 
-            sift_right(leaf->lengths_, ret + 1, n, nstolen - 1);
-            sift_right(leaf->lengths_, 0, ret, nstolen);
-            copy_into(&leaf->lengths_[0], &left_sibling->lengths_[0], left_n - nstolen, left_n);
-
-            if (leaf->suffixes_) {
-              sift_swap_right(leaf->suffixes_, ret + 1, n, nstolen - 1);
-              sift_swap_right(leaf->suffixes_, 0, ret, nstolen);
+            if (!P::FixedKeys) {
+              sift_right(leaf->lengths_, ret + 1, n, nstolen - 1);
+              sift_right(leaf->lengths_, 0, ret, nstolen);
+              copy_into(&leaf->lengths_[0], &left_sibling->lengths_[0], left_n - nstolen, left_n);
             }
-            if (left_sibling->suffixes_) {
-              leaf->ensure_suffixes();
-              swap_with(&leaf->suffixes_[0], &left_sibling->suffixes_[0], left_n - nstolen, left_n);
+
+            if (leaf->suffixes_ || left_sibling->suffixes_) {
+              suffix_view sv[NKeysPerNode], left_sv[NKeysPerNode];
+              leaf->load_suffixes(sv, n);
+              left_sibling->load_suffixes(left_sv, left_n);
+              sift_right(sv, ret + 1, n, nstolen - 1);
+              sift_right(sv, 0, ret, nstolen);
+              copy_into(&sv[0], left_sv, left_n - nstolen, left_n);
+              store_suffixes(leaf, sv, n - 1 + nstolen);
+              store_suffixes(left_sibling, left_sv, left_n - nstolen);
             }
 
             left_sibling->set_key_slots_used(left_n - nstolen);
@@ -1786,13 +2247,18 @@ retry_cur_leaf:
         copy_into(&left_sibling->values_[left_n], leaf->values_, 0, ret);
         copy_into(&left_sibling->values_[left_n + ret], leaf->values_, ret + 1, n);
 
-        copy_into(&left_sibling->lengths_[left_n], leaf->lengths_, 0, ret);
-        copy_into(&left_sibling->lengths_[left_n + ret], leaf->lengths_, ret + 1, n);
+        if (!P::FixedKeys) {
+          copy_into(&left_sibling->lengths_[left_n], leaf->lengths_, 0, ret);
+          copy_into(&left_sibling->lengths_[left_n + ret], leaf->lengths_, ret + 1, n);
+        }
 
         if (leaf->suffixes_) {
-          left_sibling->ensure_suffixes();
-          swap_with(&left_sibling->suffixes_[left_n], leaf->suffixes_, 0, ret);
-          swap_with(&left_sibling->suffixes_[left_n + ret], leaf->suffixes_, ret + 1, n);
+          suffix_view sv[NKeysPerNode], leaf_sv[NKeysPerNode];
+          left_sibling->load_suffixes(sv, left_n);
+          leaf->load_suffixes(leaf_sv, n);
+          copy_into(&sv[left_n], leaf_sv, 0, ret);
+          copy_into(&sv[left_n + ret], leaf_sv, ret + 1, n);
+          store_suffixes(left_sibling, sv, left_n + (n - 1));
         }
 
         left_sibling->set_key_slots_used(left_n + (n - 1));
@@ -1808,7 +2274,8 @@ retry_cur_leaf:
             left_sibling->prev_->next_ == left_sibling);
 
         //left_sibling->base_invariant_unique_keys_check();
-        leaf_node::release(leaf);
+        clear_append_hint(leaf);
+        release_leaf_node(leaf);
         return R_MERGE_WITH_LEFT;
       }
 
@@ -1929,7 +2396,7 @@ retry_cur_leaf:
               copy_into(&internal->children_[n], right_sibling->children_, 0, right_n + 1);
 
               internal->set_key_slots_used(n + right_n);
-              internal_node::release(right_sibling);
+              release_internal_node(right_sibling);
               return R_MERGE_WITH_RIGHT;
             }
           }
@@ -1971,7 +2438,7 @@ retry_cur_leaf:
               copy_into(&left_sibling->children_[left_child_j], internal->children_, del_child_idx + 1, n + 1);
 
               left_sibling->set_key_slots_used(n + left_n);
-              internal_node::release(internal);
+              release_internal_node(internal);
               return R_MERGE_WITH_LEFT;
             }
           }
@@ -1982,7 +2449,7 @@ retry_cur_leaf:
           INVARIANT(internal->key_slots_used() + 1 == n);
           if ((n - 1) == 0) {
             replace_node = internal->children_[0];
-            internal_node::release(internal);
+            release_internal_node(internal);
             return R_REPLACE_NODE;
           }
 
@@ -2013,7 +2480,7 @@ btree<P>::NodeStringify(const node_opaque_t *n)
     std::vector<std::string> lengths;
     for (size_t i = 0; i < leaf->key_slots_used(); i++) {
       std::ostringstream inf;
-      inf << "<l=" << leaf->keyslice_length(i) << ",is_layer=" << leaf->is_layer(i) << ">";
+      inf << "<l=" << leaf->keyslice_length(i) << ",is_layer=" << leaf->value_is_layer(i) << ">";
       lengths.push_back(inf.str());
     }
     b << ", lengths=" << util::format_list(lengths.begin(), lengths.end());
@@ -2031,12 +2498,379 @@ std::vector<std::pair<typename btree<P>::value_type, bool>>
 btree<P>::ExtractValues(const node_opaque_t *n)
 {
   std::vector< std::pair<value_type, bool> > ret;
+  if (IsHashBucket(n->unstable_version())) {
+    for (const hash_entry *e = ((const hash_bucket *) n)->head_; e; e = e->next_)
+      ret.emplace_back(e->v_, e->len_ > 8);
+    return ret;
+  }
   if (!n->is_leaf_node())
     return ret;
   const leaf_node *leaf = (const leaf_node *) n;
   const size_t sz = leaf->key_slots_used();
   for (size_t i = 0; i < sz; i++)
-    if (!leaf->is_layer(i))
+    if (!leaf->value_is_layer(i))
       ret.emplace_back(leaf->values_[i].v_, leaf->keyslice_length(i) > 8);
   return ret;
 }
+
+template <typename P>
+size_t
+btree<P>::ExtractSuffixBytes(const node_opaque_t *n)
+{
+  if (IsHashBucket(n->unstable_version()) || !n->is_leaf_node())
+    return 0;
+  const suffix_block * const b = ((const leaf_node *) n)->suffixes_;
+  return b ? b->alloc_size() : 0;
+}
+
+template <typename P>
+std::vector<typename btree<P>::string_type>
+btree<P>::key_quantiles(size_t n) const
+{
+  ALWAYS_ASSERT(!hash_);
+  ALWAYS_ASSERT(n > 0);
+  rcu_region guard;
+
+  // a level of the btree, left to right: each node w/ the separator key
+  // its parent has to the left of it (unused for the leftmost node)
+  std::vector<std::pair<const node *, key_slice>> level, next;
+  level.emplace_back(root_, 0);
+  std::vector<key_slice> items;
+  bool leaves = false;
+  while (!leaves && level.size() < QuantileSamplesPerRange * n) {
+    next.clear();
+    for (auto &e : level) {
+      const node * const cur = e.first;
+      node *children[NKeysPerNode + 1];
+      key_slice keys[NKeysPerNode];
+      size_t nkeys;
+    retry:
+      const uint64_t version = cur->stable_version();
+      leaves = RawVersionManip::IsLeafNode(version);
+      nkeys = RawVersionManip::KeySlotsUsed(version);
+      NDB_MEMCPY(&keys[0], &cur->keys_[0], nkeys * sizeof(key_slice));
+      if (!leaves)
+        NDB_MEMCPY(&children[0], &AsInternal(cur)->children_[0],
+                   (nkeys + 1) * sizeof(node *));
+      if (unlikely(!cur->check_version(version)))
+        goto retry;
+      if (leaves) {
+        // all leaves are at the same depth, so this level is as deep as we
+        // go. if the root is a leaf, its key slices are the samples
+        if (level.size() == 1) {
+          items.assign(keys, keys + nkeys);
+          items.erase(std::unique(items.begin(), items.end()), items.end());
+        }
+        break;
+      }
+      next.emplace_back(children[0], e.second);
+      for (size_t i = 0; i < nkeys; i++)
+        next.emplace_back(children[i + 1], keys[i]);
+    }
+    if (!leaves)
+      level.swap(next);
+  }
+  if (items.empty())
+    for (auto &e : level)
+      items.push_back(e.second);
+
+  // the i-th range starts at the (i * items.size() / n)-th item. the
+  // boundaries are big endian slices w/o their trailing zero bytes, since
+  // a key shorter than 8 bytes has the same slice as itself padded w/ zeros
+  std::vector<string_type> ret;
+  size_t prev = 0;
+  for (size_t i = 1; i < n; i++) {
+    const size_t idx = i * items.size() / n;
+    if (idx == prev)
+      continue;
+    prev = idx;
+    const key_slice k = util::big_endian_trfm<key_slice>()(items[idx]);
+    string_type b((const char *) &k, sizeof(k));
+    while (!b.empty() && !b[b.size() - 1])
+      b.resize(b.size() - 1);
+    ret.push_back(b);
+  }
+  return ret;
+}
+
+template <typename P>
+btree<P>::bulk_builder::bulk_builder(size_t leaf_fill)
+  : leaf_fill_(leaf_fill), has_group_(false), group_slice_(0),
+    first_(NULL), last_(NULL), nleaves_(0), nkeys_(0)
+{
+  // a leaf must be able to hold an entire key slice group
+  ALWAYS_ASSERT(leaf_fill_ >= 10 && leaf_fill_ <= NKeysPerNode);
+}
+
+template <typename P>
+btree<P>::bulk_builder::~bulk_builder()
+{
+  finish();
+  leaf_node *cur = first_;
+  while (cur) {
+    leaf_node * const next = cur->next_;
+    recursive_delete(cur);
+    cur = next;
+  }
+}
+
+template <typename P>
+void
+btree<P>::bulk_builder::add(const key_type &k, value_type v)
+{
+  ALWAYS_ASSERT(!P::FixedKeys || k.size() == 8);
+  const key_slice kslice = k.slice();
+  const size_t kslicelen = std::min(k.size(), size_t(9));
+  if (has_group_ && kslice != group_slice_) {
+    ALWAYS_ASSERT(kslice > group_slice_);
+    flush_group();
+  }
+  if (!has_group_) {
+    has_group_ = true;
+    group_slice_ = kslice;
+  }
+  if (kslicelen <= 8) {
+    // long keys sort after all short keys with the same slice
+    ALWAYS_ASSERT(group_long_.empty());
+    ALWAYS_ASSERT(group_short_.empty() ||
+                  group_short_.back().first < kslicelen);
+    group_short_.emplace_back(kslicelen, v);
+  } else {
+    // ordering amongst long keys is checked when the group is flushed
+    group_long_.emplace_back(
+        std::string((const char *) k.data() + 8, k.size() - 8), v);
+  }
+  nkeys_++;
+}
+
+template <typename P>
+void
+btree<P>::bulk_builder::append_slot(
+    key_slice k, size_t len, typename leaf_node::value_or_node_ptr v,
+    bool layer, const std::string *suffix)
+{
+  INVARIANT(last_);
+  const size_t n = last_->key_slots_used();
+  INVARIANT(n < NKeysPerNode);
+  last_->keys_[n] = k;
+  last_->values_[n] = v;
+  last_->keyslice_set_length(n, len, layer);
+  if (suffix)
+    last_suffixes_.emplace_back(n, *suffix);
+  last_->set_key_slots_used(n + 1);
+}
+
+template <typename P>
+void
+btree<P>::bulk_builder::seal_last()
+{
+  INVARIANT(last_);
+  if (!last_suffixes_.empty()) {
+    suffix_view views[NKeysPerNode];
+    for (auto &e : last_suffixes_)
+      views[e.first] = suffix_view(varkey(e.second));
+    last_->store_suffixes(views, last_->key_slots_used());
+    last_suffixes_.clear();
+  }
+  BulkSealNode(last_);
+}
+
+template <typename P>
+void
+btree<P>::bulk_builder::flush_group()
+{
+  if (!has_group_)
+    return;
+  const size_t nslots = group_short_.size() + (group_long_.empty() ? 0 : 1);
+  INVARIANT(nslots <= 10);
+  if (!last_ || last_->key_slots_used() + nslots > leaf_fill_) {
+    leaf_node * const leaf = BulkAllocLeaf();
+    if (last_) {
+      seal_last();
+      last_->next_ = leaf;
+      leaf->prev_ = last_;
+    } else {
+      first_ = leaf;
+    }
+    leaf->min_key_ = group_slice_;
+    last_ = leaf;
+    nleaves_++;
+  }
+
+  typename leaf_node::value_or_node_ptr v;
+  for (auto &e : group_short_) {
+    v.v_ = e.second;
+    append_slot(group_slice_, e.first, v, false, nullptr);
+  }
+  if (group_long_.size() == 1) {
+    v.v_ = group_long_[0].second;
+    append_slot(group_slice_, 9, v, false, &group_long_[0].first);
+  } else if (group_long_.size() > 1) {
+    // more than one key w/ this slice is longer than 8 bytes- these go into
+    // a new layer, built the same way
+    bulk_builder layer(leaf_fill_);
+    for (auto &e : group_long_)
+      layer.add(varkey(e.first), e.second);
+    layer.finish();
+    node * const root = BulkBuildInternalLevels(layer.first_, layer.nleaves_);
+    layer.first_ = layer.last_ = NULL;
+    layer.nleaves_ = 0;
+    BulkSetRoot(root);
+    v.n_ = root;
+    append_slot(group_slice_, 9, v, true, nullptr);
+  }
+
+  has_group_ = false;
+  group_short_.clear();
+  group_long_.clear();
+}
+
+template <typename P>
+void
+btree<P>::bulk_builder::finish()
+{
+  flush_group();
+  if (last_ && (!last_suffixes_.empty() || last_->is_modifying()))
+    seal_last();
+}
+
+template <typename P>
+typename btree<P>::leaf_node *
+btree<P>::BulkAllocLeaf()
+{
+  leaf_node * const leaf = leaf_node::alloc();
+#ifdef CHECK_INVARIANTS
+  leaf->lock();
+  leaf->mark_modifying();
+#endif /* CHECK_INVARIANTS */
+  return leaf;
+}
+
+template <typename P>
+void
+btree<P>::BulkSealNode(node *n)
+{
+#ifdef CHECK_INVARIANTS
+  n->unlock();
+#endif /* CHECK_INVARIANTS */
+}
+
+template <typename P>
+void
+btree<P>::BulkSetRoot(node *n)
+{
+#ifdef CHECK_INVARIANTS
+  n->lock();
+  n->set_root();
+  n->unlock();
+#else
+  n->set_root();
+#endif /* CHECK_INVARIANTS */
+}
+
+template <typename P>
+template <typename NextFn>
+std::vector<std::pair<typename btree<P>::node *, typename btree<P>::key_slice>>
+btree<P>::BulkBuildLevel(size_t nchildren, NextFn next)
+{
+  INVARIANT(nchildren > 1);
+  // spread the children evenly, so every node (except a lone root) has at
+  // least NMinKeysPerNode keys
+  const size_t nnodes = util::slow_round_up(nchildren, size_t(NKeysPerNode + 1)) /
+                        (NKeysPerNode + 1);
+  const size_t base = nchildren / nnodes;
+  const size_t extra = nchildren % nnodes;
+  std::vector<std::pair<node *, key_slice>> ret;
+  ret.reserve(nnodes);
+  for (size_t i = 0; i < nnodes; i++) {
+    const size_t nc = base + (i < extra ? 1 : 0);
+    INVARIANT(nc >= 2 && nc <= NKeysPerNode + 1);
+    INVARIANT(nnodes == 1 || (nc - 1) >= NMinKeysPerNode);
+    internal_node * const internal = internal_node::alloc();
+#ifdef CHECK_INVARIANTS
+    internal->lock();
+    internal->mark_modifying();
+#endif /* CHECK_INVARIANTS */
+    key_slice min_key = 0;
+    for (size_t j = 0; j < nc; j++) {
+      const std::pair<node *, key_slice> c = next();
+      internal->children_[j] = c.first;
+      if (j)
+        internal->keys_[j - 1] = c.second;
+      else
+        min_key = c.second;
+    }
+    internal->set_key_slots_used(nc - 1);
+    BulkSealNode(internal);
+    ret.emplace_back(internal, min_key);
+  }
+  return ret;
+}
+
+template <typename P>
+typename btree<P>::node *
+btree<P>::BulkBuildInternalLevels(leaf_node *first, size_t nleaves)
+{
+  INVARIANT(first && nleaves);
+  // the leftmost leaf of a layer covers everything below its right sibling
+  first->min_key_ = 0;
+  if (nleaves == 1)
+    return first;
+  leaf_node *cur = first;
+  std::vector<std::pair<node *, key_slice>> level =
+    BulkBuildLevel(nleaves, [&cur]() {
+      leaf_node * const l = cur;
+      cur = cur->next_;
+      return std::pair<node *, key_slice>(l, l->keys_[0]);
+    });
+  INVARIANT(!cur);
+  while (level.size() > 1) {
+    size_t i = 0;
+    level = BulkBuildLevel(level.size(), [&level, &i]() {
+      return level[i++];
+    });
+  }
+  return level[0].first;
+}
+
+template <typename P>
+void
+btree<P>::bulk_load(const std::vector<bulk_builder *> &builders)
+{
+  ALWAYS_ASSERT(!hash_);
+  ALWAYS_ASSERT(root_->is_leaf_node() && !root_->key_slots_used());
+
+  // stitch the runs into a single chain
+  leaf_node *first = NULL, *last = NULL;
+  size_t nleaves = 0;
+  for (auto b : builders) {
+    b->finish();
+    if (!b->first_)
+      continue;
+    if (last) {
+      ALWAYS_ASSERT(last->keys_[last->key_slots_used() - 1] < b->first_->keys_[0]);
+      last->next_ = b->first_;
+      b->first_->prev_ = last;
+    } else {
+      first = b->first_;
+    }
+    last = b->last_;
+    nleaves += b->nleaves_;
+    count_->my() += b->nkeys_;
+    b->first_ = b->last_ = NULL;
+    b->nleaves_ = b->nkeys_ = 0;
+  }
+  if (!first)
+    return;
+
+  node * const root = BulkBuildInternalLevels(first, nleaves);
+  BulkSetRoot(root);
+  append_hint_ = NULL;
+  // the builders' nodes were not accounted to any tree
+  const std::pair<size_t, size_t> u = MemUsage(root);
+  node_bytes_->add(ssize_t(u.first) - ssize_t(LeafNodeAllocSize));
+  suffix_bytes_->add(u.second);
+  recursive_delete(root_);
+  COMPILER_MEMORY_FENCE;
+  root_ = root;
+}
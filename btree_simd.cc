@@ -0,0 +1,103 @@
+#include "btree_simd.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD_KERNELS
+#endif
+
+namespace btree_simd {
+
+kernel_t g_kernel = best_kernel();
+
+kernel_t
+best_kernel()
+{
+#if defined(BTREE_NODE_SIMD_SEARCH) && defined(HAVE_X86_SIMD_KERNELS)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return KERNEL_AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return KERNEL_SSE42;
+#endif
+  return KERNEL_SCALAR;
+}
+
+kernel_t
+set_kernel(kernel_t k)
+{
+  const kernel_t best = best_kernel();
+  g_kernel = k > best ? best : k;
+  return g_kernel;
+}
+
+const char *
+kernel_name(kernel_t k)
+{
+  switch (k) {
+  case KERNEL_SCALAR:
+    return "scalar";
+  case KERNEL_SSE42:
+    return "sse4.2";
+  case KERNEL_AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+#ifdef HAVE_X86_SIMD_KERNELS
+
+// the only 64-bit compare is signed, so flip the sign bit of both sides
+// to get an unsigned compare
+
+__attribute__((target("sse4.2"))) size_t
+count_less_sse42(const uint64_t *keys, size_t n, uint64_t k)
+{
+  const __m128i sign = _mm_set1_epi64x(int64_t(1ULL << 63));
+  const __m128i probe = _mm_xor_si128(_mm_set1_epi64x(int64_t(k)), sign);
+  size_t cnt = 0, i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const __m128i v = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *) &keys[i]), sign);
+    const int m = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(probe, v)));
+    cnt += __builtin_popcount(m);
+  }
+  if (i < n)
+    cnt += keys[i] < k;
+  return cnt;
+}
+
+__attribute__((target("avx2"))) size_t
+count_less_avx2(const uint64_t *keys, size_t n, uint64_t k)
+{
+  const __m256i sign = _mm256_set1_epi64x(int64_t(1ULL << 63));
+  const __m256i probe = _mm256_xor_si256(_mm256_set1_epi64x(int64_t(k)), sign);
+  size_t cnt = 0, i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i v = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i *) &keys[i]), sign);
+    const int m = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpgt_epi64(probe, v)));
+    cnt += __builtin_popcount(m);
+  }
+  for (; i < n; i++)
+    cnt += keys[i] < k;
+  return cnt;
+}
+
+#else
+
+size_t
+count_less_sse42(const uint64_t *keys, size_t n, uint64_t k)
+{
+  return count_less_scalar(keys, n, k);
+}
+
+size_t
+count_less_avx2(const uint64_t *keys, size_t n, uint64_t k)
+{
+  return count_less_scalar(keys, n, k);
+}
+
+#endif
+
+}
@@ -0,0 +1,82 @@
+#ifndef _NDB_BTREE_SIMD_H_
+#define _NDB_BTREE_SIMD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "macros.h"
+
+/**
+ * Kernels for searching the sorted key slice array of a btree node.
+ *
+ * The vectorized kernels compare the probe against every slot at once and
+ * count how many slots are strictly smaller, which gives the position of
+ * the first slot >= the probe without any data dependent branches. Which
+ * kernel is used is picked once at startup based on what the running CPU
+ * supports; the scalar kernel is always available.
+ */
+namespace btree_simd {
+
+  enum kernel_t {
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE42,
+    KERNEL_AVX2,
+  };
+
+  // zero-initialized, so searches issued before static initialization has
+  // finished simply use the scalar kernel
+  extern kernel_t g_kernel;
+
+  // the best kernel supported by the running CPU
+  kernel_t best_kernel();
+
+  // installs k, clamped to best_kernel(). returns the kernel installed.
+  // not thread-safe w.r.t. concurrent searches- for testing/benchmarking
+  kernel_t set_kernel(kernel_t k);
+
+  const char *kernel_name(kernel_t k);
+
+  size_t count_less_sse42(const uint64_t *keys, size_t n, uint64_t k);
+  size_t count_less_avx2(const uint64_t *keys, size_t n, uint64_t k);
+
+  static inline ALWAYS_INLINE size_t
+  count_less_scalar(const uint64_t *keys, size_t n, uint64_t k)
+  {
+    size_t lower = 0;
+    size_t upper = n;
+    while (lower < upper) {
+      const size_t i = (lower + upper) / 2;
+      if (keys[i] < k)
+        lower = i + 1;
+      else
+        upper = i;
+    }
+    return lower;
+  }
+
+  /**
+   * number of keys in [0, n) which are strictly less than k, (unsigned
+   * comparison). keys must be sorted, so this is also the index of the first
+   * key >= k.
+   *
+   * the result is always in [0, n], even if keys is being concurrently
+   * modified (and therefore not sorted)
+   */
+  static inline ALWAYS_INLINE size_t
+  count_less(const uint64_t *keys, size_t n, uint64_t k)
+  {
+#ifdef BTREE_NODE_SIMD_SEARCH
+    switch (g_kernel) {
+    case KERNEL_AVX2:
+      return count_less_avx2(keys, n, k);
+    case KERNEL_SSE42:
+      return count_less_sse42(keys, n, k);
+    default:
+      break;
+    }
+#endif
+    return count_less_scalar(keys, n, k);
+  }
+}
+
+#endif /* _NDB_BTREE_SIMD_H_ */
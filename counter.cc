@@ -117,3 +117,59 @@ event_avg_counter::event_avg_counter(const string &name)
 {
 }
 #endif
+
+map<string, event_gauge *> &
+event_gauge::gauges()
+{
+  static map<string, event_gauge *> s_gauges;
+  return s_gauges;
+}
+
+spinlock &
+event_gauge::gauges_lock()
+{
+  static spinlock s_lock;
+  return s_lock;
+}
+
+event_gauge::event_gauge(const string &name)
+  : name_(name)
+{
+  lock_guard<spinlock> sl(gauges_lock());
+  ALWAYS_ASSERT(gauges().emplace(name, this).second);
+}
+
+int64_t
+event_gauge::value() const
+{
+  int64_t v = 0;
+  for (size_t i = 0; i < deltas_.size(); i++)
+    v += deltas_[i];
+  return v;
+}
+
+map<string, int64_t>
+event_gauge::get_all_gauges()
+{
+  map<string, int64_t> ret;
+  lock_guard<spinlock> sl(gauges_lock());
+  for (auto &p : gauges())
+    ret[p.first] = p.second->value();
+  return ret;
+}
+
+bool
+event_gauge::stat(const string &name, counter_data &d)
+{
+  const event_gauge *g = nullptr;
+  {
+    lock_guard<spinlock> sl(gauges_lock());
+    auto it = gauges().find(name);
+    if (it != gauges().end())
+      g = it->second;
+  }
+  if (!g)
+    return false;
+  d.count_ += std::max(g->value(), int64_t(0));
+  return true;
+}
@@ -150,6 +150,54 @@ private:
 #endif
 };
 
+/**
+ * A count which goes both up and down (eg the bytes some structure holds),
+ * kept as per-core deltas which are summed when read. Unlike event
+ * counters, gauges are always compiled in (an add() is a single per-core
+ * increment) and are not cleared by reset_all_counters(), since they track
+ * a level rather than a number of events.
+ *
+ * Gauges must be unique by name, and are never supposed to be destructed
+ * (so they are heap allocated and leaked, like the event_ctx of an event
+ * counter)
+ */
+class event_gauge {
+public:
+  event_gauge(const std::string &name);
+
+  event_gauge(const event_gauge &) = delete;
+  event_gauge &operator=(const event_gauge &) = delete;
+  event_gauge(event_gauge &&) = delete;
+
+  inline ALWAYS_INLINE void
+  add(int64_t i)
+  {
+    deltas_.my() += i;
+  }
+
+  inline const std::string &
+  name() const
+  {
+    return name_;
+  }
+
+  // not a consistent snapshot w/ concurrent adds
+  int64_t value() const;
+
+  // WARNING: an expensive operation!
+  static std::map<std::string, int64_t> get_all_gauges();
+  // WARNING: an expensive operation! (a negative value reads as 0)
+  static bool
+  stat(const std::string &name, counter_data &d);
+
+private:
+  static std::map<std::string, event_gauge *> &gauges();
+  static spinlock &gauges_lock();
+
+  const std::string name_;
+  percore<int64_t, false, false> deltas_;
+};
+
 inline std::ostream &
 operator<<(std::ostream &o, const counter_data &d)
 {
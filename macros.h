@@ -7,6 +7,8 @@
 /** options */
 //#define TUPLE_PREFETCH
 #define BTREE_NODE_PREFETCH
+#define BTREE_NODE_SIMD_SEARCH
+#define BTREE_NODE_SEARCH_LAYOUT
 //#define DIE_ON_ABORT
 //#define TRAP_LARGE_ALLOOCATIONS
 #define USE_BUILTIN_MEMFUNCS
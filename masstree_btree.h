@@ -228,7 +228,13 @@ private:
 public:
 #endif
 
-  mbtree() {
+  // masstree already splits full leaves sequentially on appends, so the
+  // mostly_append hint is not needed. there is no hash mode either, hashed
+  // tables are just regular trees. masstree nodes come from its own
+  // threadinfo pools, and are not accounted to the gauges
+  explicit mbtree(bool mostly_append = false, bool hashed = false,
+                  event_gauge *node_bytes = nullptr,
+                  event_gauge *suffix_bytes = nullptr) {
     threadinfo ti;
     table_.initialize(ti);
   }
@@ -283,6 +289,13 @@ public:
      */
     virtual bool invoke(const string_type &k, value_type v,
                         const node_opaque_t *n, uint64_t version) = 0;
+
+    /**
+     * Same hooks as btree's low_level_search_range_callback. The masstree
+     * scan does not call them yet
+     */
+    virtual void on_leaf_values(const value_type *values, size_t n) {}
+    virtual bool on_leaf_end() { return true; }
   };
 
   /**
@@ -443,6 +456,20 @@ public:
    */
   inline size_t size() const;
 
+  // no per-core key counts are kept, so this is the same as size()
+  inline size_t
+  size_estimate() const
+  {
+    return size();
+  }
+
+  // not supported: always a single range
+  inline std::vector<std::string>
+  key_quantiles(size_t n) const
+  {
+    return std::vector<std::string>();
+  }
+
   static inline uint64_t
   ExtractVersionNumber(const node_opaque_t *n) {
     // XXX(stephentu): I think we must use stable_version() for
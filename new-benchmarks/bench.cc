@@ -15,6 +15,7 @@
 #include "../counter.h"
 #include "../scopedperf.hh"
 #include "../allocator.h"
+#include "../tuple.h"
 
 #ifdef USE_JEMALLOC
 //cannot include this header b/c conflicts with malloc.h
@@ -122,7 +123,9 @@ bench_worker::run()
         const auto ret = workload[i].fn(this);
         if (likely(ret.first)) {
           ++ntxn_commits;
-          latency_numer_us += t.lap();
+          const uint64_t latency_us = t.lap();
+          latency_numer_us += latency_us;
+          latency_hist.add(latency_us);
           backoff_shifts >>= 1;
         } else {
           ++ntxn_aborts;
@@ -187,6 +190,10 @@ bench_runner::run()
       cerr << persisted_info << " txns persisted in loading phase" << endl;
   }
   db->reset_ntxn_persisted();
+  if (verbose) {
+    cerr << "--- table memory (after loading) ---" << endl;
+    index_mem_stats::DumpAll(cerr);
+  }
 
   if (!no_reset_counters) {
     event_counter::reset_all_counters(); // XXX: for now - we really should have a before/after loading
@@ -235,10 +242,12 @@ bench_runner::run()
   size_t n_commits = 0;
   size_t n_aborts = 0;
   uint64_t latency_numer_us = 0;
+  log_histogram latency_hist;
   for (size_t i = 0; i < nthreads; i++) {
     n_commits += workers[i]->get_ntxn_commits();
     n_aborts += workers[i]->get_ntxn_aborts();
     latency_numer_us += workers[i]->get_latency_numer_us();
+    latency_hist.merge(workers[i]->get_latency_hist());
   }
   const auto persisted_info = db->get_ntxn_persisted();
 
@@ -324,6 +333,8 @@ bench_runner::run()
     cerr << "agg_persist_throughput: " << agg_persist_throughput << " ops/sec" << endl;
     cerr << "avg_per_core_persist_throughput: " << avg_per_core_persist_throughput << " ops/sec/core" << endl;
     cerr << "avg_latency: " << avg_latency_ms << " ms" << endl;
+    cerr << "p99_latency: " << latency_hist.percentile(0.99) / 1000.0 << " ms" << endl;
+    cerr << "p999_latency: " << latency_hist.percentile(0.999) / 1000.0 << " ms" << endl;
     cerr << "avg_persist_latency: " << avg_persist_latency_ms << " ms" << endl;
     cerr << "agg_abort_rate: " << agg_abort_rate << " aborts/sec" << endl;
     cerr << "avg_per_core_abort_rate: " << avg_per_core_abort_rate << " aborts/sec/core" << endl;
@@ -334,6 +345,8 @@ bench_runner::run()
       cerr << it->first << ": " << it->second << endl;
     cerr << "--- perf counters (if enabled, for benchmark) ---" << endl;
     PERF_EXPR(scopedperf::perfsum_base::printall());
+    cerr << "--- table memory ---" << endl;
+    index_mem_stats::DumpAll(cerr);
     cerr << "--- allocator stats ---" << endl;
     ::allocator::DumpStats();
     cerr << "---------------------------------------" << endl;
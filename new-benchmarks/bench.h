@@ -19,12 +19,13 @@
 struct persistconfig {
   persistconfig()
     : nofsync_(0), do_compress_(0), fake_writes_(0),
-      disable_gc_(0), disable_snapshots_(0) {}
+      disable_gc_(0), disable_snapshots_(0), gc_threads_(0) {}
   int nofsync_;
   int do_compress_;
   int fake_writes_;
   int disable_gc_;
   int disable_snapshots_;
+  size_t gc_threads_; // background reclaimers per NUMA node, 0 for none
   std::vector<std::string> logfiles_;
   std::vector<std::vector<unsigned>> assignments_;
 };
@@ -173,6 +174,13 @@ public:
 
   inline uint64_t get_latency_numer_us() const { return latency_numer_us; }
 
+  // commit latencies, in usec
+  inline const util::log_histogram &
+  get_latency_hist() const
+  {
+    return latency_hist;
+  }
+
   inline double
   get_avg_latency_us() const
   {
@@ -209,6 +217,7 @@ private:
   size_t ntxn_commits;
   size_t ntxn_aborts;
   uint64_t latency_numer_us;
+  util::log_histogram latency_hist;
   unsigned backoff_shifts;
 
 protected:
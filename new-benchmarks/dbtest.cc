@@ -88,12 +88,13 @@ main(int argc, char **argv)
       {"log-fake-writes"            , no_argument       , &cfg.fake_writes_          , 1}   ,
       {"disable-gc"                 , no_argument       , &cfg.disable_gc_           , 1}   ,
       {"disable-snapshots"          , no_argument       , &cfg.disable_snapshots_    , 1}   ,
+      {"gc-threads"                 , required_argument , 0                          , 'g'} , // per NUMA node
       {"stats-server-sockfile"      , required_argument , 0                          , 'x'} ,
       {"no-reset-counters"          , no_argument       , &no_reset_counters         , 1}   ,
       {0, 0, 0, 0}
     };
     int option_index = 0;
-    int c = getopt_long(argc, argv, "b:s:t:d:B:f:r:n:o:m:l:a:x:", long_options, &option_index);
+    int c = getopt_long(argc, argv, "b:s:t:d:B:f:r:n:o:m:l:a:x:g:", long_options, &option_index);
     if (c == -1)
       break;
 
@@ -171,6 +172,11 @@ main(int argc, char **argv)
       stats_server_sockfile = optarg;
       break;
 
+    case 'g':
+      cfg.gc_threads_ = strtoul(optarg, NULL, 10);
+      ALWAYS_ASSERT(cfg.gc_threads_ > 0);
+      break;
+
     case '?':
       /* getopt_long already printed an error message. */
       exit(1);
@@ -252,6 +258,12 @@ main(int argc, char **argv)
     return 1;
   }
 #endif
+
+  if (cfg.gc_threads_ && db_type != "ndb-proto2") {
+    cerr << "[ERROR] benchmark " << db_type
+         << " does not have background gc" << endl;
+    return 1;
+  }
 #ifdef CHECK_INVARIANTS
   cerr << "WARNING: invariant checking is enabled - should disable for benchmark" << endl;
 #ifdef PARANOID_CHECKING
@@ -304,6 +316,7 @@ main(int argc, char **argv)
     cerr << "  assignments : " << cfg.assignments_          << endl;
     cerr << "  disable-gc : " << cfg.disable_gc_            << endl;
     cerr << "  disable-snapshots : " << cfg.disable_snapshots_ << endl;
+    cerr << "  gc-threads : " << cfg.gc_threads_            << endl;
     cerr << "  stats-server-sockfile: " << stats_server_sockfile << endl;
 
     cerr << "system properties:" << endl;
@@ -1665,7 +1665,12 @@ tpcc_worker<Database, AllowReadOnlyScans>::txn_payment()
       NDB_MEMCPY((void *) v_c.c_data.data(), &buf[0], v_c.c_data.size());
     }
 
-    tables.tbl_customer(customerWarehouseID)->put(txn, k_c, v_c);
+    tables.tbl_customer(customerWarehouseID)->put(txn, k_c, v_c,
+        GUARDED_FIELDS(
+          customer::value::c_balance_field,
+          customer::value::c_ytd_payment_field,
+          customer::value::c_payment_cnt_field,
+          customer::value::c_data_field));
 
     const history::key k_h(k_c.c_d_id, k_c.c_w_id, k_c.c_id, districtID, warehouse_id, ts);
     history::value v_h;
@@ -1986,8 +1991,13 @@ private:
   static bool
   IsTableAppendOnly(const char *name)
   {
+    // keys grow monotonically per district (or per customer), new_order
+    // only ever removes from the front
     return strcmp("history", name) == 0 ||
-           strcmp("oorder_c_id_idx", name) == 0;
+           strcmp("new_order", name) == 0 ||
+           strcmp("oorder", name) == 0 ||
+           strcmp("oorder_c_id_idx", name) == 0 ||
+           strcmp("order_line", name) == 0;
   }
 
   template <typename Schema>
@@ -2029,7 +2039,8 @@ public:
 
 #define OPEN_TABLESPACE_X(x) \
     do { \
-      tables.tbl_ ## x ## _vec = OpenTablesForTablespace<schema<x>>(db, #x, sizeof(x::value)); \
+      tables.tbl_ ## x ## _vec = \
+        OpenTablesForTablespace<typename tpcc_schema<x>::type>(db, #x, sizeof(x::value)); \
       auto v = unique_filter(tables.tbl_ ## x ## _vec); \
       for (size_t i = 0; i < v.size(); i++) \
         this->open_tables[string(#x) + "_" + to_string(i)] = v[i]; \
@@ -2260,6 +2271,8 @@ tpcc_do_test(const string &dbtype,
     if (cfg.disable_snapshots_)
       transaction_proto2_static::DisableSnapshots();
 #endif
+    if (cfg.gc_threads_)
+      transaction_proto2_static::StartBackgroundGC(cfg.gc_threads_);
     typedef ndb_database<transaction_proto2> Database;
     Database *raw = new Database;
     db.reset(raw);
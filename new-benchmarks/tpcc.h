@@ -175,6 +175,70 @@ DO_STRUCT(warehouse, WAREHOUSE_KEY_FIELDS, WAREHOUSE_VALUE_FIELDS)
   x(stock_data) \
   x(warehouse)
 
+// the schema each table is opened with
+template <typename T>
+struct tpcc_schema {
+  typedef schema<T> type;
+};
+
+// the fields of T::value not in mask
+#define TPCC_OTHER_FIELDS(T, mask) \
+  (((1UL << T::value::NFIELDS) - 1) & ~(mask))
+
+// the hot fields of warehouse, district and customer rows are each in their
+// own column group: new order reads w_tax, d_tax and the customer's static
+// fields, and increments d_next_o_id, whereas payment (and delivery) update
+// the ytd and balance fields
+
+#define TPCC_WAREHOUSE_YTD_FIELDS \
+  ::util::compute_fields_mask(warehouse::value::w_ytd_field)
+template <>
+struct tpcc_schema<warehouse> {
+  typedef column_group_schema<
+    warehouse,
+    TPCC_OTHER_FIELDS(warehouse, TPCC_WAREHOUSE_YTD_FIELDS),
+    TPCC_WAREHOUSE_YTD_FIELDS> type;
+};
+#undef TPCC_WAREHOUSE_YTD_FIELDS
+
+#define TPCC_DISTRICT_YTD_FIELDS \
+  ::util::compute_fields_mask(district::value::d_ytd_field)
+#define TPCC_DISTRICT_NEXT_O_ID_FIELDS \
+  ::util::compute_fields_mask(district::value::d_next_o_id_field)
+template <>
+struct tpcc_schema<district> {
+  typedef column_group_schema<
+    district,
+    TPCC_OTHER_FIELDS(
+      district, TPCC_DISTRICT_YTD_FIELDS | TPCC_DISTRICT_NEXT_O_ID_FIELDS),
+    TPCC_DISTRICT_YTD_FIELDS,
+    TPCC_DISTRICT_NEXT_O_ID_FIELDS> type;
+};
+#undef TPCC_DISTRICT_YTD_FIELDS
+#undef TPCC_DISTRICT_NEXT_O_ID_FIELDS
+
+#define TPCC_CUSTOMER_BALANCE_FIELDS \
+  ::util::compute_fields_mask( \
+    customer::value::c_balance_field, \
+    customer::value::c_ytd_payment_field, \
+    customer::value::c_payment_cnt_field, \
+    customer::value::c_delivery_cnt_field)
+#define TPCC_CUSTOMER_DATA_FIELDS \
+  ::util::compute_fields_mask(customer::value::c_data_field)
+template <>
+struct tpcc_schema<customer> {
+  typedef column_group_schema<
+    customer,
+    TPCC_OTHER_FIELDS(
+      customer, TPCC_CUSTOMER_BALANCE_FIELDS | TPCC_CUSTOMER_DATA_FIELDS),
+    TPCC_CUSTOMER_BALANCE_FIELDS,
+    TPCC_CUSTOMER_DATA_FIELDS> type;
+};
+#undef TPCC_CUSTOMER_BALANCE_FIELDS
+#undef TPCC_CUSTOMER_DATA_FIELDS
+
+#undef TPCC_OTHER_FIELDS
+
 template <typename Database, bool AllowReadOnlyScans>
   class tpcc_bench_runner;
 
@@ -188,12 +252,13 @@ private:  \
   std::vector< \
     std::shared_ptr< \
       typename Database::template IndexType< \
-        schema< name > \
+        typename tpcc_schema< name >::type \
       >::type \
     > \
   > tbl_ ## name ## _vec; \
 public: \
-  inline ALWAYS_INLINE typename Database::template IndexType<schema< name >>::type * \
+  inline ALWAYS_INLINE typename Database::template IndexType< \
+    typename tpcc_schema< name >::type>::type * \
   tbl_ ## name(unsigned int wid) \
   { \
     INVARIANT(wid >= 1); \
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <iterator>
+#include <limits>
 #include <string>
 
 #include "counter.h"
+#include "lockguard.h"
 #include "macros.h"
+#include "spinlock.h"
 #include "util.h"
 
 // abstract queue for RCU-like queues
@@ -246,8 +249,17 @@ struct basic_px_queue {
   empty_accept_from(basic_px_queue &source, uint64_t rcu_tick)
   {
     ALWAYS_ASSERT(empty());
+    accept_from(source, rcu_tick);
+  }
+
+  // appends the entries of source <= rcu_tick. the entries of source must
+  // not be from ticks before the ones already in this instance
+  inline void
+  accept_from(basic_px_queue &source, uint64_t rcu_tick)
+  {
     INVARIANT(this != &source);
-    INVARIANT(!tail_);
+    INVARIANT(!tail_ || !source.head_ ||
+              tail_->rcu_tick_ <= source.head_->rcu_tick_);
     px_group *p = source.head_, *pnext;
     while (p && p->rcu_tick_ <= rcu_tick) {
       pnext = p->next_;
@@ -352,3 +364,49 @@ private:
   px_group *freelist_tail_;
   size_t ngroups_;
 };
+
+// hands entries which are already safe to reclaim from the thread which
+// queued them to a background reclaimer. both sides only move group
+// pointers while holding the lock, so neither waits on the other's frees
+template <typename T, size_t N>
+struct basic_px_handoff {
+  typedef basic_px_queue<T, N> px_queue;
+
+  basic_px_handoff() = default;
+  basic_px_handoff(const basic_px_handoff &) = delete;
+  basic_px_handoff &operator=(const basic_px_handoff &) = delete;
+
+  // owner side: moves the entries of source <= rcu_tick over, and takes
+  // back the groups the reclaimer has finished with
+  void
+  publish(px_queue &source, uint64_t rcu_tick)
+  {
+    ::lock_guard<spinlock> l(lock_);
+    ready_.accept_from(source, rcu_tick);
+    ready_.transfer_freelist(source);
+  }
+
+  // reclaimer side: moves everything published so far into dest, which
+  // must be empty. returns false if there was nothing
+  bool
+  take(px_queue &dest)
+  {
+    ::lock_guard<spinlock> l(lock_);
+    dest.empty_accept_from(ready_, std::numeric_limits<uint64_t>::max());
+    return !dest.empty();
+  }
+
+  // reclaimer side: returns the groups of a taken (and cleared) queue, so
+  // the owner can reuse them
+  void
+  give_back(px_queue &q)
+  {
+    INVARIANT(q.empty());
+    ::lock_guard<spinlock> l(lock_);
+    q.transfer_freelist(ready_);
+  }
+
+private:
+  spinlock lock_;
+  px_queue ready_;
+};
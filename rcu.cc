@@ -24,14 +24,19 @@ static event_counter evt_rcu_frees("rcu_frees");
 static event_counter evt_rcu_local_reaps("rcu_local_reaps");
 static event_counter evt_rcu_incomplete_local_reaps("rcu_incomplete_local_reaps");
 static event_counter evt_rcu_loop_reaps("rcu_loop_reaps");
+static event_counter evt_rcu_handoffs("rcu_handoffs");
+static event_counter evt_rcu_background_deletes("rcu_background_deletes");
 static event_counter *evt_allocator_arena_allocations[::allocator::MAX_ARENAS] = {nullptr};
 static event_counter *evt_allocator_arena_deallocations[::allocator::MAX_ARENAS] = {nullptr};
 static event_counter evt_allocator_large_allocation("allocator_large_allocation");
+static event_counter evt_allocator_remote_deallocation("allocator_remote_deallocation");
+static event_counter evt_allocator_remote_flushes("allocator_remote_flushes");
 
 static event_avg_counter evt_avg_gc_reaper_queue_len("avg_gc_reaper_queue_len");
 static event_avg_counter evt_avg_rcu_delete_queue_len("avg_rcu_delete_queue_len");
 static event_avg_counter evt_avg_rcu_local_delete_queue_len("avg_rcu_local_delete_queue_len");
 static event_avg_counter evt_avg_rcu_sync_try_release("avg_rcu_sync_try_release");
+static event_avg_counter evt_avg_allocator_remote_flush_len("avg_allocator_remote_flush_len");
 static event_avg_counter evt_avg_time_inbetween_rcu_epochs_usec(
     "avg_time_inbetween_rcu_epochs_usec");
 static event_avg_counter evt_avg_time_inbetween_allocator_releases_usec(
@@ -117,7 +122,7 @@ rcu::sync::alloc(size_t sz)
   void *p = arenas_[arena];
   INVARIANT(p);
 #ifdef MEMCHECK_MAGIC
-  const size_t alloc_size = (arena + 1) * ::allocator::AllocAlignment;
+  const size_t alloc_size = ::allocator::ArenaAllocSize(arena);
   check_pointer_or_die(p, alloc_size);
 #endif
   arenas_[arena] = *reinterpret_cast<void **>(p);
@@ -147,19 +152,28 @@ rcu::sync::dealloc(void *p, size_t sz)
   auto sizes = ::allocator::ArenaSize(sz);
   auto arena = sizes.second;
   ALWAYS_ASSERT(arena < ::allocator::MAX_ARENAS);
-  *reinterpret_cast<void **>(p) = arenas_[arena];
+  // objects of other cores (or any core, if we are not pinned) go back to
+  // their own core, so our arenas only ever hand out local memory
+  const bool remote = ssize_t(::allocator::PointerToCpu(p)) != pin_cpu_;
+  void ** const list = remote ? &remote_arenas_[arena] : &arenas_[arena];
+  *reinterpret_cast<void **>(p) = *list;
 #ifdef MEMCHECK_MAGIC
-  const size_t alloc_size = (arena + 1) * ::allocator::AllocAlignment;
+  const size_t alloc_size = ::allocator::ArenaAllocSize(arena);
   ALWAYS_ASSERT( ((uintptr_t)p % alloc_size) == 0 );
   NDB_MEMSET(
       (char *) p + sizeof(void **),
       MEMCHECK_MAGIC, alloc_size - sizeof(void **));
-  ALWAYS_ASSERT(*((void **) p) == arenas_[arena]);
+  ALWAYS_ASSERT(*((void **) p) == *list);
   check_pointer_or_die(p, alloc_size);
 #endif
-  arenas_[arena] = p;
+  *list = p;
   evt_allocator_arena_deallocations[arena]->inc();
-  deallocs_[arena]++;
+  if (remote) {
+    nremote_++;
+    ++evt_allocator_remote_deallocation;
+  } else {
+    deallocs_[arena]++;
+  }
 }
 
 bool
@@ -184,7 +198,7 @@ rcu::sync::do_release()
 {
 #ifdef MEMCHECK_MAGIC
   for (size_t i = 0; i < ::allocator::MAX_ARENAS; i++) {
-    const size_t alloc_size = (i + 1) * ::allocator::AllocAlignment;
+    const size_t alloc_size = ::allocator::ArenaAllocSize(i);
     void *p = arenas_[i];
     while (p) {
       check_pointer_or_die(p, alloc_size);
@@ -195,6 +209,31 @@ rcu::sync::do_release()
   ::allocator::ReleaseArenas(&arenas_[0]);
   NDB_MEMSET(&arenas_[0], 0, sizeof(arenas_));
   NDB_MEMSET(&deallocs_[0], 0, sizeof(deallocs_));
+  flush_remote();
+}
+
+void
+rcu::sync::flush_remote()
+{
+  if (!nremote_)
+    return;
+#ifdef MEMCHECK_MAGIC
+  for (size_t i = 0; i < ::allocator::MAX_ARENAS; i++) {
+    const size_t alloc_size = ::allocator::ArenaAllocSize(i);
+    void *p = remote_arenas_[i];
+    while (p) {
+      check_pointer_or_die(p, alloc_size);
+      p = *((void **) p);
+    }
+  }
+#endif
+  // ReleaseArenas() groups the objects by core, and splices each core's
+  // share onto its lists under a single acquisition of its lock
+  ::allocator::ReleaseArenas(&remote_arenas_[0]);
+  NDB_MEMSET(&remote_arenas_[0], 0, sizeof(remote_arenas_));
+  ++evt_allocator_remote_flushes;
+  evt_avg_allocator_remote_flush_len.offer(nremote_);
+  nremote_ = 0;
 }
 
 void
@@ -221,11 +260,24 @@ rcu::sync::do_cleanup()
 #endif
   last_reaped_epoch_ = clean_tick;
 
+  if (impl_->background_reclaim() && !reclaimer_) {
+    // a reclaimer runs the epoch's frees; we only take care of our arenas
+    impl_->publish_handoff(*this, clean_tick);
+    flush_remote();
+    try_release();
+    return;
+  }
+  if (unlikely(published_))
+    // anything handed off before background mode was turned off
+    impl_->reclaim(coreid::core_id());
+
   scratch_.empty_accept_from(queue_, clean_tick);
   scratch_.transfer_freelist(queue_);
   rcu::px_queue &q = scratch_;
-  if (q.empty())
+  if (q.empty()) {
+    flush_remote();
     return;
+  }
   scoped_rcu_region guard;
   size_t n = 0;
   for (auto it = q.begin(); it != q.end(); ++it, ++n) {
@@ -239,6 +291,9 @@ rcu::sync::do_cleanup()
   evt_rcu_deletes += n;
   evt_avg_rcu_local_delete_queue_len.offer(n);
 
+  // the epoch's frees of other cores' memory go back in one batch
+  flush_remote();
+
   // try to release memory from allocator slabs back
   if (try_release()) {
 #ifdef ENABLE_EVENT_COUNTERS
@@ -252,6 +307,52 @@ rcu::sync::do_cleanup()
   }
 }
 
+void
+rcu::publish_handoff(sync &s, uint64_t clean_tick)
+{
+  s.handoff_.publish(s.queue_, clean_tick);
+  ++evt_rcu_handoffs;
+  if (likely(s.published_))
+    return;
+  s.published_ = true;
+  const size_t core = coreid::core_id();
+  handoffs_[core].store(&s, memory_order_release);
+  size_t n = nhandoffs_.load(memory_order_acquire);
+  while (n <= core &&
+         !nhandoffs_.compare_exchange_weak(n, core + 1, memory_order_acq_rel))
+    ;
+}
+
+size_t
+rcu::reclaim(size_t core)
+{
+  sync * const s = handoffs_[core].load(memory_order_acquire);
+  if (!s)
+    return 0;
+  sync &me = mysync();
+  INVARIANT(!me.depth());
+  px_queue q;
+  if (!s->handoff_.take(q))
+    return 0;
+  size_t n = 0;
+  {
+    // the deleters may themselves free with RCU
+    scoped_rcu_base<false> guard;
+    for (auto it = q.begin(); it != q.end(); ++it, ++n) {
+      try {
+        it->run(me);
+      } catch (...) {
+        cerr << "rcu::reclaim: uncaught exception in free routine" << endl;
+      }
+    }
+  }
+  q.clear();
+  s->handoff_.give_back(q);
+  evt_rcu_deletes += n;
+  evt_rcu_background_deletes += n;
+  return n;
+}
+
 void
 rcu::free_with_fn(void *p, deleter_t fn)
 {
@@ -288,6 +389,7 @@ rcu::pin_current_thread(size_t cpu)
   sync &s = mysync();
   s.set_pin_cpu(cpu);
   auto node = numa_node_of_cpu(cpu);
+  s.node_.store(node, memory_order_relaxed);
   // pin to node
   ALWAYS_ASSERT(!numa_run_on_node(node));
   // is numa_run_on_node() guaranteed to take effect immediately?
@@ -306,8 +408,10 @@ rcu::fault_region()
 }
 
 rcu::rcu()
-  : syncs_()
+  : syncs_(), background_reclaim_(false), nhandoffs_(0)
 {
+  for (size_t i = 0; i < NMAXCORES; i++)
+    handoffs_[i].store(nullptr, memory_order_relaxed);
   // XXX: these should really be instance members of RCU
   // we are assuming only one rcu object is ever created
   for (size_t i = 0; i < ::allocator::MAX_ARENAS; i++) {
@@ -383,8 +487,179 @@ rcu_stress_test()
   cerr << "rcu stress test completed" << endl;
 }
 
+static void
+rcu_size_class_test()
+{
+  // every size maps to the smallest size class which fits it, and the
+  // size classes are monotonic
+  size_t last_arena = 0;
+  for (size_t sz = 1; sz <= ::allocator::MaxArenaAllocSize; sz++) {
+    const auto p = ::allocator::ArenaSize(sz);
+    ALWAYS_ASSERT(p.second < ::allocator::MAX_ARENAS);
+    ALWAYS_ASSERT(p.first >= sz);
+    ALWAYS_ASSERT((p.first % ::allocator::AllocAlignment) == 0);
+    ALWAYS_ASSERT(p.first == ::allocator::ArenaAllocSize(p.second));
+    ALWAYS_ASSERT(!p.second || sz > ::allocator::ArenaAllocSize(p.second - 1));
+    ALWAYS_ASSERT(p.second == last_arena || p.second == last_arena + 1);
+    last_arena = p.second;
+  }
+  ALWAYS_ASSERT(last_arena == ::allocator::MAX_ARENAS - 1);
+  ALWAYS_ASSERT(
+      ::allocator::ArenaSize(::allocator::MaxArenaAllocSize + 1).second >=
+      ::allocator::MAX_ARENAS);
+
+  // blocks from the large size classes are distinct and hold their contents
+  rcu::s_instance.pin_current_thread(0);
+  vector<pair<uint8_t *, size_t>> blocks;
+  for (size_t sz = 600; sz <= ::allocator::MaxArenaAllocSize; sz += sz / 3) {
+    for (size_t i = 0; i < 4; i++) {
+      uint8_t * const p = (uint8_t *) rcu::s_instance.alloc(sz);
+      ALWAYS_ASSERT(::allocator::ManagesPointer(p));
+      NDB_MEMSET(p, uint8_t(blocks.size()), sz);
+      blocks.emplace_back(p, sz);
+    }
+  }
+  for (size_t i = 0; i < blocks.size(); i++) {
+    for (size_t j = 0; j < blocks[i].second; j++)
+      ALWAYS_ASSERT(blocks[i].first[j] == uint8_t(i));
+    rcu::s_instance.dealloc(blocks[i].first, blocks[i].second);
+  }
+  cerr << "rcu size class test completed" << endl;
+}
+
+static void
+rcu_idle_release_test()
+{
+  static const size_t hugepgsize = ::allocator::GetHugepageSize();
+  rcu::s_instance.pin_current_thread(0);
+  const size_t sz = ::allocator::MaxArenaAllocSize;
+  const size_t n = 4 * hugepgsize / sz;
+  vector<void *> blocks;
+  for (size_t i = 0; i < n; i++) {
+    void * const p = rcu::s_instance.alloc(sz);
+    NDB_MEMSET(p, 0xAB, sz);
+    blocks.push_back(p);
+  }
+  const size_t resident = ::allocator::ResidentBytes();
+  const size_t reserved = ::allocator::ReservedBytes();
+  for (auto p : blocks)
+    rcu::s_instance.dealloc(p, sz);
+
+  // hand the thread local arenas back to the cpu, whose (now fully free)
+  // hugepages can then be released
+  rcu::s_instance.pin_current_thread(0);
+  ::allocator::ReleaseIdleMemory();
+  ALWAYS_ASSERT(::allocator::ResidentBytes() + 4 * hugepgsize <= resident);
+
+  // released hugepages are handed out again before the region grows
+  for (auto &p : blocks) {
+    p = rcu::s_instance.alloc(sz);
+    NDB_MEMSET(p, 0xCD, sz);
+  }
+  for (auto p : blocks) {
+    for (size_t i = 0; i < sz; i++)
+      ALWAYS_ASSERT(((const uint8_t *) p)[i] == 0xCD);
+    rcu::s_instance.dealloc(p, sz);
+  }
+  ALWAYS_ASSERT(::allocator::ReservedBytes() == reserved);
+  ALWAYS_ASSERT(::allocator::ResidentBytes() <= resident);
+  cerr << "rcu idle release test completed" << endl;
+}
+
+static void
+rcu_remote_free_test()
+{
+  static const size_t hugepgsize = ::allocator::GetHugepageSize();
+  rcu::s_instance.pin_current_thread(0);
+  const size_t sz = ::allocator::MaxArenaAllocSize;
+  const size_t n = 4 * hugepgsize / sz;
+  vector<void *> blocks;
+  for (size_t i = 0; i < n; i++) {
+    void * const p = rcu::s_instance.alloc(sz);
+    NDB_MEMSET(p, 0xAB, sz);
+    blocks.push_back(p);
+  }
+  const size_t resident = ::allocator::ResidentBytes();
+
+  // an (unpinned) thread's frees of cpu 0's memory go back to cpu 0 at its
+  // next epoch boundary, instead of staying on its own arena lists
+  thread t([&blocks, sz]() {
+    for (auto p : blocks)
+      rcu::s_instance.dealloc(p, sz);
+    usleep(2 * rcu::EpochTimeUsec);
+    scoped_rcu_region guard;
+  });
+  t.join();
+
+  ::allocator::ReleaseIdleMemory();
+  ALWAYS_ASSERT(::allocator::ResidentBytes() + 4 * hugepgsize <= resident);
+  cerr << "rcu remote free test completed" << endl;
+}
+
+static atomic<size_t> rcu_background_test_ndeletes(0);
+static atomic<bool> rcu_background_test_inline_delete(false);
+static __thread bool rcu_background_test_is_reclaimer = false;
+
+static void
+rcu_background_test_deleter_fn(void *px)
+{
+  if (!rcu_background_test_is_reclaimer)
+    rcu_background_test_inline_delete.store(true, memory_order_release);
+  rcu::s_instance.dealloc(px, sizeof(rcu_stress_test_rec));
+  rcu_background_test_ndeletes.fetch_add(1, memory_order_acq_rel);
+}
+
+static void
+rcu_background_reclaim_test()
+{
+  static const size_t n = 10000;
+  rcu::s_instance.set_background_reclaim(true);
+  atomic<int> worker_core(-1);
+  atomic<bool> done(false);
+
+  // the worker only ever hands its frees off, and the reclaimer runs all
+  // of them
+  thread worker([&worker_core, &done]() {
+    rcu::s_instance.pin_current_thread(0);
+    worker_core.store(coreid::core_id(), memory_order_release);
+    for (size_t i = 0; i < n; i++) {
+      scoped_rcu_region guard;
+      void * const p = rcu::s_instance.alloc(sizeof(rcu_stress_test_rec));
+      rcu::s_instance.free_with_fn(p, rcu_background_test_deleter_fn);
+    }
+    while (!done.load(memory_order_acquire)) {
+      { scoped_rcu_region guard; }
+      usleep(ticker::tick_us);
+    }
+  });
+  thread reclaimer([&worker_core, &done]() {
+    rcu::s_instance.set_reclaimer();
+    rcu_background_test_is_reclaimer = true;
+    int core;
+    while ((core = worker_core.load(memory_order_acquire)) == -1)
+      nop_pause();
+    while (rcu_background_test_ndeletes.load(memory_order_acquire) < n) {
+      if (!rcu::s_instance.reclaim(core))
+        usleep(ticker::tick_us);
+      rcu::s_instance.do_cleanup();
+    }
+    ALWAYS_ASSERT(rcu::s_instance.handoff_node(core) >= 0);
+    done.store(true, memory_order_release);
+  });
+  worker.join();
+  reclaimer.join();
+  ALWAYS_ASSERT(rcu_background_test_ndeletes.load() == n);
+  ALWAYS_ASSERT(!rcu_background_test_inline_delete.load());
+  rcu::s_instance.set_background_reclaim(false);
+  cerr << "rcu background reclaim test completed" << endl;
+}
+
 void
 rcu::Test()
 {
+  rcu_size_class_test();
+  rcu_idle_release_test();
+  rcu_remote_free_test();
+  rcu_background_reclaim_test();
   rcu_stress_test();
 }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <pthread.h>
 
+#include <atomic>
 #include <map>
 #include <vector>
 #include <list>
@@ -52,6 +53,7 @@ public:
       }
   };
   typedef basic_px_queue<delete_entry, 4096> px_queue;
+  typedef basic_px_handoff<delete_entry, 4096> px_handoff;
 
   template <typename T>
   static inline void
@@ -91,6 +93,7 @@ public:
   public:
     px_queue queue_;
     px_queue scratch_;
+    px_handoff handoff_; // expired frees, waiting for a reclaimer
     unsigned depth_; // 0 indicates no rcu region
     unsigned last_reaped_epoch_;
 #ifdef ENABLE_EVENT_COUNTERS
@@ -107,6 +110,16 @@ public:
     size_t deallocs_[allocator::MAX_ARENAS]; // keeps track of the number of
                                              // un-released deallocations
 
+    // objects freed by this thread which belong to other cores' regions.
+    // instead of being reused locally, they are handed back to their cores
+    // in bulk once per RCU epoch (see flush_remote())
+    void *remote_arenas_[allocator::MAX_ARENAS];
+    size_t nremote_;
+
+    bool reclaimer_; // runs its own frees even in background mode
+    bool published_; // in impl_->handoffs_
+    std::atomic<int> node_; // NUMA node of pin_cpu_
+
   public:
 
     sync(rcu *impl)
@@ -124,6 +137,11 @@ public:
       scratch_.alloc_freelist(NQueueGroups);
       NDB_MEMSET(&arenas_[0], 0, sizeof(arenas_));
       NDB_MEMSET(&deallocs_[0], 0, sizeof(deallocs_));
+      NDB_MEMSET(&remote_arenas_[0], 0, sizeof(remote_arenas_));
+      nremote_ = 0;
+      reclaimer_ = false;
+      published_ = false;
+      node_.store(0, std::memory_order_relaxed);
     }
 
     inline void
@@ -162,6 +180,9 @@ public:
 
     void do_release();
 
+    // returns the remote frees to their cores
+    void flush_remote();
+
     inline void
     ensure_arena(size_t arena)
     {
@@ -209,6 +230,48 @@ public:
 
   void free_with_fn(void *p, deleter_t fn);
 
+  // background reclamation: while enabled, threads hand the frees of each
+  // expired epoch to a reclaimer thread instead of running them on the way
+  // out of their RCU region. reclaimers call reclaim() for the cores they
+  // serve, and run (and hand off) nothing else
+  inline void
+  set_background_reclaim(bool enabled)
+  {
+    background_reclaim_.store(enabled, std::memory_order_release);
+  }
+
+  inline bool
+  background_reclaim() const
+  {
+    return background_reclaim_.load(std::memory_order_acquire);
+  }
+
+  // marks the calling thread as a reclaimer
+  inline void
+  set_reclaimer()
+  {
+    mysync().reclaimer_ = true;
+  }
+
+  // cores in [0, nhandoff_cores()) may have handed off frees
+  inline size_t
+  nhandoff_cores() const
+  {
+    return nhandoffs_.load(std::memory_order_acquire);
+  }
+
+  // the NUMA node core is pinned to, or -1 if core never handed off frees
+  inline int
+  handoff_node(size_t core) const
+  {
+    const sync *s = handoffs_[core].load(std::memory_order_acquire);
+    return s ? s->node_.load(std::memory_order_relaxed) : -1;
+  }
+
+  // runs the frees core has handed off so far on the calling thread, which
+  // must not be in an RCU region. returns the number of frees run
+  size_t reclaim(size_t core);
+
   template <typename T>
   inline void
   free(T *p)
@@ -271,6 +334,8 @@ private:
 
   rcu(); // private ctor to enforce singleton
 
+  void publish_handoff(sync &s, uint64_t clean_tick);
+
   static inline uint64_t constexpr
   to_rcu_ticks(uint64_t ticks)
   {
@@ -280,6 +345,10 @@ private:
   inline sync &mysync() { return syncs_.my(this); }
 
   percore_lazy<sync> syncs_;
+
+  std::atomic<bool> background_reclaim_;
+  std::atomic<size_t> nhandoffs_;
+  std::atomic<sync *> handoffs_[NMAXCORES];
 };
 
 template <bool DoCleanup>
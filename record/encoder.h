@@ -620,6 +620,224 @@ struct schema {
   typedef typename T::value_descriptor value_descriptor_type;
   typedef encoder<key_type> key_encoder_type;
   typedef encoder<value_type> value_encoder_type;
+
+  // a plain schema stores the whole value as one record
+  static const size_t NColumnGroups = 1;
+};
+
+namespace private_ {
+  static inline constexpr size_t
+  popcount_mask(uint64_t m)
+  {
+    return m ? (m & 1) + popcount_mask(m >> 1) : 0;
+  }
+
+  // packs the bits of fields selected by m into the low bits, in order
+  static inline constexpr uint64_t
+  compress_mask(uint64_t fields, uint64_t m, size_t pos = 0)
+  {
+    return !m ? 0 :
+      (m & 1) ?
+        (((fields & 1) << pos) | compress_mask(fields >> 1, m >> 1, pos + 1)) :
+        compress_mask(fields >> 1, m >> 1, pos);
+  }
+
+  template <size_t G, uint64_t... Masks> struct nth_mask {};
+  template <uint64_t M, uint64_t... Masks>
+  struct nth_mask<0, M, Masks...> {
+    static const uint64_t value = M;
+  };
+  template <size_t G, uint64_t M, uint64_t... Masks>
+  struct nth_mask<G, M, Masks...> {
+    static const uint64_t value = nth_mask<G - 1, Masks...>::value;
+  };
+
+  template <uint64_t... Masks> struct union_masks {
+    static const uint64_t value = 0;
+    static const size_t nbits = 0;
+  };
+  template <uint64_t M, uint64_t... Masks>
+  struct union_masks<M, Masks...> {
+    static const uint64_t value = M | union_masks<Masks...>::value;
+    static const size_t nbits = popcount_mask(M) + union_masks<Masks...>::nbits;
+  };
+}
+
+// the projection of T's value onto the fields in Mask: a column group record
+// is encoded like a record of T with only those fields, in field order. the
+// in-memory value type is still T::value, so the group's fields are read
+// into (and written from) their usual place in the struct
+template <typename T, uint64_t Mask>
+struct column_group {
+  typedef typename T::key key;
+  typedef typename T::value value;
+
+  struct value_descriptor {
+    typedef typename T::value_descriptor base_descriptor;
+
+    // the field of T which is field i of the group
+    static inline size_t
+    base_field(size_t i)
+    {
+      uint64_t m = Mask;
+      while (i--)
+        m &= m - 1;
+      return __builtin_ctzll(m);
+    }
+
+    static inline generic_write_fn
+    write_fn(size_t i)
+    {
+      return base_descriptor::write_fn(base_field(i));
+    }
+    static inline generic_read_fn
+    read_fn(size_t i)
+    {
+      return base_descriptor::read_fn(base_field(i));
+    }
+    static inline generic_failsafe_read_fn
+    failsafe_read_fn(size_t i)
+    {
+      return base_descriptor::failsafe_read_fn(base_field(i));
+    }
+    static inline generic_nbytes_fn
+    nbytes_fn(size_t i)
+    {
+      return base_descriptor::nbytes_fn(base_field(i));
+    }
+    static inline generic_skip_fn
+    skip_fn(size_t i)
+    {
+      return base_descriptor::skip_fn(base_field(i));
+    }
+    static inline generic_failsafe_skip_fn
+    failsafe_skip_fn(size_t i)
+    {
+      return base_descriptor::failsafe_skip_fn(base_field(i));
+    }
+    static inline constexpr size_t
+    nfields()
+    {
+      return private_::popcount_mask(Mask);
+    }
+    static inline size_t
+    max_nbytes(size_t i)
+    {
+      return base_descriptor::max_nbytes(base_field(i));
+    }
+    static inline size_t
+    cstruct_offsetof(size_t i)
+    {
+      return base_descriptor::cstruct_offsetof(base_field(i));
+    }
+    static inline size_t
+    cstruct_sizeof(size_t i)
+    {
+      return base_descriptor::cstruct_sizeof(base_field(i));
+    }
+  };
+};
+
+// encodes the column_group<T, Mask> projection of a T::value, with the same
+// semantics as encoder<T::value>
+template <typename T, uint64_t Mask>
+struct column_group_encoder {
+  typedef typename T::value value_type;
+  typedef typename column_group<T, Mask>::value_descriptor descriptor;
+
+  inline const uint8_t *
+  write(uint8_t *buf, const value_type *obj) const
+  {
+    uint8_t *p = buf;
+    for (size_t i = 0; i < descriptor::nfields(); i++)
+      p = descriptor::write_fn(i)(p, field_ptr(obj, i));
+    return buf;
+  }
+
+  inline std::string &
+  write(std::string &buf, const value_type *obj) const
+  {
+    buf.clear();
+    buf.resize(nbytes(obj));
+    write((uint8_t *) buf.data(), obj);
+    return buf;
+  }
+
+  inline const value_type *
+  read(const uint8_t *buf, value_type *obj) const
+  {
+    for (size_t i = 0; i < descriptor::nfields(); i++)
+      buf = descriptor::read_fn(i)(buf, field_ptr(obj, i));
+    return obj;
+  }
+
+  inline const value_type *
+  failsafe_read(const uint8_t *buf, size_t nbytes, value_type *obj) const
+  {
+    for (size_t i = 0; i < descriptor::nfields(); i++) {
+      const uint8_t * const p =
+        descriptor::failsafe_read_fn(i)(buf, nbytes, field_ptr(obj, i));
+      if (unlikely(!p))
+        return nullptr;
+      nbytes -= (p - buf);
+      buf = p;
+    }
+    return obj;
+  }
+
+  inline size_t
+  nbytes(const value_type *obj) const
+  {
+    size_t size = 0;
+    for (size_t i = 0; i < descriptor::nfields(); i++)
+      size += descriptor::nbytes_fn(i)(field_ptr(obj, i));
+    return size;
+  }
+
+private:
+  static inline uint8_t *
+  field_ptr(const value_type *obj, size_t i)
+  {
+    return (uint8_t *) obj + descriptor::cstruct_offsetof(i);
+  }
+};
+
+// a schema whose value fields are split into column groups, given as
+// disjoint field masks which together cover every field. each group of a
+// key is stored (and versioned) as its own record, so txns which touch
+// disjoint groups of the same row do not conflict (see typed_txn_btree)
+template <typename T, uint64_t... GroupMasks>
+struct column_group_schema : public schema<T> {
+  static const size_t NColumnGroups = sizeof...(GroupMasks);
+  static_assert(NColumnGroups >= 1 && NColumnGroups <= 64,
+                "at most 64 column groups");
+  static_assert(
+      private_::union_masks<GroupMasks...>::value ==
+        (1UL << T::value_descriptor::nfields()) - 1,
+      "column groups must cover all fields");
+  static_assert(
+      private_::union_masks<GroupMasks...>::nbits ==
+        T::value_descriptor::nfields(),
+      "column groups must be disjoint");
+
+  // the schema of the records which hold group G
+  template <size_t G>
+  struct group {
+    static const uint64_t mask = private_::nth_mask<G, GroupMasks...>::value;
+    typedef column_group<T, mask> base_type;
+    typedef typename T::key key_type;
+    typedef typename T::value value_type;
+    typedef typename base_type::value_descriptor value_descriptor_type;
+    typedef encoder<key_type> key_encoder_type;
+    typedef column_group_encoder<T, mask> value_encoder_type;
+  };
+
+  static inline uint64_t
+  GroupMask(size_t g)
+  {
+    static const uint64_t masks[] = { GroupMasks... };
+    return masks[g];
+  }
 };
 
 #endif /* _NDB_BENCH_ENCODER_H_ */
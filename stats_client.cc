@@ -26,11 +26,13 @@ main(int argc, char **argv)
 {
   if (argc != 3) {
     cerr << "[usage] " << argv[0] << " sockfile counterspec" << endl;
+    cerr << "  counterspec is a ':'-separated list of counter names;" << endl;
+    cerr << "  a name ending in '*' matches all counters with that prefix" << endl;
     return 1;
   }
 
   const string sockfile(argv[1]);
-  const vector<string> counter_names = split(argv[2], ':');
+  const vector<string> counter_specs = split(argv[2], ':');
 
   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
   if (fd < 0)
@@ -49,6 +51,34 @@ main(int argc, char **argv)
 
   packet pkt;
   int r;
+
+  // expand prefix specs once up front
+  vector<string> counter_names;
+  for (auto &spec : counter_specs) {
+    if (spec.empty() || spec[spec.size() - 1] != '*') {
+      counter_names.push_back(spec);
+      continue;
+    }
+    const string prefix = spec.substr(0, spec.size() - 1);
+    uint8_t buf[1 + prefix.size()];
+    buf[0] = (uint8_t) stats_command::LIST_COUNTERS;
+    memcpy(&buf[1], prefix.data(), prefix.size());
+    pkt.assign((const char *) &buf[0], sizeof(buf));
+    if ((r = pkt.sendpkt(fd))) {
+      perror("send - disconnecting");
+      return 1;
+    }
+    if ((r = pkt.recvpkt(fd))) {
+      if (r == EOF)
+        return 0;
+      perror("recv - disconnecting");
+      return 1;
+    }
+    for (auto &name : split(string(pkt.data(), pkt.size()), '\n'))
+      if (!name.empty())
+        counter_names.push_back(name);
+  }
+
   timer loop_timer;
   for (;;) {
     for (auto &name : counter_names) {
@@ -4,7 +4,14 @@
 #include "macros.h"
 #include "fileutils.h"
 
-enum class stats_command : uint8_t { GET_COUNTER_VALUE = 0x1 };
+// both commands cover event_gauges as well as event counters (a gauge
+// reads as a counter_data of type TYPE_COUNT)
+enum class stats_command : uint8_t {
+  GET_COUNTER_VALUE = 0x1,
+  // response is a '\n' separated list of the counter names which start
+  // with the given prefix (truncated to fit in a single packet)
+  LIST_COUNTERS = 0x2,
+};
 
 struct get_counter_value_t {
   uint64_t timestamp_us_; // usec
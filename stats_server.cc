@@ -1,5 +1,6 @@
 #include <system_error>
 #include <thread>
+#include <vector>
 
 #include <unistd.h>
 #include <sys/socket.h>
@@ -53,12 +54,34 @@ stats_server::handle_cmd_get_counter_value(const string &name, packet &pkt)
 {
   get_counter_value_t ret;
   ret.timestamp_us_ = timer::cur_usec();
-  if (!event_counter::stat(name, ret.d_))
+  if (!event_counter::stat(name, ret.d_) &&
+      !event_gauge::stat(name, ret.d_))
     cerr << "could not find counter " << name << endl;
   pkt.assign((const char *) &ret, sizeof(ret));
   return true;
 }
 
+bool
+stats_server::handle_cmd_list_counters(const string &prefix, packet &pkt)
+{
+  vector<string> all;
+  for (auto &p : event_counter::get_all_counters())
+    all.push_back(p.first);
+  for (auto &p : event_gauge::get_all_gauges())
+    all.push_back(p.first);
+  string names;
+  for (auto &n : all) {
+    if (n.compare(0, prefix.size(), prefix))
+      continue;
+    if (names.size() + n.size() + 1 > packet::MAX_DATA)
+      break;
+    names += n;
+    names += '\n';
+  }
+  pkt.assign(names);
+  return true;
+}
+
 void
 stats_server::serve_client(int fd)
 {
@@ -86,6 +109,16 @@ stats_server::serve_client(int fd)
         pkt.sendpkt(fd);
         break;
       }
+    case static_cast<uint8_t>(stats_command::LIST_COUNTERS):
+      {
+        scratch.assign(pkt.data() + 1, pkt.size() - 1);
+        if (!handle_cmd_list_counters(scratch, pkt)) {
+          cerr << "error on handle_cmd_list_counters(), dropping" << endl;
+          return;
+        }
+        pkt.sendpkt(fd);
+        break;
+      }
     default:
       cerr << "bad command- dropping connection" << endl;
       return;
@@ -10,6 +10,7 @@ public:
   void serve_forever(); // blocks current thread
 private:
   bool handle_cmd_get_counter_value(const std::string &name, packet &pkt);
+  bool handle_cmd_list_counters(const std::string &prefix, packet &pkt);
   void serve_client(int fd);
   std::string sockfile_;
 };
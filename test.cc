@@ -187,6 +187,37 @@ namespace pxqueuetest {
       q1.sanity_check();
     }
 
+    {
+      typedef basic_px_handoff<rcu::delete_entry, 8> px_handoff;
+      px_queue q0, q1, q2;
+      px_handoff h;
+      for (size_t i = 0; i < 20; i++)
+        q0.enqueue(rcu::delete_entry(N2P(i), N2D(i)), 1 + i / 10);
+
+      // only the entries of the expired tick are handed off
+      h.publish(q0, 1);
+      ALWAYS_ASSERT(q0.get_ngroups() == 2);
+      ALWAYS_ASSERT(h.take(q1));
+      ALWAYS_ASSERT(!h.take(q2));
+      vector<rcu::delete_entry> v1(q1.begin(), q1.end());
+      ALWAYS_ASSERT(v1.size() == 10);
+      for (size_t i = 0; i < v1.size(); i++)
+        ALWAYS_ASSERT(v1[i].ptr == N2P(i));
+
+      // the groups find their way back to the owner
+      q1.clear();
+      h.give_back(q1);
+      h.publish(q0, 2);
+      ALWAYS_ASSERT(q0.empty());
+      ALWAYS_ASSERT(h.take(q1));
+      ALWAYS_ASSERT(q1.get_ngroups() == 2);
+      ALWAYS_ASSERT(q1.begin()->ptr == N2P(10));
+      q1.clear();
+      h.give_back(q1);
+      q0.sanity_check();
+      q1.sanity_check();
+    }
+
     cout << "pxqueue test passed" << endl;
   }
 }
@@ -1,5 +1,8 @@
+#include <memory>
+
 #include "tuple.h"
 #include "txn.h"
+#include "lockguard.h"
 
 using namespace std;
 using namespace util;
@@ -19,10 +22,111 @@ event_counter dbtuple::g_evt_dbtuple_bytes_freed("dbtuple_bytes_freed");
 event_counter dbtuple::g_evt_dbtuple_spills("dbtuple_spills");
 event_counter dbtuple::g_evt_dbtuple_inplace_buf_insufficient("dbtuple_inplace_buf_insufficient");
 event_counter dbtuple::g_evt_dbtuple_inplace_buf_insufficient_on_spill("dbtuple_inplace_buf_insufficient_on_spill");
+event_counter dbtuple::g_evt_dbtuple_spills_avoided("dbtuple_spills_avoided");
+event_counter dbtuple::g_evt_dbtuple_large_values("dbtuple_large_values");
+event_counter dbtuple::g_evt_dbtuple_large_value_bytes("dbtuple_large_value_bytes");
 
 event_avg_counter dbtuple::g_evt_avg_record_spill_len("avg_record_spill_len");
 static event_avg_counter evt_avg_dbtuple_chain_length("avg_dbtuple_chain_len");
 
+void
+value_size_stats::recompute(counts &mine)
+{
+  mine.n_ = 0;
+  uint64_t totals[NBuckets] = {0};
+  uint64_t n = 0;
+  for (size_t i = 0; i < counts_.size(); i++)
+    for (size_t b = 0; b < NBuckets; b++) {
+      totals[b] += counts_[i].buckets_[b];
+      n += counts_[i].buckets_[b];
+    }
+  uint64_t below = 0;
+  size_t b = 0;
+  while (b < NBuckets - 1 && (below += totals[b]) * 100 < n * SlackPercentile)
+    b++;
+  slack_.store(BucketSlack(b), memory_order_relaxed);
+
+  uint64_t nmine = 0;
+  for (size_t i = 0; i < NBuckets; i++)
+    nmine += mine.buckets_[i];
+  if (nmine >= DecayThreshold)
+    for (size_t i = 0; i < NBuckets; i++)
+      mine.buckets_[i] /= 2;
+}
+
+index_mem_stats *index_mem_stats::g_by_id[MaxIndexes] = {
+  new index_mem_stats(0, "<none>"),
+};
+
+index_mem_stats::index_mem_stats(id_type id, const string &name)
+  : node_bytes("index_mem/" + name + "/node_bytes"),
+    suffix_bytes("index_mem/" + name + "/suffix_bytes"),
+    live_tuple_bytes("index_mem/" + name + "/live_tuple_bytes"),
+    old_version_bytes("index_mem/" + name + "/old_version_bytes"),
+    id_(id), name_(name)
+{
+}
+
+namespace {
+  struct index_mem_registry {
+    spinlock lock_;
+    map<string, index_mem_stats *> by_name_;
+    size_t next_id_ = 1;
+  };
+
+  // never destructed, b/c tuples can be freed after static destructors
+  index_mem_registry &
+  mem_registry()
+  {
+    static index_mem_registry *s_registry = new index_mem_registry;
+    return *s_registry;
+  }
+}
+
+index_mem_stats *
+index_mem_stats::ForName(const string &name)
+{
+  index_mem_registry &r = mem_registry();
+  ::lock_guard<spinlock> l(r.lock_);
+  index_mem_stats *&px = r.by_name_[name];
+  if (px)
+    return px;
+  if (r.next_id_ == MaxIndexes) {
+    r.by_name_.erase(name);
+    return g_by_id[0];
+  }
+  const id_type id = r.next_id_++;
+  px = g_by_id[id] = new index_mem_stats(id, name);
+  return px;
+}
+
+void
+index_mem_stats::DumpAll(ostream &o)
+{
+  vector<index_mem_stats *> all;
+  {
+    index_mem_registry &r = mem_registry();
+    ::lock_guard<spinlock> l(r.lock_);
+    for (auto &p : r.by_name_)
+      all.push_back(p.second);
+  }
+  all.push_back(g_by_id[0]);
+  const auto mb = [](const event_gauge &g) {
+    return double(g.value()) / 1048576.0;
+  };
+  for (auto s : all) {
+    const double total =
+      mb(s->node_bytes) + mb(s->suffix_bytes) +
+      mb(s->live_tuple_bytes) + mb(s->old_version_bytes);
+    o << "index " << s->name() << ": "
+      << "node=" << mb(s->node_bytes) << "MB "
+      << "suffix=" << mb(s->suffix_bytes) << "MB "
+      << "live=" << mb(s->live_tuple_bytes) << "MB "
+      << "old=" << mb(s->old_version_bytes) << "MB "
+      << "total=" << total << "MB" << endl;
+  }
+}
+
 dbtuple::~dbtuple()
 {
   CheckMagic();
@@ -33,14 +137,88 @@ dbtuple::~dbtuple()
 
   VERBOSE(cerr << "dbtuple: " << hexify(intptr_t(this)) << " is being deleted" << endl);
 
-  // only free this instance
+  // only free this instance (and the large value it owns, if any)
+  if (unlikely(is_large()))
+    release_large_value(false);
 
   // stats-keeping
   ++g_evt_dbtuple_physical_deletes;
   g_evt_dbtuple_bytes_freed += (alloc_size + sizeof(dbtuple));
+  account(-ssize_t(alloc_size + sizeof(dbtuple)));
 
 }
 
+void
+dbtuple::write_large_value(const void *v, tuple_writer_t writer, size_type sz)
+{
+  INVARIANT(sz > MaxInlineValueSize);
+  INVARIANT(alloc_size >= sizeof(large_value));
+  INVARIANT(!is_large());
+
+  // writers can only produce contiguous values, so we stage the value
+  // before cutting it up into chunks
+  unique_ptr<uint8_t[]> buf(new uint8_t[sz]);
+  writer(TUPLE_WRITER_DO_WRITE, v, buf.get(), 0);
+
+  large_value lv;
+  lv.size_ = sz;
+  lv.head_ = nullptr;
+  large_value_chunk **tail = &lv.head_;
+  for (size_type off = 0; off < sz;) {
+    const size_type n = min(sz - off, size_type(large_value_chunk::MaxDataSize));
+    const size_type alloc_sz =
+      round_up<size_type, ::allocator::LgAllocAlignment>(
+          sizeof(large_value_chunk) + n);
+    large_value_chunk * const c =
+      reinterpret_cast<large_value_chunk *>(rcu::s_instance.alloc(alloc_sz));
+    INVARIANT(c);
+    c->next_ = nullptr;
+    c->size_ = n;
+    c->unused_ = 0;
+    NDB_MEMCPY(&c->data_[0], buf.get() + off, n);
+    INVARIANT(c->alloc_size() == alloc_sz);
+    *tail = c;
+    tail = &c->next_;
+    off += n;
+  }
+
+  NDB_MEMCPY(get_value_start(), &lv, sizeof(lv));
+  COMPILER_MEMORY_FENCE;
+  hdr |= HDR_LARGE_MASK;
+  account(LargeValueAllocSize(sz));
+  ++g_evt_dbtuple_large_values;
+  g_evt_dbtuple_large_value_bytes += sz;
+}
+
+void
+dbtuple::release_large_value(bool rcu)
+{
+  INVARIANT(is_large());
+  large_value lv;
+  NDB_MEMCPY(&lv, get_value_start(), sizeof(lv));
+  INVARIANT(lv.head_);
+  account(-ssize_t(LargeValueAllocSize(lv.size())));
+  hdr &= ~HDR_LARGE_MASK;
+  if (rcu) {
+    // readers which validated the old stub may still be streaming it
+    INVARIANT(rcu::s_instance.in_rcu_region());
+    rcu::s_instance.free_with_fn(lv.head_, large_value_deleter);
+  } else {
+    large_value_deleter(lv.head_);
+  }
+}
+
+void
+dbtuple::large_value_deleter(void *p)
+{
+  large_value_chunk *c = reinterpret_cast<large_value_chunk *>(p);
+  while (c) {
+    large_value_chunk * const next = c->next_;
+    rcu::s_instance.dealloc(c, c->alloc_size());
+    c = next;
+  }
+}
+
 void
 dbtuple::gc_this()
 {
@@ -59,6 +237,7 @@ dbtuple::VersionInfoStr(version_t v)
   buf << (IsWriteIntent(v) ? "WR" : "-") << " | ";
   buf << (IsModifying(v) ? "MOD" : "-") << " | ";
   buf << (IsLatest(v) ? "LATEST" : "-") << " | ";
+  buf << (IsLarge(v) ? "LARGE" : "-") << " | ";
   buf << Version(v);
   buf << "]";
   return buf.str();
@@ -70,7 +249,13 @@ format_tuple(ostream &o, const dbtuple &t)
   string truncated_contents(
       (const char *) &t.value_start[0], min(static_cast<size_t>(t.size), 16UL));
   o << &t << " [tid=" << g_proto_version_str(t.version)
-    << ", size=" << t.size
+    << ", size=" << t.size;
+  if (t.is_large()) {
+    dbtuple::large_value lv;
+    NDB_MEMCPY(&lv, &t.value_start[0], sizeof(lv));
+    o << ", large_size=" << lv.size();
+  }
+  o
     << ", contents=0x" << hexify(truncated_contents) << (t.size > 16 ? "..." : "")
     << ", next=" << t.next << "]";
   return o;
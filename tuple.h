@@ -32,6 +32,148 @@ template <template <typename> class Protocol, typename Traits>
 // XXX: hack
 extern std::string (*g_proto_version_str)(uint64_t v);
 
+/**
+ * Per-index statistics on how much values grow when they are overwritten.
+ * New tuples are allocated with slack() extra bytes of record buf (the p95
+ * of the observed growth), so that most updates can be done in place
+ * rather than spilling to a new version.
+ *
+ * Counts are kept per core, and every core halves its counts once they get
+ * large, so the slack follows the recent workload
+ */
+class value_size_stats {
+public:
+  // bucket 0 counts updates which did not grow the value, bucket i > 0
+  // updates which grew it by (MinSlack << (i - 2), MinSlack << (i - 1)]
+  // bytes (bucket 1 is (0, MinSlack]), and the last bucket everything
+  // beyond MaxSlack
+  static const size_t NBuckets = 9;
+  static const size_t MinSlack = allocator::AllocAlignment;
+  static const size_t MaxSlack = MinSlack << (NBuckets - 3);
+  static const unsigned SlackPercentile = 95;
+
+  // number of updates a core observes between recomputing the slack
+  static const uint32_t RecomputeInterval = 1024;
+  static const uint32_t DecayThreshold = 1 << 16;
+
+  value_size_stats() : slack_(0) {}
+
+  inline size_t
+  slack() const
+  {
+    return slack_.load(std::memory_order_relaxed);
+  }
+
+  inline void
+  observe(size_t old_sz, size_t new_sz)
+  {
+    counts &c = counts_.my();
+    c.buckets_[Bucket(old_sz, new_sz)]++;
+    if (unlikely(++c.n_ == RecomputeInterval))
+      recompute(c);
+  }
+
+  static inline size_t
+  Bucket(size_t old_sz, size_t new_sz)
+  {
+    if (new_sz <= old_sz)
+      return 0;
+    const size_t growth = new_sz - old_sz;
+    if (growth > MaxSlack)
+      return NBuckets - 1;
+    size_t b = 1;
+    while ((MinSlack << (b - 1)) < growth)
+      b++;
+    return b;
+  }
+
+  // the slack which absorbs all the growth counted in bucket b
+  static inline size_t
+  BucketSlack(size_t b)
+  {
+    if (!b)
+      return 0;
+    return b < NBuckets - 1 ? (MinSlack << (b - 1)) : MaxSlack;
+  }
+
+private:
+  struct counts {
+    counts() : n_(0)
+    {
+      NDB_MEMSET(&buckets_[0], 0, sizeof(buckets_));
+    }
+    uint32_t buckets_[NBuckets];
+    uint32_t n_; // observed since the last recompute
+  };
+
+  void recompute(counts &mine);
+
+  percore<counts, false, false> counts_;
+  std::atomic<size_t> slack_;
+};
+
+/**
+ * Per-index memory accounting, as four event_gauges named
+ * index_mem/<index name>/<kind>_bytes (so they can be polled through the
+ * stats server):
+ *
+ *   node:        btree nodes (or the hash table, for hashed indexes)
+ *   suffix:      btree key suffix blocks
+ *   live_tuple:  the latest version of every record (tombstones included),
+ *                along w/ the chunks of its large value
+ *   old_version: versions which have been superseded or unlinked, and are
+ *                waiting to be reclaimed by GC
+ *
+ * There is one (never destructed) instance per index name. Tuples carry
+ * the id of the instance they are accounted to, since GC can free them
+ * long after their index has gone away.
+ */
+class index_mem_stats {
+public:
+  typedef uint16_t id_type;
+
+  // indexes created beyond this many names share the instance w/ id 0,
+  // which also gets the tuples allocated outside of any index
+  static const size_t MaxIndexes = 1024;
+
+  event_gauge node_bytes;
+  event_gauge suffix_bytes;
+  event_gauge live_tuple_bytes;
+  event_gauge old_version_bytes;
+
+  inline id_type
+  id() const
+  {
+    return id_;
+  }
+
+  inline const std::string &
+  name() const
+  {
+    return name_;
+  }
+
+  static index_mem_stats *ForName(const std::string &name);
+
+  static inline ALWAYS_INLINE index_mem_stats &
+  ForId(id_type id)
+  {
+    INVARIANT(id < MaxIndexes && g_by_id[id]);
+    return *g_by_id[id];
+  }
+
+  // one line per index, w/ its gauges in MB
+  static void DumpAll(std::ostream &o);
+
+private:
+  index_mem_stats(id_type id, const std::string &name);
+
+  const id_type id_;
+  const std::string name_;
+
+  static index_mem_stats *g_by_id[MaxIndexes];
+};
+
 /**
  * A dbtuple is the type of value which we stick
  * into underlying (non-transactional) data structures- it
@@ -55,6 +197,71 @@ public:
   static const tid_t MIN_TID = 0;
   static const tid_t MAX_TID = (tid_t) -1;
 
+  // values which do not fit in the (node_size_type sized) record buf are
+  // stored out of line, as a list of chunks allocated from the rcu
+  // allocator. the record buf then only holds a large_value stub, and the
+  // large bit is set in the hdr. chunks are immutable once published, and
+  // are freed along with the tuple which owns them (or after an RCU grace
+  // period, if the value is overwritten in place)
+  static const size_type MaxInlineValueSize =
+    std::numeric_limits<node_size_type>::max();
+  static const size_type LargeValueChunkAllocSize = (1 << 15);
+
+  struct large_value_chunk {
+    large_value_chunk *next_;
+    uint32_t size_; // bytes of data_[] used
+    uint32_t unused_;
+    uint8_t data_[0];
+
+    static const size_type MaxDataSize =
+      LargeValueChunkAllocSize - 2 * sizeof(uint64_t);
+
+    inline size_type
+    alloc_size() const
+    {
+      return util::round_up<size_type, allocator::LgAllocAlignment>(
+          sizeof(*this) + size_);
+    }
+  };
+
+  struct large_value {
+    uint64_t size_; // total size of the value
+    large_value_chunk *head_;
+
+    inline size_type
+    size() const
+    {
+      return size_;
+    }
+
+    inline const large_value_chunk *
+    first() const
+    {
+      return head_;
+    }
+
+    // streams (at most) the first n bytes of the value into s, without
+    // materializing the value anywhere else first
+    template <typename String>
+    void
+    assign_to(String &s, size_type n = std::numeric_limits<size_type>::max()) const
+    {
+      n = std::min(n, size());
+      s.clear();
+      s.reserve(n);
+      for (const large_value_chunk *c = head_; c && s.size() < n; c = c->next_)
+        s.append((const char *) &c->data_[0],
+                 std::min(size_type(c->size_), n - s.size()));
+    }
+  };
+
+  // the number of bytes of record buf needed to store a value of sz bytes
+  static inline ALWAYS_INLINE size_type
+  InlineSize(size_type sz)
+  {
+    return likely(sz <= MaxInlineValueSize) ? sz : sizeof(large_value);
+  }
+
   // lock ownership helpers- works by recording all tuple
   // locks obtained in each transaction, and then when the txn
   // finishes, calling AssertAllTupleLocksReleased(), which makes
@@ -96,7 +303,10 @@ private:
   static const version_t HDR_LATEST_SHIFT = 4;
   static const version_t HDR_LATEST_MASK = 0x1 << HDR_LATEST_SHIFT;
 
-  static const version_t HDR_VERSION_SHIFT = 5;
+  static const version_t HDR_LARGE_SHIFT = 5;
+  static const version_t HDR_LARGE_MASK = 0x1 << HDR_LARGE_SHIFT;
+
+  static const version_t HDR_VERSION_SHIFT = 6;
   static const version_t HDR_VERSION_MASK = ((version_t)-1) << HDR_VERSION_SHIFT;
 
 public:
@@ -122,8 +332,8 @@ public:
   // event, so we let it happen
   //
   // <-- low bits
-  // [ locked | deleting | write_intent | modifying | latest | version ]
-  // [  0..1  |   1..2   |    2..3      |   3..4    |  4..5  |  5..32  ]
+  // [ locked | deleting | write_intent | modifying | latest | large | version ]
+  // [  0..1  |   1..2   |    2..3      |   3..4    |  4..5  | 5..6  |  6..32  ]
   volatile version_t hdr;
 
 #ifdef TUPLE_LOCK_OWNERSHIP_CHECKING
@@ -139,6 +349,8 @@ public:
   node_size_type alloc_size; // max size record allowed. is the space
                              // available for the record buf
 
+  index_mem_stats::id_type index; // who our bytes are accounted to
+
   dbtuple *next; // be very careful about traversing this pointer,
                  // GC is capable of reaping it at certain (well defined)
                  // points, and will not bother to set it to null
@@ -175,7 +387,8 @@ private:
   dbtuple &operator=(const dbtuple &) = delete;
 
   // creates a (new) record with a tentative value at MAX_TID
-  dbtuple(size_type size, size_type alloc_size, bool acquire_lock)
+  dbtuple(size_type size, size_type alloc_size, bool acquire_lock,
+          index_mem_stats::id_type index)
     :
 #ifdef TUPLE_MAGIC
       magic(TUPLE_MAGIC),
@@ -189,6 +402,7 @@ private:
       , version(MAX_TID)
       , size(CheckBounds(size))
       , alloc_size(CheckBounds(alloc_size))
+      , index(index)
       , next(nullptr)
 #ifdef TUPLE_CHECK_KEY
       , key()
@@ -203,6 +417,7 @@ private:
     INVARIANT(size || is_deleting());
     ++g_evt_dbtuple_creates;
     g_evt_dbtuple_bytes_allocated += alloc_size + sizeof(dbtuple);
+    account(footprint());
 #ifdef TUPLE_LOCK_OWNERSHIP_CHECKING
     if (acquire_lock) {
       lock_owner = std::this_thread::get_id();
@@ -214,7 +429,8 @@ private:
   }
 
   // creates a record at version derived from base
-  // (inheriting its value).
+  // (inheriting its value- a large value is shared with base, which must
+  // give up ownership of it).
   dbtuple(tid_t version,
           struct dbtuple *base,
           size_type alloc_size,
@@ -223,13 +439,14 @@ private:
 #ifdef TUPLE_MAGIC
       magic(TUPLE_MAGIC),
 #endif
-      hdr(set_latest ? HDR_LATEST_MASK : 0)
+      hdr((set_latest ? HDR_LATEST_MASK : 0) | (base->hdr & HDR_LARGE_MASK))
 #ifdef TUPLE_LOCK_OWNERSHIP_CHECKING
       , lock_owner()
 #endif
       , version(version)
       , size(base->size)
       , alloc_size(CheckBounds(alloc_size))
+      , index(base->index)
       , next(base->next)
 #ifdef TUPLE_CHECK_KEY
       , key()
@@ -246,6 +463,7 @@ private:
     NDB_MEMCPY(&value_start[0], base->get_value_start(), size);
     ++g_evt_dbtuple_creates;
     g_evt_dbtuple_bytes_allocated += alloc_size + sizeof(dbtuple);
+    account(footprint());
   }
 
   // creates a spill record, copying in the *old* value if necessary, but
@@ -257,7 +475,8 @@ private:
           size_type alloc_size,
           struct dbtuple *next,
           bool set_latest,
-          bool needs_old_value)
+          bool needs_old_value,
+          index_mem_stats::id_type index)
     :
 #ifdef TUPLE_MAGIC
       magic(TUPLE_MAGIC),
@@ -269,6 +488,7 @@ private:
       , version(version)
       , size(CheckBounds(new_size))
       , alloc_size(CheckBounds(alloc_size))
+      , index(index)
       , next(next)
 #ifdef TUPLE_CHECK_KEY
       , key()
@@ -286,6 +506,7 @@ private:
       NDB_MEMCPY(&value_start[0], r, old_size);
     ++g_evt_dbtuple_creates;
     g_evt_dbtuple_bytes_allocated += alloc_size + sizeof(dbtuple);
+    account(footprint());
   }
 
   friend class rcu;
@@ -496,9 +717,25 @@ public:
     INVARIANT(is_locked());
     INVARIANT(is_lock_owner());
     INVARIANT(is_latest());
+    const size_type n = footprint();
+    index_mem_stats &s = index_mem_stats::ForId(index);
+    s.live_tuple_bytes.add(-ssize_t(n));
+    s.old_version_bytes.add(n);
     hdr &= ~HDR_LATEST_MASK;
   }
 
+  inline bool
+  is_large() const
+  {
+    return IsLarge(hdr);
+  }
+
+  static inline bool
+  IsLarge(version_t v)
+  {
+    return v & HDR_LARGE_MASK;
+  }
+
   static inline version_t
   Version(version_t v)
   {
@@ -630,6 +867,21 @@ private:
   };
 #endif
 
+  // the stub is copied out and validated against v before any chunk is
+  // touched: otherwise a concurrent in place write could have us chase
+  // inline record bytes as a chunk pointer. once validated, the chunks
+  // remain readable for the rest of our RCU region
+  template <typename Reader, typename StringAllocator>
+  inline bool
+  read_large_value(version_t v, Reader &reader, StringAllocator &sa) const
+  {
+    large_value lv;
+    NDB_MEMCPY(&lv, get_value_start(), sizeof(lv));
+    if (unlikely(!reader_check_version(v)))
+      return false;
+    return reader(static_cast<const large_value &>(lv), sa);
+  }
+
   // written to be non-recursive
   template <typename Reader, typename StringAllocator>
   static ReadStatus
@@ -650,7 +902,10 @@ private:
     if (found) {
       start_t = current->version;
       const size_t read_sz = IsDeleting(v) ? 0 : current->size;
-      if (unlikely(read_sz && !reader(current->get_value_start(), read_sz, sa)))
+      if (unlikely(read_sz &&
+                   !(likely(!IsLarge(v)) ?
+                     reader(current->get_value_start(), read_sz, sa) :
+                     current->read_large_value(v, reader, sa))))
         goto retry;
       if (unlikely(!current->reader_check_version(v)))
         goto retry;
@@ -704,7 +959,10 @@ private:
       //  return READ_FAILED;
       start_t = version;
       const size_t read_sz = IsDeleting(v) ? 0 : size;
-      if (unlikely(read_sz && !reader(get_value_start(), read_sz, sa)))
+      if (unlikely(read_sz &&
+                   !(likely(!IsLarge(v)) ?
+                     reader(get_value_start(), read_sz, sa) :
+                     read_large_value(v, reader, sa))))
         goto retry;
       if (unlikely(!reader_check_version(v)))
         goto retry;
@@ -746,6 +1004,9 @@ private:
   static event_counter g_evt_dbtuple_spills;
   static event_counter g_evt_dbtuple_inplace_buf_insufficient;
   static event_counter g_evt_dbtuple_inplace_buf_insufficient_on_spill;
+  static event_counter g_evt_dbtuple_spills_avoided;
+  static event_counter g_evt_dbtuple_large_values;
+  static event_counter g_evt_dbtuple_large_value_bytes;
   static event_avg_counter g_evt_avg_record_spill_len;
 
 public:
@@ -840,6 +1101,102 @@ public:
   };
   typedef size_t (*tuple_writer_t)(TupleWriterMode, const void *, uint8_t *, size_t);
 
+  /**
+   * Writes the sz byte value v (sz as computed by the writer) into the
+   * record buf, which must hold at least InlineSize(sz) bytes. The caller
+   * sets size, and must either own the tuple exclusively or hold the lock
+   * with the modifying bit set. Any large value previously held must have
+   * been released (or handed over) already
+   */
+  inline ALWAYS_INLINE void
+  write_value(const void *v, tuple_writer_t writer, size_type sz, size_type old_sz)
+  {
+    INVARIANT(!is_large());
+    if (likely(sz <= MaxInlineValueSize)) {
+      writer(TUPLE_WRITER_DO_WRITE, v, get_value_start(), old_sz);
+      return;
+    }
+    write_large_value(v, writer, sz);
+  }
+
+private:
+  void write_large_value(const void *v, tuple_writer_t writer, size_type sz);
+
+  // frees the chunks of a large value (after a grace period if rcu is set),
+  // and clears the large bit
+  void release_large_value(bool rcu);
+
+  // gives up ownership of a large value, which was handed over to another
+  // tuple with alloc()
+  inline void
+  disown_large_value()
+  {
+    INVARIANT(is_large());
+    account(-ssize_t(large_value_alloc_size()));
+    hdr &= ~HDR_LARGE_MASK;
+  }
+
+  // bytes of chunks a large value of sz bytes is stored in
+  static inline size_type
+  LargeValueAllocSize(size_type sz)
+  {
+    const size_type rem = sz % large_value_chunk::MaxDataSize;
+    return (sz / large_value_chunk::MaxDataSize) * LargeValueChunkAllocSize +
+      (rem ? util::round_up<size_type, allocator::LgAllocAlignment>(
+                 sizeof(large_value_chunk) + rem) : 0);
+  }
+
+  inline size_type
+  large_value_alloc_size() const
+  {
+    INVARIANT(is_large());
+    large_value lv;
+    NDB_MEMCPY(&lv, get_value_start(), sizeof(lv));
+    return LargeValueAllocSize(lv.size());
+  }
+
+  // bytes allocated for this tuple, and for the large value it owns
+  inline size_type
+  footprint() const
+  {
+    return sizeof(dbtuple) + alloc_size +
+      (unlikely(is_large()) ? large_value_alloc_size() : 0);
+  }
+
+  // charges bytes to our index, as live or old depending on whether we are
+  // the latest version (see index_mem_stats)
+  inline void
+  account(ssize_t bytes) const
+  {
+    index_mem_stats &s = index_mem_stats::ForId(index);
+    (is_latest() ? s.live_tuple_bytes : s.old_version_bytes).add(bytes);
+  }
+
+  static void large_value_deleter(void *p);
+
+  // the record buf size a tuple holding a sz byte value gets w/o slack
+  static inline size_type
+  UnslackedSize(size_type sz)
+  {
+    return util::round_up<size_type, allocator::LgAllocAlignment>(
+        sizeof(dbtuple) + sz) - sizeof(dbtuple);
+  }
+
+  // observes an update from old_sz to new_sz bytes, returns the slack to
+  // give a tuple allocated for the new value
+  static inline size_type
+  NewTupleSlack(value_size_stats *stats, size_type old_sz, size_type new_sz,
+                bool old_large)
+  {
+    if (!stats || unlikely(new_sz > MaxInlineValueSize))
+      return 0;
+    if (old_sz && new_sz && likely(!old_large))
+      stats->observe(old_sz, new_sz);
+    return stats->slack();
+  }
+
+public:
+
   /**
    * Always writes the record in the latest (newest) version slot,
    * not asserting whether or not inserting r @ t would violate the
@@ -849,11 +1206,15 @@ public:
    * ret.second = old version of tuple, iff no overwrite (can be nullptr)
    *
    * Note: if this != ret.first, then we need a tree replacement
+   *
+   * stats (if not null) are the value size stats of the index this tuple
+   * lives in: the write is observed, and a new tuple is given its slack
    */
   template <typename Transaction>
   write_record_ret
   write_record_at(const Transaction *txn, tid_t t,
-                  const void *v, tuple_writer_t writer)
+                  const void *v, tuple_writer_t writer,
+                  value_size_stats *stats)
   {
 #ifndef DISABLE_OVERWRITE_IN_PLACE
     CheckMagic();
@@ -864,9 +1225,11 @@ public:
 
     const size_t new_sz =
       v ? writer(TUPLE_WRITER_COMPUTE_NEEDED, v, get_value_start(), size) : 0;
+    const size_t new_isz = InlineSize(new_sz);
     INVARIANT(!v || new_sz);
     INVARIANT(is_deleting() || size);
     const size_t old_sz = is_deleting() ? 0 : size;
+    const size_t slack = NewTupleSlack(stats, old_sz, new_sz, is_large());
 
     if (!new_sz)
       ++g_evt_dbtuple_logical_deletes;
@@ -875,13 +1238,17 @@ public:
     if (likely(txn->can_overwrite_record_tid(version, t) && old_sz)) {
       INVARIANT(!is_deleting());
       // see if we have enough space
-      if (likely(new_sz <= alloc_size)) {
+      if (likely(new_isz <= alloc_size)) {
         // directly update in place
+        if (new_isz > UnslackedSize(old_sz) && !is_large())
+          ++g_evt_dbtuple_spills_avoided;
         mark_modifying();
+        if (unlikely(is_large()))
+          release_large_value(true);
         if (v)
-          writer(TUPLE_WRITER_DO_WRITE, v, get_value_start(), old_sz);
+          write_value(v, writer, new_sz, old_sz);
         version = t;
-        size = new_sz;
+        size = new_isz;
         if (!new_sz)
           mark_deleting();
         return write_record_ret(this, nullptr, false);
@@ -903,12 +1270,13 @@ public:
         writer(TUPLE_WRITER_NEEDS_OLD_VALUE, nullptr, nullptr, 0);
       INVARIANT(new_sz);
       INVARIANT(v);
+      INVARIANT(!needs_old_value || !is_large());
       dbtuple * const rep =
-        alloc_spill(t, get_value_start(), old_sz, new_sz,
-                    this, true, needs_old_value);
-      writer(TUPLE_WRITER_DO_WRITE, v, rep->get_value_start(), old_sz);
+        alloc_spill(t, get_value_start(), old_sz, new_isz,
+                    this, true, needs_old_value && !is_large(), index, slack);
+      rep->write_value(v, writer, new_sz, old_sz);
       INVARIANT(rep->is_latest());
-      INVARIANT(rep->size == new_sz);
+      INVARIANT(rep->size == new_isz);
       clear_latest();
       ++g_evt_dbtuple_inplace_buf_insufficient;
 
@@ -926,16 +1294,19 @@ public:
     ++g_evt_dbtuple_spills;
     g_evt_avg_record_spill_len.offer(size);
 
-    if (new_sz <= alloc_size && old_sz) {
+    if (new_isz <= alloc_size && old_sz) {
       INVARIANT(!is_deleting());
       dbtuple * const spill = alloc(version, this, false);
       INVARIANT(!spill->is_latest());
       mark_modifying();
       set_next(spill);
+      if (unlikely(is_large()))
+        // spill now owns the large value
+        disown_large_value();
       if (v)
-        writer(TUPLE_WRITER_DO_WRITE, v, get_value_start(), size);
+        write_value(v, writer, new_sz, size);
       version = t;
-      size = new_sz;
+      size = new_isz;
       if (!new_sz)
         mark_deleting();
       return write_record_ret(this, spill, true);
@@ -943,13 +1314,14 @@ public:
 
     const bool needs_old_value =
       writer(TUPLE_WRITER_NEEDS_OLD_VALUE, nullptr, nullptr, 0);
+    INVARIANT(!needs_old_value || !is_large());
     dbtuple * const rep =
-      alloc_spill(t, get_value_start(), old_sz, new_sz,
-                  this, true, needs_old_value);
+      alloc_spill(t, get_value_start(), old_sz, new_isz,
+                  this, true, needs_old_value && !is_large(), index, slack);
     if (v)
-      writer(TUPLE_WRITER_DO_WRITE, v, rep->get_value_start(), size);
+      rep->write_value(v, writer, new_sz, size);
     INVARIANT(rep->is_latest());
-    INVARIANT(rep->size == new_sz);
+    INVARIANT(rep->size == new_isz);
     INVARIANT(new_sz || rep->is_deleting()); // set by alloc_spill()
     clear_latest();
     ++g_evt_dbtuple_inplace_buf_insufficient_on_spill;
@@ -963,22 +1335,25 @@ public:
 
     const size_t new_sz =
       v ? writer(TUPLE_WRITER_COMPUTE_NEEDED, v, get_value_start(), size) : 0;
+    const size_t new_isz = InlineSize(new_sz);
     INVARIANT(!v || new_sz);
     INVARIANT(is_deleting() || size);
     const size_t old_sz = is_deleting() ? 0 : size;
+    const size_t slack = NewTupleSlack(stats, old_sz, new_sz, is_large());
 
     if (!new_sz)
       ++g_evt_dbtuple_logical_deletes;
 
     const bool needs_old_value =
       writer(TUPLE_WRITER_NEEDS_OLD_VALUE, nullptr, nullptr, 0);
+    INVARIANT(!needs_old_value || !is_large());
     dbtuple * const rep =
-      alloc_spill(t, get_value_start(), old_sz, new_sz,
-                  this, true, needs_old_value);
+      alloc_spill(t, get_value_start(), old_sz, new_isz,
+                  this, true, needs_old_value && !is_large(), index, slack);
     if (v)
-      writer(TUPLE_WRITER_DO_WRITE, v, rep->get_value_start(), size);
+      rep->write_value(v, writer, new_sz, size);
     INVARIANT(rep->is_latest());
-    INVARIANT(rep->size == new_sz);
+    INVARIANT(rep->size == new_isz);
     INVARIANT(new_sz || rep->is_deleting()); // set by alloc_spill()
     clear_latest();
     ++g_evt_dbtuple_inplace_buf_insufficient_on_spill;
@@ -986,25 +1361,32 @@ public:
 #endif
   }
 
-  // NB: we round up allocation sizes because jemalloc will do this
-  // internally anyways, so we might as well grab more usable space (really
-  // just internal vs external fragmentation)
+  // NB: we round up allocation sizes to the allocator's size class, since the
+  // arena would hand out a block of that size anyways, so we might as well
+  // grab more usable space (really just internal vs external fragmentation)
 
+  // sz is the size of the value to be written with write_value(). slack
+  // extra bytes are reserved for later updates (not for large values).
+  // index is the id of the index_mem_stats the tuple (and every version
+  // derived from it) is accounted to
   static inline dbtuple *
-  alloc_first(size_type sz, bool acquire_lock)
+  alloc_first(size_type sz, bool acquire_lock, size_type slack = 0,
+              index_mem_stats::id_type index = 0)
   {
-    INVARIANT(sz <= std::numeric_limits<node_size_type>::max());
+    if (unlikely(sz > MaxInlineValueSize))
+      slack = 0;
+    sz = InlineSize(sz);
     const size_t max_alloc_sz =
       std::numeric_limits<node_size_type>::max() + sizeof(dbtuple);
     const size_t alloc_sz =
       std::min(
-          util::round_up<size_t, allocator::LgAllocAlignment>(sizeof(dbtuple) + sz),
+          allocator::ArenaSize(sizeof(dbtuple) + sz + slack).first,
           max_alloc_sz);
     char *p = reinterpret_cast<char *>(rcu::s_instance.alloc(alloc_sz));
     INVARIANT(p);
     INVARIANT((alloc_sz - sizeof(dbtuple)) >= sz);
     return new (p) dbtuple(
-        sz, alloc_sz - sizeof(dbtuple), acquire_lock);
+        sz, alloc_sz - sizeof(dbtuple), acquire_lock, index);
   }
 
   static inline dbtuple *
@@ -1014,7 +1396,7 @@ public:
       std::numeric_limits<node_size_type>::max() + sizeof(dbtuple);
     const size_t alloc_sz =
       std::min(
-          util::round_up<size_t, allocator::LgAllocAlignment>(sizeof(dbtuple) + base->size),
+          allocator::ArenaSize(sizeof(dbtuple) + base->size).first,
           max_alloc_sz);
     char *p = reinterpret_cast<char *>(rcu::s_instance.alloc(alloc_sz));
     INVARIANT(p);
@@ -1025,7 +1407,8 @@ public:
   static inline dbtuple *
   alloc_spill(tid_t version, const_record_type value, size_type oldsz,
               size_type newsz, struct dbtuple *next, bool set_latest,
-              bool copy_old_value)
+              bool copy_old_value, index_mem_stats::id_type index,
+              size_type slack = 0)
   {
     INVARIANT(oldsz <= std::numeric_limits<node_size_type>::max());
     INVARIANT(newsz <= std::numeric_limits<node_size_type>::max());
@@ -1036,13 +1419,13 @@ public:
       std::numeric_limits<node_size_type>::max() + sizeof(dbtuple);
     const size_t alloc_sz =
       std::min(
-          util::round_up<size_t, allocator::LgAllocAlignment>(sizeof(dbtuple) + needed_sz),
+          allocator::ArenaSize(sizeof(dbtuple) + needed_sz + slack).first,
           max_alloc_sz);
     char *p = reinterpret_cast<char *>(rcu::s_instance.alloc(alloc_sz));
     INVARIANT(p);
     return new (p) dbtuple(
         version, value, oldsz, newsz,
-        alloc_sz - sizeof(dbtuple), next, set_latest, copy_old_value);
+        alloc_sz - sizeof(dbtuple), next, set_latest, copy_old_value, index);
   }
 
 
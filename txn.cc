@@ -11,6 +11,8 @@
 #include <sstream>
 #include <vector>
 #include <utility>
+#include <map>
+#include <tuple>
 
 using namespace std;
 using namespace util;
@@ -65,3 +67,95 @@ event_counter transaction_base::g_evt_dbtuple_write_insert_failed
 event_counter transaction_base::evt_local_search_lookups("local_search_lookups");
 event_counter transaction_base::evt_local_search_write_set_hits("local_search_write_set_hits");
 event_counter transaction_base::evt_dbtuple_latest_replacement("dbtuple_latest_replacement");
+
+#ifdef ENABLE_EVENT_COUNTERS
+percore<const char *, false, false> transaction_base::g_txn_type_names;
+
+namespace {
+  // XXX(stephentu): keyed by btree address, so a table which is destroyed
+  // and re-created at the same address keeps its old name in the per-core
+  // caches below
+  typedef tuple<const char *, unsigned, const concurrent_btree *>
+    abort_breakdown_key;
+  typedef map<abort_breakdown_key, event_counter *> abort_breakdown_cache;
+
+  struct abort_breakdown_registry {
+    spinlock lock_;
+    map<const concurrent_btree *, string> table_names_;
+    // event counters are never destructed, and must be unique by name
+    map<string, event_counter *> counters_;
+  };
+
+  // never destructed, b/c txn_btrees can outlive static destructors
+  abort_breakdown_registry &
+  abort_registry()
+  {
+    static abort_breakdown_registry *s_registry = new abort_breakdown_registry;
+    return *s_registry;
+  }
+}
+
+static percore_lazy<abort_breakdown_cache> g_abort_breakdown_caches;
+
+void
+transaction_base::RegisterTableName(const concurrent_btree *btr, const string &name)
+{
+  abort_breakdown_registry &r = abort_registry();
+  ::lock_guard<spinlock> l(r.lock_);
+  r.table_names_[btr] = name;
+}
+
+void
+transaction_base::UnregisterTableName(const concurrent_btree *btr)
+{
+  abort_breakdown_registry &r = abort_registry();
+  ::lock_guard<spinlock> l(r.lock_);
+  r.table_names_.erase(btr);
+}
+
+void
+transaction_base::record_abort_breakdown() const
+{
+  const char * const txn_type = g_txn_type_names.my();
+  const abort_breakdown_key k(txn_type, reason, abort_btr);
+  abort_breakdown_cache &cache = g_abort_breakdown_caches.my();
+  auto it = cache.find(k);
+  if (likely(it != cache.end())) {
+    it->second->inc();
+    return;
+  }
+
+  // slow path: first abort of this kind on this core
+  abort_breakdown_registry &r = abort_registry();
+  event_counter *ctr = nullptr;
+  {
+    ::lock_guard<spinlock> l(r.lock_);
+    string table = abort_btr ? "<unknown>" : "<none>";
+    if (abort_btr) {
+      auto nit = r.table_names_.find(abort_btr);
+      if (nit != r.table_names_.end())
+        table = nit->second;
+    }
+    const string name =
+      string("abort_breakdown/") +
+      (txn_type ? txn_type : "<unknown>") + "/" +
+      AbortReasonStr(reason) + "/" + table;
+    event_counter *&px = r.counters_[name];
+    if (!px)
+      px = new event_counter(name);
+    ctr = px;
+  }
+  cache[k] = ctr;
+  ctr->inc();
+}
+#else
+void
+transaction_base::RegisterTableName(const concurrent_btree *btr, const string &name)
+{
+}
+
+void
+transaction_base::UnregisterTableName(const concurrent_btree *btr)
+{
+}
+#endif
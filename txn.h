@@ -71,7 +71,18 @@ public:
     // txn is aborted
     TXN_FLAG_READ_ONLY = 0x2,
 
-    // XXX: more flags in the future, things like consistency levels
+    // read committed- reads see the latest committed version of a record,
+    // but are neither added to the read set nor validated at commit time,
+    // and scans do not record node versions. writes still go through the
+    // regular commit protocol
+    TXN_FLAG_READ_COMMITTED = 0x4,
+
+    // snapshot isolation- reads are served from the same consistent
+    // snapshot that TXN_FLAG_READ_ONLY txns use, and are not validated at
+    // commit time. unlike TXN_FLAG_READ_ONLY, writes are allowed; a write to
+    // a record which was modified after the snapshot aborts the txn (first
+    // committer wins)
+    TXN_FLAG_SNAPSHOT_ISOLATION = 0x8,
   };
 
 #define ABORT_REASONS(x) \
@@ -109,6 +120,7 @@ public:
   transaction_base(uint64_t flags)
     : state(TXN_EMBRYO),
       reason(ABORT_REASON_NONE),
+      abort_btr(nullptr),
       flags(flags) {}
 
   transaction_base(const transaction_base &) = delete;
@@ -152,15 +164,46 @@ public:
     return flags;
   }
 
+  // abort attribution: with ENABLE_EVENT_COUNTERS, every aborted txn bumps a
+  // (per-core) event counter named
+  //
+  //   abort_breakdown/<txn type>/<abort reason>/<conflicting table>
+  //
+  // the txn type is whatever the calling core last passed to
+  // SetTxnTypeName(), and table names come from RegisterTableName()
+
+  // name must remain valid until the next call on this core
+  static inline void
+  SetTxnTypeName(const char *name)
+  {
+#ifdef ENABLE_EVENT_COUNTERS
+    g_txn_type_names.my() = name;
+#endif
+  }
+
+  static void RegisterTableName(const concurrent_btree *btr, const std::string &name);
+  static void UnregisterTableName(const concurrent_btree *btr);
+
 protected:
 
   // the read set is a mapping from (tuple -> tid_read).
   // "write_set" is used to indicate if this read tuple
   // also belongs in the write set.
+  //
+  // the btree the tuple was read from is only kept around for abort
+  // attribution, so it is compiled out w/o event counters
   struct read_record_t {
+#ifdef ENABLE_EVENT_COUNTERS
+    constexpr read_record_t() : tuple(), t(), btr() {}
+    constexpr read_record_t(const dbtuple *tuple, tid_t t,
+                            const concurrent_btree *btr)
+      : tuple(tuple), t(t), btr(btr) {}
+#else
     constexpr read_record_t() : tuple(), t() {}
-    constexpr read_record_t(const dbtuple *tuple, tid_t t)
+    constexpr read_record_t(const dbtuple *tuple, tid_t t,
+                            const concurrent_btree *btr)
       : tuple(tuple), t(t) {}
+#endif
     inline const dbtuple *
     get_tuple() const
     {
@@ -171,9 +214,21 @@ protected:
     {
       return t;
     }
+    inline const concurrent_btree *
+    get_btree() const
+    {
+#ifdef ENABLE_EVENT_COUNTERS
+      return btr;
+#else
+      return nullptr;
+#endif
+    }
   private:
     const dbtuple *tuple;
     tid_t t;
+#ifdef ENABLE_EVENT_COUNTERS
+    const concurrent_btree *btr;
+#endif
   };
 
   friend std::ostream &
@@ -187,7 +242,7 @@ protected:
     };
 
     constexpr inline write_record_t()
-      : tuple(), k(), r(), w(), btr()
+      : tuple(), k(), r(), w(), btr(), stats()
     {}
 
     // all inputs are assumed to be stable
@@ -196,12 +251,14 @@ protected:
                           const void *r,
                           dbtuple::tuple_writer_t w,
                           concurrent_btree *btr,
+                          value_size_stats *stats,
                           bool insert)
       : tuple(tuple),
         k(k),
         r(r),
         w(w),
-        btr(btr)
+        btr(btr),
+        stats(stats)
     {
       this->btr.set_flags(insert ? FLAGS_INSERT : 0);
     }
@@ -236,6 +293,11 @@ protected:
     {
       return btr.get();
     }
+    inline value_size_stats *
+    get_size_stats() const
+    {
+      return stats;
+    }
     inline const string_type &
     get_key() const
     {
@@ -257,13 +319,36 @@ protected:
     const void *r;
     dbtuple::tuple_writer_t w;
     marked_ptr<concurrent_btree> btr; // first bit for inserted, 2nd for dowrite
+    value_size_stats *stats; // of the index btr belongs to
   };
 
   friend std::ostream &
   operator<<(std::ostream &o, const write_record_t &r);
 
   // the absent set is a mapping from (btree_node -> version_number).
-  struct absent_record_t { uint64_t version; };
+  // (like read_record_t, the btree is only kept for abort attribution)
+  struct absent_record_t {
+    uint64_t version;
+#ifdef ENABLE_EVENT_COUNTERS
+    const concurrent_btree *btr;
+#endif
+    inline void
+    set_btree(const concurrent_btree *btr)
+    {
+#ifdef ENABLE_EVENT_COUNTERS
+      this->btr = btr;
+#endif
+    }
+    inline const concurrent_btree *
+    get_btree() const
+    {
+#ifdef ENABLE_EVENT_COUNTERS
+      return btr;
+#else
+      return nullptr;
+#endif
+    }
+  };
 
   friend std::ostream &
   operator<<(std::ostream &o, const absent_record_t &r);
@@ -342,8 +427,19 @@ protected:
   CLASS_STATIC_COUNTER_DECL(scopedperf::tsc_ctr, g_txn_commit_probe5, g_txn_commit_probe5_cg);
   CLASS_STATIC_COUNTER_DECL(scopedperf::tsc_ctr, g_txn_commit_probe6, g_txn_commit_probe6_cg);
 
+#ifdef ENABLE_EVENT_COUNTERS
+  static percore<const char *, false, false> g_txn_type_names;
+
+  // called once per aborted txn, after reason/abort_btr are set
+  void record_abort_breakdown() const;
+#else
+  inline ALWAYS_INLINE void record_abort_breakdown() const {}
+#endif
+
   txn_state state;
   abort_reason reason;
+  // the table which caused the abort, if known
+  const concurrent_btree *abort_btr;
   const uint64_t flags;
 };
 
@@ -475,6 +571,12 @@ public:
   // does NOT mean that a read was stable, but it just means there were enough
   // bytes in the buffer to perform the tentative read.
   //
+  // Values larger than dbtuple::MaxInlineValueSize are not contiguous, and
+  // are instead handed over as a (stable) list of chunks:
+  //
+  //   template <typename StringAllocator>
+  //   bool operator()(const dbtuple::large_value &, StringAllocator &)
+  //
   // Note that ValueReader also exposes a dup interface
   //
   //   template <typename StringAllocator>
@@ -663,6 +765,24 @@ public:
     return get_flags() & TXN_FLAG_READ_ONLY;
   }
 
+  // true if reads are served from a consistent snapshot (either a read-only
+  // txn or a snapshot isolation txn)
+  inline ALWAYS_INLINE bool
+  reads_from_snapshot() const
+  {
+    return get_flags() &
+      (TXN_FLAG_READ_ONLY | TXN_FLAG_SNAPSHOT_ISOLATION);
+  }
+
+  // true if reads/scans are not tracked for commit-time validation
+  inline ALWAYS_INLINE bool
+  skips_read_validation() const
+  {
+    return get_flags() &
+      (TXN_FLAG_READ_ONLY | TXN_FLAG_READ_COMMITTED |
+       TXN_FLAG_SNAPSHOT_ISOLATION);
+  }
+
   // for debugging purposes only
   inline const read_set_map &
   get_read_set() const
@@ -713,18 +833,25 @@ protected:
   std::pair< dbtuple *, bool >
   try_insert_new_tuple(
       concurrent_btree &btr,
+      value_size_stats &stats,
+      index_mem_stats::id_type index,
       const std::string *key,
       const void *value,
       dbtuple::tuple_writer_t writer);
 
   // reads the contents of tuple into v
   // within this transaction context
+  //
+  // btr is the tree which tuple was found in (used for abort attribution)
   template <typename ValueReader>
   bool
-  do_tuple_read(const dbtuple *tuple, ValueReader &value_reader);
+  do_tuple_read(const concurrent_btree *btr, const dbtuple *tuple,
+                ValueReader &value_reader);
 
   void
-  do_node_read(const typename concurrent_btree::node_opaque_t *n, uint64_t version);
+  do_node_read(const concurrent_btree *btr,
+               const typename concurrent_btree::node_opaque_t *n,
+               uint64_t version);
 
 public:
   // expected public overrides
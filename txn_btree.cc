@@ -3,6 +3,7 @@
 #include <memory>
 #include <atomic>
 #include <mutex>
+#include <functional>
 
 #include "txn.h"
 #include "txn_proto2_impl.h"
@@ -308,6 +309,163 @@ test_inc_value_size()
   }
 }
 
+static string
+large_value_of(size_t sz, unsigned seed)
+{
+  string v(sz, 0);
+  for (size_t i = 0; i < sz; i++)
+    v[i] = char(i * 131 + seed + (i >> 16));
+  return v;
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_large_values()
+{
+  const size_t sizes[] = {
+    dbtuple::MaxInlineValueSize,
+    dbtuple::MaxInlineValueSize + 1,
+    100000,
+    1 << 20,
+    (4 << 20) + 3,
+    16,
+  };
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    txn_btree<TxnType> btr;
+    typename Traits::StringAllocator arena;
+
+    // every transition between inline and large values, both through
+    // inserts of new keys and overwrites of the same key
+    for (size_t i = 0; i < ARRAY_NELEMS(sizes); i++) {
+      const string v = large_value_of(sizes[i], i);
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        btr.insert(t, u64_varkey(0), (const uint8_t *) v.data(), v.size());
+        btr.insert(t, u64_varkey(i + 1), (const uint8_t *) v.data(), v.size());
+        AssertSuccessfulCommit(t);
+      }
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        string v0, v1, v2;
+        ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(0), v0));
+        ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(i + 1), v1));
+        ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(i + 1), v2, 1000));
+        AssertSuccessfulCommit(t);
+        ALWAYS_ASSERT(v0 == v);
+        ALWAYS_ASSERT(v1 == v);
+        ALWAYS_ASSERT(v2 == v.substr(0, 1000));
+      }
+    }
+
+    // a snapshot keeps reading the large value it started with
+    txn_epoch_sync<TxnType>::sync();
+    {
+      const string v = large_value_of(sizes[3], 3);
+      const string vnew = large_value_of(sizes[2], 7);
+      TxnType<Traits>
+        t0(txn_flags, arena),
+        t1(txn_flags | transaction_base::TXN_FLAG_READ_ONLY, arena);
+      string v1;
+      ALWAYS_ASSERT_COND_IN_TXN(t1, btr.search(t1, u64_varkey(4), v1));
+      ALWAYS_ASSERT(v1 == v);
+      btr.insert(t0, u64_varkey(4), (const uint8_t *) vnew.data(), vnew.size());
+      AssertSuccessfulCommit(t0);
+      ALWAYS_ASSERT_COND_IN_TXN(t1, btr.search(t1, u64_varkey(4), v1));
+      ALWAYS_ASSERT(v1 == v);
+      AssertSuccessfulCommit(t1);
+    }
+
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      for (size_t i = 0; i <= ARRAY_NELEMS(sizes); i++)
+        btr.remove(t, u64_varkey(i));
+      AssertSuccessfulCommit(t);
+    }
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      string v;
+      for (size_t i = 0; i <= ARRAY_NELEMS(sizes); i++)
+        ALWAYS_ASSERT_COND_IN_TXN(t, !btr.search(t, u64_varkey(i), v));
+      AssertSuccessfulCommit(t);
+    }
+
+    // the tombstones must be unlinked before btr goes away
+    const uint64_t deadline = timer::cur_usec() + 10 * 1000000;
+    size_t sz;
+    for (;;) {
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        AssertSuccessfulCommit(t);
+      }
+      {
+        scoped_rcu_region guard;
+        sz = btr.size_estimate();
+      }
+      if (!sz || timer::cur_usec() > deadline)
+        break;
+      usleep(1000);
+    }
+    ALWAYS_ASSERT(!sz);
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_large_values passed" << endl;
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_value_size_slack()
+{
+  ALWAYS_ASSERT(value_size_stats::Bucket(100, 100) == 0);
+  ALWAYS_ASSERT(value_size_stats::Bucket(100, 90) == 0);
+  ALWAYS_ASSERT(value_size_stats::Bucket(100, 101) == 1);
+  ALWAYS_ASSERT(value_size_stats::Bucket(100, 140) == 3);
+  ALWAYS_ASSERT(value_size_stats::Bucket(0, 1 << 20) ==
+                value_size_stats::NBuckets - 1);
+  for (size_t b = 1; b < value_size_stats::NBuckets - 1; b++)
+    ALWAYS_ASSERT(value_size_stats::Bucket(
+          100, 100 + value_size_stats::BucketSlack(b)) == b);
+
+  const size_t nkeys = 4 * value_size_stats::RecomputeInterval;
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    txn_btree<TxnType> btr;
+    typename Traits::StringAllocator arena;
+    ALWAYS_ASSERT(btr.get_value_size_stats().slack() == 0);
+
+    // every key grows by 40 bytes per round, so the learned slack must be
+    // the smallest bucket covering that
+    for (size_t round = 0; round < 4; round++) {
+      const string v(64 + 40 * round, 'a' + round);
+      for (size_t i = 0; i < nkeys; i++) {
+        TxnType<Traits> t(txn_flags, arena);
+        btr.insert(t, u64_varkey(i), (const uint8_t *) v.data(), v.size());
+        AssertSuccessfulCommit(t);
+      }
+      if (round)
+        ALWAYS_ASSERT(btr.get_value_size_stats().slack() == 64);
+    }
+
+    for (size_t i = 0; i < nkeys; i += 97) {
+      TxnType<Traits> t(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(i), v));
+      AssertSuccessfulCommit(t);
+      ALWAYS_ASSERT(v == string(64 + 40 * 3, 'd'));
+    }
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_value_size_slack passed" << endl;
+}
+
 template <template <typename> class TxnType, typename Traits>
 static void
 test_multi_btree()
@@ -344,6 +502,92 @@ test_multi_btree()
   }
 }
 
+namespace test_bulk_load_ns {
+
+// checks that record i has value to_string(i)
+template <template <typename> class Protocol>
+class sequential_scan_callback : public txn_btree<Protocol>::search_range_callback {
+public:
+  sequential_scan_callback() : ctr(0) {}
+
+  virtual bool
+  invoke(const typename txn_btree<Protocol>::keystring_type &k, const string &v)
+  {
+    ALWAYS_ASSERT(v == to_string(ctr));
+    ctr++;
+    return true;
+  }
+  size_t ctr;
+};
+
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_bulk_load()
+{
+  using namespace test_bulk_load_ns;
+  const size_t N = 4000;
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    txn_btree<TxnType> btr;
+    typename Traits::StringAllocator arena;
+
+    {
+      // two loaders covering [0, N/2) and [N/2, N)
+      typename txn_btree<TxnType>::bulk_loader l0(&btr), l1(&btr);
+      for (size_t i = 0; i < N; i++) {
+        const string v = to_string(i);
+        (i < N / 2 ? l0 : l1).add(u64_varkey(i).str(), &v, txn_btree_::tuple_writer);
+      }
+      btr.bulk_load({&l0, &l1});
+    }
+    {
+      scoped_rcu_region guard;
+      ALWAYS_ASSERT(btr.size_estimate() == N);
+    }
+
+    for (size_t i = 0; i < N; i++) {
+      TxnType<Traits> t(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(i), v));
+      AssertSuccessfulCommit(t);
+      ALWAYS_ASSERT(v == to_string(i));
+    }
+
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      sequential_scan_callback<TxnType> c;
+      btr.search_range_call(t, u64_varkey(0), nullptr, c);
+      AssertSuccessfulCommit(t);
+      ALWAYS_ASSERT(c.ctr == N);
+    }
+
+    // loaded records behave like committed ones
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      btr.put(t, u64_varkey(10), string("new"));
+      btr.put(t, u64_varkey(N), string("end"));
+      AssertSuccessfulCommit(t);
+    }
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(10), v));
+      ALWAYS_ASSERT_COND_IN_TXN(t, v == "new");
+      ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(N), v));
+      ALWAYS_ASSERT_COND_IN_TXN(t, v == "end");
+      AssertSuccessfulCommit(t);
+    }
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_bulk_load passed" << endl;
+}
+
 template <template <typename> class TxnType, typename Traits>
 static void
 test_read_only_snapshot()
@@ -390,6 +634,110 @@ test_read_only_snapshot()
   }
 }
 
+template <template <typename> class TxnType, typename Traits>
+static void
+test_weak_isolation()
+{
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    txn_btree<TxnType> btr;
+    typename Traits::StringAllocator arena;
+
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      btr.insert_object(t, u64_varkey(0), rec(0));
+      btr.insert_object(t, u64_varkey(1), rec(0));
+      AssertSuccessfulCommit(t);
+    }
+
+    // read committed: a concurrent overwrite of a record we read
+    // does not cause an abort
+    {
+      TxnType<Traits>
+        t0(txn_flags | transaction_base::TXN_FLAG_READ_COMMITTED, arena),
+        t1(txn_flags, arena);
+      string v0;
+      ALWAYS_ASSERT_COND_IN_TXN(t0, btr.search(t0, u64_varkey(0), v0));
+      AssertByteEquality(rec(0), v0);
+      ALWAYS_ASSERT_COND_IN_TXN(t0, t0.get_read_set().empty());
+
+      btr.insert_object(t1, u64_varkey(0), rec(1));
+      AssertSuccessfulCommit(t1);
+
+      ALWAYS_ASSERT_COND_IN_TXN(t0, btr.search(t0, u64_varkey(0), v0));
+      AssertByteEquality(rec(1), v0);
+      btr.insert_object(t0, u64_varkey(1), rec(1));
+      AssertSuccessfulCommit(t0);
+    }
+
+    // see test_read_only_snapshot()
+    txn_epoch_sync<TxnType>::sync();
+
+    // snapshot isolation: reads come from the snapshot, and writing
+    // a record which changed after the snapshot aborts
+    {
+      TxnType<Traits>
+        t0(txn_flags | transaction_base::TXN_FLAG_SNAPSHOT_ISOLATION, arena),
+        t1(txn_flags, arena);
+      string v0;
+      btr.insert_object(t1, u64_varkey(0), rec(2));
+      AssertSuccessfulCommit(t1);
+
+      ALWAYS_ASSERT_COND_IN_TXN(t0, btr.search(t0, u64_varkey(0), v0));
+      AssertByteEquality(rec(1), v0);
+      ALWAYS_ASSERT_COND_IN_TXN(t0, t0.get_read_set().empty());
+      btr.insert_object(t0, u64_varkey(0), rec(3));
+      AssertFailedCommit(t0);
+    }
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_abort_breakdown()
+{
+#ifdef ENABLE_EVENT_COUNTERS
+  txn_btree<TxnType> btr(sizeof(rec), false, "abort_breakdown_tbl");
+  typename Traits::StringAllocator arena;
+
+  {
+    TxnType<Traits> t(0, arena);
+    btr.insert_object(t, u64_varkey(0), rec(0));
+    AssertSuccessfulCommit(t);
+  }
+
+  const string name =
+    "abort_breakdown/test_txn/ABORT_REASON_READ_NODE_INTEREFERENCE/"
+    "abort_breakdown_tbl";
+  counter_data before;
+  event_counter::stat(name, before);
+
+  transaction_base::SetTxnTypeName("test_txn");
+  {
+    TxnType<Traits> t0(0, arena), t1(0, arena);
+    string v0;
+    ALWAYS_ASSERT_COND_IN_TXN(t0, btr.search(t0, u64_varkey(0), v0));
+    btr.insert_object(t0, u64_varkey(1), rec(1));
+    btr.insert_object(t1, u64_varkey(0), rec(1));
+    AssertSuccessfulCommit(t1);
+    AssertFailedCommit(t0);
+  }
+  transaction_base::SetTxnTypeName(nullptr);
+
+  counter_data after;
+  ALWAYS_ASSERT(event_counter::stat(name, after));
+  ALWAYS_ASSERT(after.count_ == before.count_ + 1);
+
+  txn_epoch_sync<TxnType>::sync();
+  txn_epoch_sync<TxnType>::finish();
+#endif
+}
+
 namespace test_long_keys_ns {
 
 static inline string
@@ -577,6 +925,366 @@ test_insert_same_key()
   }
 }
 
+namespace test_tombstone_unlink_ns {
+
+template <template <typename> class Protocol>
+class counting_scan_callback : public txn_btree<Protocol>::search_range_callback {
+public:
+  counting_scan_callback() : n(0) {}
+
+  virtual bool
+  invoke(const typename txn_btree<Protocol>::keystring_type &k, const string &v)
+  {
+    n++;
+    return true;
+  }
+  size_t n;
+};
+
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_tombstone_unlink()
+{
+  using namespace test_tombstone_unlink_ns;
+  const size_t N = 1000;
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    txn_btree<TxnType> btr;
+    typename Traits::StringAllocator arena;
+
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      for (size_t i = 0; i < N; i++)
+        btr.put(t, u64_varkey(i), to_string(i));
+      AssertSuccessfulCommit(t);
+    }
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      for (size_t i = 0; i < N; i++)
+        btr.remove(t, u64_varkey(i));
+      AssertSuccessfulCommit(t);
+    }
+    // revive one key before its tombstone is unlinked
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      btr.put(t, u64_varkey(0), string("back"));
+      AssertSuccessfulCommit(t);
+    }
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      counting_scan_callback<TxnType> c;
+      btr.search_range_call(t, u64_varkey(0), nullptr, c);
+      AssertSuccessfulCommit(t);
+      ALWAYS_ASSERT(c.n == 1);
+    }
+
+    // the tombstones are unlinked as this thread finishes txns
+    const uint64_t deadline = timer::cur_usec() + 10 * 1000000;
+    size_t sz;
+    for (;;) {
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        AssertSuccessfulCommit(t);
+      }
+      {
+        scoped_rcu_region guard;
+        sz = btr.size_estimate();
+      }
+      if (sz == 1 || timer::cur_usec() > deadline)
+        break;
+      usleep(1000);
+    }
+    ALWAYS_ASSERT(sz == 1);
+
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(0), v));
+      ALWAYS_ASSERT_COND_IN_TXN(t, v == "back");
+      ALWAYS_ASSERT_COND_IN_TXN(t, !btr.search(t, u64_varkey(1), v));
+      AssertSuccessfulCommit(t);
+    }
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_tombstone_unlink passed" << endl;
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_hash_index()
+{
+  const size_t N = 1000;
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    txn_btree<TxnType> btr(sizeof(rec), false, "hash_tbl", true);
+    typename Traits::StringAllocator arena;
+
+    // enough keys to grow the table a few times
+    for (size_t i = 0; i < N; i++) {
+      TxnType<Traits> t(txn_flags, arena);
+      btr.insert_object(t, u64_varkey(i), rec(i));
+      AssertSuccessfulCommit(t);
+    }
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      for (size_t i = 0; i < N; i++) {
+        string v;
+        ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(i), v));
+        AssertByteEquality(rec(i), v);
+      }
+      AssertSuccessfulCommit(t);
+    }
+
+    // phantom protection: t0 must not miss a key which was inserted after
+    // it read it as absent
+    {
+      TxnType<Traits> t0(txn_flags, arena), t1(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t0, !btr.search(t0, u64_varkey(N), v));
+      btr.insert_object(t1, u64_varkey(N), rec(N));
+      AssertSuccessfulCommit(t1);
+      btr.insert_object(t0, u64_varkey(N + 1), rec(N + 1));
+      AssertFailedCommit(t0);
+    }
+
+#if !defined(NDB_MASSTREE)
+    // growing the table conservatively invalidates absent reads
+    {
+      TxnType<Traits> t0(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t0, !btr.search(t0, u64_varkey(10 * N), v));
+      for (size_t i = N + 1; i < 4 * N; i++) {
+        TxnType<Traits> t(txn_flags, arena);
+        btr.insert_object(t, u64_varkey(i), rec(i));
+        AssertSuccessfulCommit(t);
+      }
+      btr.insert_object(t0, u64_varkey(10 * N + 1), rec(0));
+      AssertFailedCommit(t0);
+    }
+#endif
+
+    // removed keys are unlinked from the table by GC
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      for (size_t i = 1; i < 4 * N; i++)
+        btr.remove(t, u64_varkey(i));
+      AssertSuccessfulCommit(t);
+    }
+    const uint64_t deadline = timer::cur_usec() + 10 * 1000000;
+    size_t sz;
+    for (;;) {
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        AssertSuccessfulCommit(t);
+      }
+      {
+        scoped_rcu_region guard;
+        sz = btr.size_estimate();
+      }
+      if (sz == 1 || timer::cur_usec() > deadline)
+        break;
+      usleep(1000);
+    }
+    ALWAYS_ASSERT(sz == 1);
+    {
+      TxnType<Traits> t(txn_flags, arena);
+      string v;
+      ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(0), v));
+      ALWAYS_ASSERT_COND_IN_TXN(t, !btr.search(t, u64_varkey(1), v));
+      AssertSuccessfulCommit(t);
+    }
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_hash_index passed" << endl;
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_mem_accounting()
+{
+  const size_t N = 1000;
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    const string name = "mem_tbl" + to_string(txn_flags_idx);
+    typename Traits::StringAllocator arena;
+    const index_mem_stats *s = nullptr;
+
+    // old versions are reclaimed as this thread finishes txns
+    const auto wait_for = [&](function<bool()> pred) {
+      const uint64_t deadline = timer::cur_usec() + 10 * 1000000;
+      while (!pred() && timer::cur_usec() < deadline) {
+        {
+          TxnType<Traits> t(txn_flags, arena);
+          AssertSuccessfulCommit(t);
+        }
+        usleep(1000);
+      }
+      ALWAYS_ASSERT(pred());
+    };
+    // every key gets its own slice and a suffix
+    const auto key = [](size_t i) {
+      return u64_varkey(i).str() + "-suffix";
+    };
+
+    {
+      txn_btree<TxnType> btr(128, false, name);
+      s = &btr.get_mem_stats();
+      ALWAYS_ASSERT(s == index_mem_stats::ForName(name));
+      ALWAYS_ASSERT(s->node_bytes.value() > 0);
+      ALWAYS_ASSERT(s->suffix_bytes.value() == 0);
+      ALWAYS_ASSERT(s->live_tuple_bytes.value() == 0);
+      ALWAYS_ASSERT(s->old_version_bytes.value() == 0);
+
+      const string v0(100, 'a');
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        for (size_t i = 0; i < N; i++)
+          btr.put(t, key(i), v0);
+        AssertSuccessfulCommit(t);
+      }
+      ALWAYS_ASSERT(s->suffix_bytes.value() > 0);
+      ALWAYS_ASSERT(s->live_tuple_bytes.value() >=
+                    int64_t(N * (sizeof(dbtuple) + v0.size())));
+      ALWAYS_ASSERT(s->old_version_bytes.value() == 0);
+
+      // outgrowing the record bufs moves the old versions out of live
+      const string v1(1000, 'b');
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        for (size_t i = 0; i < N; i++)
+          btr.put(t, key(i), v1);
+        AssertSuccessfulCommit(t);
+      }
+      ALWAYS_ASSERT(s->live_tuple_bytes.value() >=
+                    int64_t(N * (sizeof(dbtuple) + v1.size())));
+      ALWAYS_ASSERT(s->live_tuple_bytes.value() <
+                    int64_t(N * 2 * (sizeof(dbtuple) + v1.size())));
+      wait_for([s]() { return !s->old_version_bytes.value(); });
+
+      // large values are accounted along w/ their tuple
+      const int64_t live_before = s->live_tuple_bytes.value();
+      const string big(3 * dbtuple::LargeValueChunkAllocSize, 'c');
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        btr.put(t, string("big"), big);
+        AssertSuccessfulCommit(t);
+      }
+      ALWAYS_ASSERT(s->live_tuple_bytes.value() - live_before >=
+                    int64_t(big.size()));
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        btr.remove(t, string("big"));
+        for (size_t i = 0; i < N; i++)
+          btr.remove(t, key(i));
+        AssertSuccessfulCommit(t);
+      }
+
+      // tombstones are unlinked, and everything they held reclaimed
+      wait_for([s]() {
+        return !s->live_tuple_bytes.value() &&
+               !s->old_version_bytes.value() &&
+               !s->suffix_bytes.value();
+      });
+    }
+
+    // the table is gone, and so are its nodes
+    ALWAYS_ASSERT(s->node_bytes.value() == 0);
+    ALWAYS_ASSERT(s->suffix_bytes.value() == 0);
+    wait_for([s]() { return !s->old_version_bytes.value(); });
+    ALWAYS_ASSERT(s->live_tuple_bytes.value() == 0);
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_mem_accounting passed" << endl;
+}
+
+// turns background GC on for the rest of the process: the tests after this
+// one run with it
+template <template <typename> class TxnType, typename Traits>
+static void
+test_background_gc()
+{
+  const size_t N = 1000;
+  transaction_proto2_static::StartBackgroundGC(1);
+  ALWAYS_ASSERT(transaction_proto2_static::IsBackgroundGC());
+  ALWAYS_ASSERT(rcu::s_instance.background_reclaim());
+  for (size_t txn_flags_idx = 0;
+       txn_flags_idx < ARRAY_NELEMS(TxnFlags);
+       txn_flags_idx++) {
+    const uint64_t txn_flags = TxnFlags[txn_flags_idx];
+    const string name = "bg_gc_tbl" + to_string(txn_flags_idx);
+    typename Traits::StringAllocator arena;
+    txn_btree<TxnType> btr(128, false, name);
+    const index_mem_stats &s = btr.get_mem_stats();
+
+    // this thread only hands its expired work off as it finishes txns
+    const auto wait_for = [&](function<bool()> pred) {
+      const uint64_t deadline = timer::cur_usec() + 10 * 1000000;
+      while (!pred() && timer::cur_usec() < deadline) {
+        {
+          TxnType<Traits> t(txn_flags, arena);
+          AssertSuccessfulCommit(t);
+        }
+        usleep(1000);
+      }
+      ALWAYS_ASSERT(pred());
+    };
+
+    for (size_t round = 0; round < 3; round++) {
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        for (size_t i = 0; i < N; i++)
+          btr.put(t, u64_varkey(i), string(100, 'a'));
+        AssertSuccessfulCommit(t);
+      }
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        for (size_t i = 0; i < N; i++)
+          btr.put(t, u64_varkey(i), string(1000, 'b'));
+        AssertSuccessfulCommit(t);
+      }
+      wait_for([&s]() { return !s.old_version_bytes.value(); });
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        for (size_t i = 0; i < N; i += 2)
+          btr.remove(t, u64_varkey(i));
+        AssertSuccessfulCommit(t);
+      }
+      wait_for([&]() {
+        scoped_rcu_region guard;
+        return btr.size_estimate() == N / 2 &&
+               !s.old_version_bytes.value();
+      });
+      {
+        TxnType<Traits> t(txn_flags, arena);
+        string v;
+        for (size_t i = 0; i < N; i++) {
+          ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, u64_varkey(i), v) == bool(i % 2));
+          ALWAYS_ASSERT_COND_IN_TXN(t, !(i % 2) || v == string(1000, 'b'));
+        }
+        AssertSuccessfulCommit(t);
+      }
+    }
+
+    txn_epoch_sync<TxnType>::sync();
+    txn_epoch_sync<TxnType>::finish();
+  }
+  cerr << "test_background_gc passed" << endl;
+}
+
 #define TESTREC_KEY_FIELDS(x, y) \
   x(int32_t,k0) \
   y(int32_t,k1)
@@ -689,6 +1397,201 @@ test_typed_btree()
   cerr << "test_typed_btree() passed" << endl;
 }
 
+namespace test_column_groups_ns {
+
+// {v0, v2} and {v1}
+typedef column_group_schema<
+  testrec,
+  ::util::compute_fields_mask(testrec::value::v0_field, testrec::value::v2_field),
+  ::util::compute_fields_mask(testrec::value::v1_field)> grouped_testrec;
+
+template <template <typename> class Protocol>
+class scan_callback :
+  public typed_txn_btree<Protocol, grouped_testrec>::search_range_callback {
+public:
+  scan_callback(uint64_t fields, size_t limit = ~size_t(0))
+    : n(0), fields(fields), limit(limit) {}
+
+  virtual bool
+  invoke(const testrec::key &key,
+         const testrec::value &value)
+  {
+    using test_typed_btree_ns::scan_values;
+    ALWAYS_ASSERT(n < ARRAY_NELEMS(scan_values));
+    ALWAYS_ASSERT(scan_values[n].first == key);
+    if (fields & (1UL << testrec::value::v0_field))
+      ALWAYS_ASSERT(scan_values[n].second.v0 == value.v0);
+    if (fields & (1UL << testrec::value::v1_field))
+      ALWAYS_ASSERT(scan_values[n].second.v1 == value.v1);
+    if (fields & (1UL << testrec::value::v2_field))
+      ALWAYS_ASSERT(scan_values[n].second.v2 == value.v2);
+    return ++n < limit;
+  }
+
+  size_t n;
+
+private:
+  uint64_t fields;
+  size_t limit;
+};
+
+}
+
+template <template <typename> class TxnType, typename Traits>
+static void
+test_column_groups()
+{
+  using namespace test_column_groups_ns;
+  using test_typed_btree_ns::scan_values;
+
+  typedef typed_txn_btree<TxnType, grouped_testrec> ttxn_btree_type;
+  static_assert(ttxn_btree_type::NColumnGroups == 2, "xx");
+  ttxn_btree_type btr;
+  typedef typed_txn_btree<TxnType, schema<testrec>> plain_ttxn_btree_type;
+  plain_ttxn_btree_type plain_btr;
+  typename Traits::StringAllocator arena;
+  typedef TxnType<Traits> txn_type;
+
+  const testrec::key k0(1, 1);
+  const testrec::value v0(2, 3, "hello");
+
+  {
+    txn_type t(0, arena);
+    testrec::value v;
+    ALWAYS_ASSERT_COND_IN_TXN(t, !btr.search(t, k0, v));
+    btr.insert(t, k0, v0);
+    plain_btr.insert(t, k0, v0);
+    AssertSuccessfulCommit(t);
+  }
+
+  {
+    txn_type t(0, arena);
+    testrec::value v;
+    ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, k0, v));
+    ALWAYS_ASSERT_COND_IN_TXN(t, v0 == v);
+    testrec::value v1(0, 0, "");
+    ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, k0, v1, FIELDS(1)));
+    ALWAYS_ASSERT_COND_IN_TXN(t, v1.v1 == v0.v1);
+    ALWAYS_ASSERT_COND_IN_TXN(t, v1.v0 == 0);
+    AssertSuccessfulCommit(t);
+  }
+
+  // RMWs of fields in disjoint groups do not conflict, unlike on a table w/o
+  // column groups
+  for (size_t grouped = 0; grouped < 2; grouped++) {
+    txn_type t0(0, arena), t1(0, arena);
+    testrec::value x, y;
+    if (grouped) {
+      ALWAYS_ASSERT_COND_IN_TXN(t0, btr.search(t0, k0, x, FIELDS(0)));
+      ALWAYS_ASSERT_COND_IN_TXN(t1, btr.search(t1, k0, y, FIELDS(1)));
+      x.v0++;
+      y.v1++;
+      btr.put(t0, k0, x, FIELDS(0));
+      btr.put(t1, k0, y, FIELDS(1));
+    } else {
+      ALWAYS_ASSERT_COND_IN_TXN(t0, plain_btr.search(t0, k0, x, FIELDS(0)));
+      ALWAYS_ASSERT_COND_IN_TXN(t1, plain_btr.search(t1, k0, y, FIELDS(1)));
+      x.v0++;
+      y.v1++;
+      plain_btr.put(t0, k0, x, FIELDS(0));
+      plain_btr.put(t1, k0, y, FIELDS(1));
+    }
+    AssertSuccessfulCommit(t0);
+    if (grouped)
+      AssertSuccessfulCommit(t1);
+    else
+      AssertFailedCommit(t1);
+  }
+
+  {
+    txn_type t(0, arena);
+    testrec::value v;
+    ALWAYS_ASSERT_COND_IN_TXN(t, btr.search(t, k0, v));
+    ALWAYS_ASSERT_COND_IN_TXN(t, v.v0 == v0.v0 + 1);
+    ALWAYS_ASSERT_COND_IN_TXN(t, v.v1 == v0.v1 + 1);
+    ALWAYS_ASSERT_COND_IN_TXN(t, v.v2 == v0.v2);
+    AssertSuccessfulCommit(t);
+  }
+
+  // fields of the same group still conflict
+  {
+    txn_type t0(0, arena), t1(0, arena);
+    testrec::value x, y;
+    ALWAYS_ASSERT_COND_IN_TXN(t0, btr.search(t0, k0, x, FIELDS(0)));
+    ALWAYS_ASSERT_COND_IN_TXN(t1, btr.search(t1, k0, y, FIELDS(2)));
+    x.v0++;
+    y.v2.assign("world");
+    btr.put(t0, k0, x, FIELDS(0));
+    btr.put(t1, k0, y, FIELDS(2));
+    AssertSuccessfulCommit(t0);
+    AssertFailedCommit(t1);
+  }
+
+  {
+    txn_type t(0, arena);
+    for (size_t i = 0; i < ARRAY_NELEMS(scan_values); i++)
+      btr.insert(t, scan_values[i].first, scan_values[i].second);
+    AssertSuccessfulCommit(t);
+  }
+
+  {
+    txn_type t(0, arena);
+    const testrec::key begin(10, 0);
+    scan_callback<TxnType> cb0(FIELDS(2).value);
+    btr.search_range_call(t, begin, nullptr, cb0, false, FIELDS(2));
+    ALWAYS_ASSERT_COND_IN_TXN(t, cb0.n == ARRAY_NELEMS(scan_values));
+    scan_callback<TxnType> cb1(ttxn_btree_type::AllFieldsMask);
+    btr.search_range_call(t, begin, nullptr, cb1);
+    ALWAYS_ASSERT_COND_IN_TXN(t, cb1.n == ARRAY_NELEMS(scan_values));
+    scan_callback<TxnType> cb2(FIELDS(1).value, 2);
+    btr.search_range_call(t, begin, nullptr, cb2, false, FIELDS(1));
+    ALWAYS_ASSERT_COND_IN_TXN(t, cb2.n == 2);
+    AssertSuccessfulCommit(t);
+  }
+
+  {
+    txn_type t(0, arena);
+    btr.remove(t, k0);
+    for (size_t i = 0; i < ARRAY_NELEMS(scan_values); i++)
+      btr.remove(t, scan_values[i].first);
+    AssertSuccessfulCommit(t);
+  }
+
+  {
+    txn_type t(0, arena);
+    testrec::value v;
+    ALWAYS_ASSERT_COND_IN_TXN(t, !btr.search(t, k0, v));
+    ALWAYS_ASSERT_COND_IN_TXN(t, !btr.search(t, k0, v, FIELDS(1)));
+    scan_callback<TxnType> cb(ttxn_btree_type::AllFieldsMask);
+    btr.search_range_call(t, testrec::key(0, 0), nullptr, cb);
+    ALWAYS_ASSERT_COND_IN_TXN(t, cb.n == 0);
+    AssertSuccessfulCommit(t);
+  }
+
+  // the tree must not go away w/ tombstones queued
+  const uint64_t deadline = timer::cur_usec() + 10 * 1000000;
+  size_t sz;
+  for (;;) {
+    {
+      txn_type t(0, arena);
+      AssertSuccessfulCommit(t);
+    }
+    {
+      scoped_rcu_region guard;
+      sz = btr.size_estimate();
+    }
+    if (!sz || timer::cur_usec() > deadline)
+      break;
+    usleep(1000);
+  }
+  ALWAYS_ASSERT(!sz);
+
+  txn_epoch_sync<TxnType>::sync();
+  txn_epoch_sync<TxnType>::finish();
+
+  cerr << "test_column_groups passed" << endl;
+}
+
 template <template <typename> class Protocol>
 class txn_btree_worker : public ndb_thread {
 public:
@@ -1883,15 +2786,25 @@ void txn_btree_test()
 {
   cerr << "Test proto2" << endl;
   test_typed_btree<transaction_proto2, default_stable_transaction_traits>();
+  test_column_groups<transaction_proto2, default_stable_transaction_traits>();
   test1<transaction_proto2, default_transaction_traits>();
   test2<transaction_proto2, default_transaction_traits>();
   test_absent_key_race<transaction_proto2, default_transaction_traits>();
   test_inc_value_size<transaction_proto2, default_transaction_traits>();
+  test_large_values<transaction_proto2, default_transaction_traits>();
+  test_value_size_slack<transaction_proto2, default_transaction_traits>();
   test_multi_btree<transaction_proto2, default_transaction_traits>();
+  test_bulk_load<transaction_proto2, default_transaction_traits>();
   test_read_only_snapshot<transaction_proto2, default_transaction_traits>();
+  test_weak_isolation<transaction_proto2, default_transaction_traits>();
+  test_abort_breakdown<transaction_proto2, default_transaction_traits>();
   test_long_keys<transaction_proto2, default_transaction_traits>();
   test_long_keys2<transaction_proto2, default_transaction_traits>();
   test_insert_same_key<transaction_proto2, default_transaction_traits>();
+  test_tombstone_unlink<transaction_proto2, default_transaction_traits>();
+  test_hash_index<transaction_proto2, default_transaction_traits>();
+  test_mem_accounting<transaction_proto2, default_transaction_traits>();
+  test_background_gc<transaction_proto2, default_transaction_traits>();
 
   //mp_stress_test_allocator<transaction_proto2, default_transaction_traits>();
   mp_stress_test_insert_removes<transaction_proto2, default_transaction_traits>();
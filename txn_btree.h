@@ -58,6 +58,14 @@ struct txn_btree_ {
       return true;
     }
 
+    template <typename StringAllocator>
+    inline bool
+    operator()(const dbtuple::large_value &lv, StringAllocator &sa)
+    {
+      lv.assign_to(*px, max_bytes_read);
+      return true;
+    }
+
     inline std::string &
     results()
     {
@@ -99,6 +107,15 @@ struct txn_btree_ {
       return true;
     }
 
+    template <typename StringAllocator>
+    inline bool
+    operator()(const dbtuple::large_value &lv, StringAllocator &sa)
+    {
+      px = sa();
+      lv.assign_to(*px, max_bytes_read);
+      return true;
+    }
+
     inline std::string &
     results()
     {
@@ -284,8 +301,9 @@ public:
 
   txn_btree(size_type value_size_hint = 128,
             bool mostly_append = false,
-            const std::string &name = "<unknown>")
-    : super_type(value_size_hint, mostly_append, name)
+            const std::string &name = "<unknown>",
+            bool hashed = false)
+    : super_type(value_size_hint, mostly_append, name, hashed)
   {}
 
   template <typename Traits>
@@ -60,6 +60,7 @@ transaction<Protocol, Traits>::abort_impl(abort_reason reason)
   }
   state = TXN_ABRT;
   this->reason = reason;
+  record_abort_breakdown();
 
   // on abort, we need to go over all insert nodes and
   // release the locks
@@ -133,6 +134,20 @@ namespace {
         oss << " | TXN_FLAG_READ_ONLY";
       first = false;
     }
+    if (flags & transaction_base::TXN_FLAG_READ_COMMITTED) {
+      if (first)
+        oss << "TXN_FLAG_READ_COMMITTED";
+      else
+        oss << " | TXN_FLAG_READ_COMMITTED";
+      first = false;
+    }
+    if (flags & transaction_base::TXN_FLAG_SNAPSHOT_ISOLATION) {
+      if (first)
+        oss << "TXN_FLAG_SNAPSHOT_ISOLATION";
+      else
+        oss << " | TXN_FLAG_SNAPSHOT_ISOLATION";
+      first = false;
+    }
     return oss.str();
   }
 }
@@ -300,6 +315,7 @@ transaction<Protocol, Traits>::commit(bool doThrow)
         if (likely(last_px && last_px->tuple != it->tuple)) {
           // on boundary
           if (unlikely(!handle_last_tuple_in_group(*last_px, inserted_last_run))) {
+            abort_btr = last_px->entry->get_btree();
             abort_trap((reason = ABORT_REASON_WRITE_NODE_INTERFERENCE));
             goto do_abort;
           }
@@ -318,6 +334,7 @@ transaction<Protocol, Traits>::commit(bool doThrow)
       }
       if (likely(last_px) &&
           unlikely(!handle_last_tuple_in_group(*last_px, inserted_last_run))) {
+        abort_btr = last_px->entry->get_btree();
         abort_trap((reason = ABORT_REASON_WRITE_NODE_INTERFERENCE));
         goto do_abort;
       }
@@ -362,6 +379,7 @@ transaction<Protocol, Traits>::commit(bool doThrow)
 
           //std::cerr << "failed tuple: " << *it->get_tuple() << std::endl;
 
+          abort_btr = it->get_btree();
           abort_trap((reason = ABORT_REASON_READ_NODE_INTEREFERENCE));
           goto do_abort;
         }
@@ -376,6 +394,7 @@ transaction<Protocol, Traits>::commit(bool doThrow)
           if (unlikely(v != it->second.version)) {
             VERBOSE(std::cerr << "expected node " << util::hexify(it->first) << " at v="
                               << it->second.version << ", got v=" << v << std::endl);
+            abort_btr = it->second.get_btree();
             abort_trap((reason = ABORT_REASON_NODE_SCAN_READ_VERSION_CHANGED));
             goto do_abort;
           }
@@ -408,7 +427,7 @@ transaction<Protocol, Traits>::commit(bool doThrow)
           const dbtuple::write_record_ret ret =
             tuple->write_record_at(
                 cast(), commit_tid.second,
-                it->get_value(), it->get_writer());
+                it->get_value(), it->get_writer(), it->get_size_stats());
           bool unlock_head = false;
           if (unlikely(ret.head_ != tuple)) {
             // tuple was replaced by ret.head_
@@ -480,6 +499,7 @@ do_abort:
   }
 
   state = TXN_ABRT;
+  record_abort_breakdown();
   if (commit_tid.first)
     cast()->on_tid_finish(commit_tid.second);
   clear();
@@ -499,6 +519,8 @@ template <template <typename> class Protocol, typename Traits>
 std::pair< dbtuple *, bool >
 transaction<Protocol, Traits>::try_insert_new_tuple(
     concurrent_btree &btr,
+    value_size_stats &stats,
+    index_mem_stats::id_type index,
     const std::string *key,
     const void *value,
     dbtuple::tuple_writer_t writer)
@@ -509,10 +531,9 @@ transaction<Protocol, Traits>::try_insert_new_tuple(
       value, nullptr, 0) : 0;
 
   // perf: ~900 tsc/alloc on istc11.csail.mit.edu
-  dbtuple * const tuple = dbtuple::alloc_first(sz, true);
+  dbtuple * const tuple = dbtuple::alloc_first(sz, true, stats.slack(), index);
   if (value)
-    writer(dbtuple::TUPLE_WRITER_DO_WRITE,
-        value, tuple->get_value_start(), 0);
+    tuple->write_value(value, writer, sz, 0);
   INVARIANT(find_read_set(tuple) == read_set.end());
   INVARIANT(tuple->is_latest());
   INVARIANT(tuple->version == dbtuple::MAX_TID);
@@ -540,7 +561,7 @@ transaction<Protocol, Traits>::try_insert_new_tuple(
   // update write_set
   // too expensive to be practical
   // INVARIANT(find_write_set(tuple) == write_set.end());
-  write_set.emplace_back(tuple, key, value, writer, &btr, true);
+  write_set.emplace_back(tuple, key, value, writer, &btr, &stats, true);
 
   // update node #s
   INVARIANT(insert_info.node);
@@ -548,6 +569,7 @@ transaction<Protocol, Traits>::try_insert_new_tuple(
     auto it = absent_set.find(insert_info.node);
     if (it != absent_set.end()) {
       if (unlikely(it->second.version != insert_info.old_version)) {
+        abort_btr = &btr;
         abort_trap((reason = ABORT_REASON_WRITE_NODE_INTERFERENCE));
         return std::make_pair(tuple, true);
       }
@@ -565,12 +587,13 @@ template <template <typename> class Protocol, typename Traits>
 template <typename ValueReader>
 bool
 transaction<Protocol, Traits>::do_tuple_read(
-    const dbtuple *tuple, ValueReader &value_reader)
+    const concurrent_btree *btr, const dbtuple *tuple,
+    ValueReader &value_reader)
 {
   INVARIANT(tuple);
   ++evt_local_search_lookups;
 
-  const bool is_snapshot_txn = is_snapshot();
+  const bool is_snapshot_txn = reads_from_snapshot();
   const transaction_base::tid_t snapshot_tid = is_snapshot_txn ?
     cast()->snapshot_tid() : static_cast<transaction_base::tid_t>(dbtuple::MAX_TID);
   transaction_base::tid_t start_t = 0;
@@ -600,41 +623,46 @@ transaction<Protocol, Traits>::do_tuple_read(
     stat = tuple->stable_read(snapshot_tid, start_t, value_reader, this->string_allocator(), is_snapshot_txn);
     if (unlikely(stat == dbtuple::READ_FAILED)) {
       const transaction_base::abort_reason r = transaction_base::ABORT_REASON_UNSTABLE_READ;
+      abort_btr = btr;
       abort_impl(r);
       throw transaction_abort_exception(r);
     }
   }
   if (unlikely(!cast()->can_read_tid(start_t))) {
     const transaction_base::abort_reason r = transaction_base::ABORT_REASON_FUTURE_TID_READ;
+    abort_btr = btr;
     abort_impl(r);
     throw transaction_abort_exception(r);
   }
   INVARIANT(stat == dbtuple::READ_EMPTY ||
             stat == dbtuple::READ_RECORD);
   const bool v_empty = (stat == dbtuple::READ_EMPTY);
-  if (v_empty)
-    ++transaction_base::g_evt_read_logical_deleted_node_search;
-  if (!is_snapshot_txn)
+  if (!skips_read_validation())
     // read-only txns do not need read-set tracking
-    // (b/c we know the values are consistent)
-    read_set.emplace_back(tuple, start_t);
+    // (b/c we know the values are consistent), and neither
+    // do txns running at a weaker isolation level
+    read_set.emplace_back(tuple, start_t, btr);
   return !v_empty;
 }
 
 template <template <typename> class Protocol, typename Traits>
 void
 transaction<Protocol, Traits>::do_node_read(
+    const concurrent_btree *btr,
     const typename concurrent_btree::node_opaque_t *n, uint64_t v)
 {
   INVARIANT(n);
-  if (is_snapshot())
+  if (skips_read_validation())
     return;
   auto it = absent_set.find(n);
   if (it == absent_set.end()) {
-    absent_set[n].version = v;
+    absent_record_t &rec = absent_set[n];
+    rec.version = v;
+    rec.set_btree(btr);
   } else if (it->second.version != v) {
     const transaction_base::abort_reason r =
       transaction_base::ABORT_REASON_NODE_SCAN_READ_VERSION_CHANGED;
+    abort_btr = btr;
     abort_impl(r);
     throw transaction_abort_exception(r);
   }
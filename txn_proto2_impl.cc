@@ -484,6 +484,24 @@ transaction_proto2_static::InitGC()
   g_flags->g_gc_init.store(true, memory_order_release);
 }
 
+void
+transaction_proto2_static::StartBackgroundGC(size_t nthreads_per_node)
+{
+  ALWAYS_ASSERT(nthreads_per_node > 0);
+  bool expected = false;
+  if (!g_flags->g_background_gc.compare_exchange_strong(
+        expected, true, memory_order_acq_rel))
+    return;
+  rcu::s_instance.set_background_reclaim(true);
+  const int nnodes = numa_max_node() + 1;
+  for (int node = 0; node < nnodes; node++)
+    for (size_t i = 0; i < nthreads_per_node; i++) {
+      thread t(&transaction_proto2_static::gc_reclaimer_loop,
+               node, i, nthreads_per_node);
+      t.detach();
+    }
+}
+
 static void
 sleep_ro_epoch()
 {
@@ -504,6 +522,14 @@ transaction_proto2_static::PurgeThreadOutstandingGCTasks()
   INVARIANT(!rcu::s_instance.in_rcu_region());
   threadctx &ctx = g_threadctxs.my();
   uint64_t e;
+  if (ctx.tombstones_.get_latest_epoch(e)) {
+    // unlinking a tombstone can requeue it onto ctx.queue_, so drain these
+    // first
+    while (ticker::s_instance.global_last_tick_inclusive() < e)
+      nop_pause();
+    clean_up_tombstones_to_including(ctx, e);
+    INVARIANT(ctx.tombstones_.empty());
+  }
   if (!ctx.queue_.get_latest_epoch(e))
     return;
   // wait until we can clean up e
@@ -562,13 +588,39 @@ transaction_proto2_static::clean_up_to_including(threadctx &ctx, uint64_t ro_tic
 #endif
   ctx.last_reaped_epoch_ = ro_tick_geq;
 
+#ifdef CHECK_INVARIANTS
+  const uint64_t last_tick_ex = ticker::s_instance.global_last_tick_exclusive();
+  INVARIANT(last_tick_ex);
+  INVARIANT(to_read_only_tick(last_tick_ex) > ro_tick_geq);
+#endif
+
+  if (HandsOffGC(ctx)) {
+    ctx.handoff_.publish(ctx.queue_, ro_tick_geq);
+    publish_threadctx(ctx);
+    return;
+  }
+  if (unlikely(ctx.published_))
+    // anything handed off before background mode was turned off
+    reap_handoffs(ctx, ctx);
+
+  ctx.scratch_.empty_accept_from(ctx.queue_, ro_tick_geq);
+  ctx.scratch_.transfer_freelist(ctx.queue_);
+  reap_queue(ctx, ctx.scratch_);
+}
+
+size_t
+transaction_proto2_static::reap_queue(threadctx &ctx, px_queue &q)
+{
+  INVARIANT(!rcu::s_instance.in_rcu_region());
+  if (q.empty())
+    return 0;
+
 #ifdef CHECK_INVARIANTS
   const uint64_t last_tick_ex = ticker::s_instance.global_last_tick_exclusive();
   INVARIANT(last_tick_ex);
   const uint64_t last_consistent_tid = ComputeReadOnlyTid(last_tick_ex - 1);
   const uint64_t computed_last_tick_ex = ticker::s_instance.compute_global_last_tick_exclusive();
   INVARIANT(last_tick_ex <= computed_last_tick_ex);
-  INVARIANT(to_read_only_tick(last_tick_ex) > ro_tick_geq);
 #endif
 
   // XXX: hacky
@@ -584,11 +636,6 @@ transaction_proto2_static::clean_up_to_including(threadctx &ctx, uint64_t ro_tic
       px->~scoped_rcu_base<false>(); \
     } while (0)
 
-  ctx.scratch_.empty_accept_from(ctx.queue_, ro_tick_geq);
-  ctx.scratch_.transfer_freelist(ctx.queue_);
-  px_queue &q = ctx.scratch_;
-  if (q.empty())
-    return;
   bool in_rcu = false;
   size_t niters_with_rcu = 0, n = 0;
   for (auto it = q.begin(); it != q.end(); ++it, ++n, ++niters_with_rcu) {
@@ -604,7 +651,6 @@ transaction_proto2_static::clean_up_to_including(threadctx &ctx, uint64_t ro_tic
         cerr << "tuple           : " << g_proto_version_str(delent.tuple()->version) << endl;
         cerr << "last_consist_tid: " << g_proto_version_str(last_consistent_tid) << endl;
         cerr << "last_tick_ex    : " << last_tick_ex << endl;
-        cerr << "ro_tick_geq     : " << ro_tick_geq << endl;
         cerr << "rcu_block_tick  : " << it.tick() << endl;
       }
       INVARIANT(delent.trigger_tid_ <= last_consistent_tid);
@@ -622,61 +668,18 @@ transaction_proto2_static::clean_up_to_including(threadctx &ctx, uint64_t ro_tic
         cerr << "tuple           : " << g_proto_version_str(delent.tuple()->version) << endl;
         cerr << "last_consist_tid: " << g_proto_version_str(last_consistent_tid) << endl;
         cerr << "last_tick_ex    : " << last_tick_ex << endl;
-        cerr << "ro_tick_geq     : " << ro_tick_geq << endl;
         cerr << "rcu_block_tick  : " << it.tick() << endl;
       }
       INVARIANT(delent.tuple()->version == delent.trigger_tid_);
       INVARIANT(delent.tuple()->is_not_behind(last_consistent_tid));
       INVARIANT(delent.tuple()->is_deleting());
 #endif
-      if (unlikely(!delent.tuple()->is_latest())) {
-        // requeue it up, except this time as a regular delete
-        const uint64_t my_ro_tick = to_read_only_tick(
-            ticker::s_instance.global_current_tick());
-        ctx.queue_.enqueue(
-            delete_entry(
-              nullptr,
-              MakeTid(CoreMask, NumIdMask >> NumIdShift, (my_ro_tick + 1) * ReadOnlyEpochMultiplier - 1),
-              delent.tuple(),
-              marked_ptr<string>(),
-              nullptr),
-            my_ro_tick);
-        ++g_evt_proto_gc_delete_requeue;
-        // reclaim string ptrs
-        string *spx = delent.key_.get();
-        if (unlikely(spx))
-          ctx.pool_.emplace_back(spx);
-        continue;
-      }
-#ifdef CHECK_INVARIANTS
-      delent.tuple()->opaque.store(0, std::memory_order_release);
-#endif
-      // if delent.key_ is nullptr, then the key is stored in the tuple
-      // record storage location, and the size field contains the length of
-      // the key
-      //
-      // otherwise, delent.key_ is a pointer to a string containing the
-      // key
-      varkey k;
-      string *spx = delent.key_.get();
-      if (likely(!spx)) {
-        k = varkey(delent.tuple()->get_value_start(), delent.tuple()->size);
-      } else {
-        k = varkey(*spx);
-        ctx.pool_.emplace_back(spx);
-      }
-
       if (!in_rcu) {
         ENTER_RCU();
         niters_with_rcu = 0;
         in_rcu = true;
       }
-      typename concurrent_btree::value_type removed = 0;
-      const bool did_remove = delent.btr_->remove(k, &removed);
-      ALWAYS_ASSERT(did_remove);
-      INVARIANT(removed == (typename concurrent_btree::value_type) delent.tuple());
-      delent.tuple()->clear_latest();
-      dbtuple::release(delent.tuple()); // rcu free it
+      unlink_tombstone(ctx, delent);
     }
 
     if (in_rcu && niters_with_rcu >= max_niters_with_rcu) {
@@ -691,6 +694,179 @@ transaction_proto2_static::clean_up_to_including(threadctx &ctx, uint64_t ro_tic
   if (in_rcu)
     EXIT_RCU();
   INVARIANT(!rcu::s_instance.in_rcu_region());
+  return n;
+}
+
+bool
+transaction_proto2_static::unlink_tombstone(threadctx &ctx, delete_entry &delent)
+{
+  INVARIANT(rcu::s_instance.in_rcu_region());
+  INVARIANT(delent.tuple()->is_locked());
+  INVARIANT(delent.tuple()->is_deleting());
+  if (unlikely(!delent.tuple()->is_latest())) {
+    // requeue it up, except this time as a regular delete
+    const uint64_t my_ro_tick = to_read_only_tick(
+        ticker::s_instance.global_current_tick());
+    ctx.queue_.enqueue(
+        delete_entry(
+          nullptr,
+          MakeTid(CoreMask, NumIdMask >> NumIdShift, (my_ro_tick + 1) * ReadOnlyEpochMultiplier - 1),
+          delent.tuple(),
+          marked_ptr<string>(),
+          nullptr),
+        my_ro_tick);
+    ++g_evt_proto_gc_delete_requeue;
+    // reclaim string ptrs
+    string *spx = delent.key_.get();
+    if (unlikely(spx))
+      ctx.pool_.emplace_back(spx);
+    return false;
+  }
+#ifdef CHECK_INVARIANTS
+  delent.tuple()->opaque.store(0, std::memory_order_release);
+#endif
+  // if delent.key_ is nullptr, then the key is stored in the tuple
+  // record storage location, and the size field contains the length of
+  // the key
+  //
+  // otherwise, delent.key_ is a pointer to a string containing the
+  // key
+  varkey k;
+  string *spx = delent.key_.get();
+  if (likely(!spx)) {
+    k = varkey(delent.tuple()->get_value_start(), delent.tuple()->size);
+  } else {
+    k = varkey(*spx);
+    ctx.pool_.emplace_back(spx);
+  }
+
+  typename concurrent_btree::value_type removed = 0;
+  const bool did_remove = delent.btr_->remove(k, &removed);
+  ALWAYS_ASSERT(did_remove);
+  INVARIANT(removed == (typename concurrent_btree::value_type) delent.tuple());
+  delent.tuple()->clear_latest();
+  dbtuple::release(delent.tuple()); // rcu free it
+  return true;
+}
+
+void
+transaction_proto2_static::clean_up_tombstones_to_including(
+    threadctx &ctx, uint64_t tick_geq)
+{
+  INVARIANT(!rcu::s_instance.in_rcu_region());
+  INVARIANT(ctx.scratch_.empty());
+  if (likely(ctx.tombstones_.empty()))
+    return;
+  if (HandsOffGC(ctx)) {
+    ctx.tombstone_handoff_.publish(ctx.tombstones_, tick_geq);
+    publish_threadctx(ctx);
+    return;
+  }
+  ctx.scratch_.empty_accept_from(ctx.tombstones_, tick_geq);
+  ctx.scratch_.transfer_freelist(ctx.tombstones_);
+  reap_tombstones(ctx, ctx.scratch_);
+}
+
+size_t
+transaction_proto2_static::reap_tombstones(threadctx &ctx, px_queue &q)
+{
+  INVARIANT(!rcu::s_instance.in_rcu_region());
+  if (q.empty())
+    return 0;
+  const size_t max_niters_with_rcu = 128;
+  size_t n = 0, nreaped = 0;
+  auto it = q.begin();
+  while (it != q.end()) {
+    scoped_rcu_base<false> rcu_guard;
+    for (size_t i = 0; i < max_niters_with_rcu && it != q.end();
+         ++i, ++it, ++nreaped) {
+      auto &delent = *it;
+      INVARIANT(delent.tuple()->opaque.load(std::memory_order_acquire) == 1);
+      INVARIANT(!delent.tuple_ahead_);
+      INVARIANT(delent.key_.get_flags());
+      INVARIANT(delent.btr_);
+      ::lock_guard<dbtuple> lg_tuple(delent.tuple(), false);
+      INVARIANT(delent.tuple()->version == delent.trigger_tid_);
+      if (unlink_tombstone(ctx, delent))
+        n++;
+    }
+  }
+  q.clear();
+  g_evt_proto_gc_eager_tombstone_unlinks.inc(n);
+  INVARIANT(!rcu::s_instance.in_rcu_region());
+  return nreaped;
+}
+
+void
+transaction_proto2_static::publish_threadctx(threadctx &owner)
+{
+  ++g_evt_proto_gc_handoffs;
+  if (likely(owner.published_))
+    return;
+  owner.published_ = true;
+  const size_t core = coreid::core_id();
+  g_gc_handoffs[core].store(&owner, memory_order_release);
+  size_t n = g_ngc_handoffs.load(memory_order_acquire);
+  while (n <= core &&
+         !g_ngc_handoffs.compare_exchange_weak(n, core + 1, memory_order_acq_rel))
+    ;
+}
+
+size_t
+transaction_proto2_static::reap_handoffs(threadctx &ctx, threadctx &owner)
+{
+  // tombstones first, since unlinking one can queue a regular delete
+  size_t n = 0;
+  px_queue q;
+  if (owner.tombstone_handoff_.take(q)) {
+    n += reap_tombstones(ctx, q);
+    owner.tombstone_handoff_.give_back(q);
+  }
+  if (owner.handoff_.take(q)) {
+    n += reap_queue(ctx, q);
+    owner.handoff_.give_back(q);
+  }
+  return n;
+}
+
+void
+transaction_proto2_static::gc_reclaimer_loop(
+    int node, size_t idx, size_t nthreads_per_node)
+{
+  // frees of the workers' memory go back to their cores in per epoch
+  // batches (see rcu::sync::flush_remote()), so we stay unpinned
+  ALWAYS_ASSERT(!numa_run_on_node(node));
+  rcu::s_instance.set_reclaimer();
+  threadctx &ctx = g_threadctxs.my();
+  ctx.reclaimer_ = true;
+  // unlinking tombstones on behalf of the workers moves their key strings
+  // into our pool
+  const size_t max_pool_size = 1024;
+  for (;;) {
+    size_t n = 0;
+    const size_t ncores = max(
+        rcu::s_instance.nhandoff_cores(),
+        g_ngc_handoffs.load(memory_order_acquire));
+    for (size_t i = idx; i < ncores; i += nthreads_per_node) {
+      if (max(rcu::s_instance.handoff_node(i), 0) != node)
+        continue;
+      threadctx * const owner = g_gc_handoffs[i].load(memory_order_acquire);
+      if (owner)
+        n += reap_handoffs(ctx, *owner);
+      n += rcu::s_instance.reclaim(i);
+    }
+    g_evt_proto_gc_background_reaps.inc(n);
+
+    // tombstones which were superseded are requeued onto our own queues
+    clean_up(ctx);
+    rcu::s_instance.do_cleanup();
+    while (ctx.pool_.size() > max_pool_size) {
+      delete ctx.pool_.back();
+      ctx.pool_.pop_back();
+    }
+    if (!n)
+      usleep(ticker::tick_us);
+  }
 }
 
 aligned_padded_elem<transaction_proto2_static::hackstruct>
@@ -699,6 +875,10 @@ aligned_padded_elem<transaction_proto2_static::flags>
   transaction_proto2_static::g_flags;
 percore_lazy<transaction_proto2_static::threadctx>
   transaction_proto2_static::g_threadctxs;
+atomic<transaction_proto2_static::threadctx *>
+  transaction_proto2_static::g_gc_handoffs[NMAXCORES];
+atomic<size_t>
+  transaction_proto2_static::g_ngc_handoffs(0);
 event_counter
   transaction_proto2_static::g_evt_worker_thread_wait_log_buffer(
       "worker_thread_wait_log_buffer");
@@ -708,6 +888,15 @@ event_counter
 event_counter
   transaction_proto2_static::g_evt_proto_gc_delete_requeue(
       "proto_gc_delete_requeue");
+event_counter
+  transaction_proto2_static::g_evt_proto_gc_eager_tombstone_unlinks(
+      "proto_gc_eager_tombstone_unlinks");
+event_counter
+  transaction_proto2_static::g_evt_proto_gc_handoffs(
+      "proto_gc_handoffs");
+event_counter
+  transaction_proto2_static::g_evt_proto_gc_background_reaps(
+      "proto_gc_background_reaps");
 event_avg_counter
   transaction_proto2_static::g_evt_avg_log_entry_size(
       "avg_log_entry_size");
@@ -479,6 +479,20 @@ public:
   // thread-safe, can be called many times
   static void InitGC();
 
+  // starts nthreads_per_node reclaimer threads on every NUMA node. from then
+  // on, workers only queue their expired versions, tombstones and RCU frees
+  // for the reclaimers serving their node, instead of running them at the
+  // end of the transaction which notices the epoch change. thread-safe,
+  // only the first call has an effect
+  static void StartBackgroundGC(size_t nthreads_per_node);
+
+  static inline bool
+  IsBackgroundGC()
+  {
+    return g_flags->g_background_gc.load(std::memory_order_acquire);
+  }
+
+  // in background mode, this hands the calling thread's tasks off
   static void PurgeThreadOutstandingGCTasks();
 
 #ifdef PROTO2_CAN_DISABLE_GC
@@ -545,6 +559,7 @@ protected:
   };
 
   typedef basic_px_queue<delete_entry, 4096> px_queue;
+  typedef basic_px_handoff<delete_entry, 4096> px_handoff;
 
   struct threadctx {
     uint64_t last_commit_tid_;
@@ -552,8 +567,14 @@ protected:
 #ifdef ENABLE_EVENT_COUNTERS
     uint64_t last_reaped_timestamp_us_;
 #endif
-    px_queue queue_;
+    px_queue queue_; // indexed by read-only tick
     px_queue scratch_;
+    px_queue tombstones_; // indexed by (regular) tick
+    // expired entries of queue_/tombstones_, waiting for a reclaimer
+    px_handoff handoff_;
+    px_handoff tombstone_handoff_;
+    bool reclaimer_;
+    bool published_; // in g_gc_handoffs
     std::deque<std::string *> pool_;
     threadctx() :
         last_commit_tid_(0)
@@ -561,16 +582,89 @@ protected:
 #ifdef ENABLE_EVENT_COUNTERS
       , last_reaped_timestamp_us_(0)
 #endif
+      , reclaimer_(false)
+      , published_(false)
     {
       ALWAYS_ASSERT(((uintptr_t)this % CACHELINE_SIZE) == 0);
       queue_.alloc_freelist(rcu::NQueueGroups);
       scratch_.alloc_freelist(rcu::NQueueGroups);
+      tombstones_.alloc_freelist(rcu::NQueueGroups);
     }
   };
 
   static void
   clean_up_to_including(threadctx &ctx, uint64_t ro_tick_geq);
 
+  // unlinks the tombstones on ctx.tombstones_ which were committed in
+  // ticks <= tick_geq
+  static void
+  clean_up_tombstones_to_including(threadctx &ctx, uint64_t tick_geq);
+
+  // runs all the clean ups which the current tick allows
+  static inline void
+  clean_up(threadctx &ctx)
+  {
+    const uint64_t last_tick_ex = ticker::s_instance.global_last_tick_exclusive();
+    if (unlikely(!last_tick_ex))
+      return;
+    // no reader which overlapped with a tombstone committed in a tick
+    // <= last_tick_ex - 1 is still running
+    clean_up_tombstones_to_including(ctx, last_tick_ex - 1);
+    // we subtract one from the global last tick, because of the way
+    // consistent TIDs are computed, the global_last_tick_exclusive() can
+    // increase by at most one tick during a transaction.
+    const uint64_t ro_tick_ex = to_read_only_tick(last_tick_ex - 1);
+    if (unlikely(!ro_tick_ex))
+      // won't have anything to clean
+      return;
+    // all reads happening at >= ro_tick_geq
+    const uint64_t ro_tick_geq = ro_tick_ex - 1;
+    clean_up_to_including(ctx, ro_tick_geq);
+  }
+
+  // reaps the (expired) entries on q, which come from ctx.queue_ or
+  // ctx.tombstones_ respectively, or from those of another thread. q is
+  // cleared. returns the number of entries reaped
+  static size_t reap_queue(threadctx &ctx, px_queue &q);
+  static size_t reap_tombstones(threadctx &ctx, px_queue &q);
+
+  // whether ctx leaves its clean ups to the reclaimers
+  static inline bool
+  HandsOffGC(const threadctx &ctx)
+  {
+    return IsBackgroundGC() && !ctx.reclaimer_;
+  }
+
+  // makes owner's handoffs visible to the reclaimers
+  static void publish_threadctx(threadctx &owner);
+
+  // reaps everything owner has handed off so far, on behalf of ctx.
+  // returns the number of entries reaped
+  static size_t reap_handoffs(threadctx &ctx, threadctx &owner);
+
+  static void gc_reclaimer_loop(int node, size_t idx, size_t nthreads_per_node);
+
+  // removes the logically deleted tuple in delent from its btree (returns
+  // true), or requeues it as a regular delete if it has since been
+  // superseded (returns false). caller holds the tuple lock and is in an
+  // RCU region
+  static bool
+  unlink_tombstone(threadctx &ctx, delete_entry &delent);
+
+  // a tombstone with no older versions behind it reads as absent at every
+  // snapshot, so it can be unlinked as soon as the readers which were
+  // active when it was committed are gone (an RCU tick), instead of
+  // waiting for every snapshot which predates it (a read-only epoch)
+  static inline bool
+  CanUnlinkTombstoneEagerly(const dbtuple *tuple)
+  {
+#ifdef PROTO2_CAN_DISABLE_SNAPSHOTS
+    if (!IsSnapshotsEnabled())
+      return true;
+#endif
+    return !tuple->get_next();
+  }
+
   // helper methods
   static inline txn_logger::pbuffer *
   wait_for_head(txn_logger::pbuffer_circbuf &pull_buf)
@@ -685,15 +779,24 @@ protected:
   struct flags {
     std::atomic<bool> g_gc_init;
     std::atomic<bool> g_disable_snapshots;
-    constexpr flags() : g_gc_init(false), g_disable_snapshots(false) {}
+    std::atomic<bool> g_background_gc;
+    constexpr flags()
+      : g_gc_init(false), g_disable_snapshots(false), g_background_gc(false) {}
   };
   static util::aligned_padded_elem<flags> g_flags;
 
   static percore_lazy<threadctx> g_threadctxs;
 
+  // threadctxs which have handed off clean ups, by core id
+  static std::atomic<threadctx *> g_gc_handoffs[NMAXCORES];
+  static std::atomic<size_t> g_ngc_handoffs;
+
   static event_counter g_evt_worker_thread_wait_log_buffer;
   static event_counter g_evt_dbtuple_no_space_for_delkey;
   static event_counter g_evt_proto_gc_delete_requeue;
+  static event_counter g_evt_proto_gc_eager_tombstone_unlinks;
+  static event_counter g_evt_proto_gc_handoffs;
+  static event_counter g_evt_proto_gc_background_reaps;
   static event_avg_counter g_evt_avg_log_entry_size;
   static event_avg_counter g_evt_avg_proto_gc_queue_len;
 };
@@ -730,7 +833,7 @@ public:
                      typename Traits::StringAllocator &sa)
     : transaction<transaction_proto2, Traits>(flags, sa)
   {
-    if (this->get_flags() & transaction_base::TXN_FLAG_READ_ONLY) {
+    if (this->reads_from_snapshot()) {
       const uint64_t global_tick_ex =
         this->rcu_guard_->guard()->impl().global_last_tick_exclusive();
       u_.last_consistent_tid = ComputeReadOnlyTid(global_tick_ex);
@@ -770,9 +873,14 @@ public:
   }
 
   // can only read elements in this epoch or previous epochs
+  //
+  // snapshot isolation txns additionally cannot overwrite records which
+  // changed after their snapshot (first committer wins)
   inline bool
   can_read_tid(tid_t t) const
   {
+    if (unlikely(this->get_flags() & transaction_base::TXN_FLAG_SNAPSHOT_ISOLATION))
+      return t <= snapshot_tid();
     return true;
   }
 
@@ -964,7 +1072,7 @@ public:
   dump_debug_info() const
   {
     transaction<transaction_proto2, Traits>::dump_debug_info();
-    if (this->is_snapshot())
+    if (this->reads_from_snapshot())
       std::cerr << "  last_consistent_tid: "
         << g_proto_version_str(u_.last_consistent_tid) << std::endl;
   }
@@ -1097,8 +1205,11 @@ public:
     INVARIANT(!tuple->size);
     INVARIANT(rcu::s_instance.in_rcu_region());
 
-    const uint64_t ro_tick = to_read_only_tick(this->u_.commit_epoch);
     threadctx &ctx = g_threadctxs.my();
+    const bool eager = CanUnlinkTombstoneEagerly(tuple);
+    px_queue &q = eager ? ctx.tombstones_ : ctx.queue_;
+    const uint64_t tick = eager ?
+      this->u_.commit_epoch : to_read_only_tick(this->u_.commit_epoch);
 
 #ifdef CHECK_INVARIANTS
     uint64_t exp = 0;
@@ -1110,12 +1221,13 @@ public:
       tuple->size = key.size();
 
       // eligible for deletion when all snapshots >= the current epoch
+      // (or, if eager, when all readers >= the current tick)
       marked_ptr<std::string> mpx;
       mpx.set_flags(0x1);
 
-      ctx.queue_.enqueue(
+      q.enqueue(
           delete_entry(nullptr, tuple->version, tuple, mpx, btr),
-          ro_tick);
+          tick);
     } else {
       // this is a rare event
       ++g_evt_dbtuple_no_space_for_delkey;
@@ -1132,9 +1244,9 @@ public:
       marked_ptr<std::string> mpx(spx);
       mpx.set_flags(0x1);
 
-      ctx.queue_.enqueue(
+      q.enqueue(
           delete_entry(nullptr, tuple->version, tuple, mpx, btr),
-          ro_tick);
+          tick);
     }
   }
 
@@ -1145,25 +1257,14 @@ public:
     if (!IsGCEnabled())
       return;
 #endif
-    const uint64_t last_tick_ex = ticker::s_instance.global_last_tick_exclusive();
-    if (unlikely(!last_tick_ex))
-      return;
-    // we subtract one from the global last tick, because of the way
-    // consistent TIDs are computed, the global_last_tick_exclusive() can
-    // increase by at most one tick during a transaction.
-    const uint64_t ro_tick_ex = to_read_only_tick(last_tick_ex - 1);
-    if (unlikely(!ro_tick_ex))
-      // won't have anything to clean
-      return;
-    // all reads happening at >= ro_tick_geq
-    const uint64_t ro_tick_geq = ro_tick_ex - 1;
-    threadctx &ctx = g_threadctxs.my();
-    clean_up_to_including(ctx, ro_tick_geq);
+    clean_up(g_threadctxs.my());
   }
 
 private:
 
-  union {
+  // not a union, since snapshot isolation txns both read from a
+  // snapshot and commit writes
+  struct {
     // the global epoch this txn is running in (this # is read when it starts)
     // -- snapshot txns only
     uint64_t last_consistent_tid;
@@ -4,6 +4,7 @@
 #include "base_txn_btree.h"
 #include "txn_btree.h"
 #include "record/cursor.h"
+#include "record/encoder.h"
 
 template <typename Schema>
 struct typed_txn_btree_ {
@@ -85,6 +86,17 @@ struct typed_txn_btree_ {
       return do_record_read(data, sz, fields_mask, v);
     }
 
+    // records are decoded in place, so a large value must be gathered
+    template <typename StringAllocator>
+    inline bool
+    operator()(const dbtuple::large_value &lv, StringAllocator &sa)
+    {
+      std::string * const buf = sa();
+      lv.assign_to(*buf);
+      return do_record_read(
+          (const uint8_t *) buf->data(), buf->size(), fields_mask, v);
+    }
+
     inline value_type &
     results()
     {
@@ -122,6 +134,17 @@ struct typed_txn_btree_ {
       return do_record_read(data, sz, fields_mask, &v);
     }
 
+    // see single_value_reader
+    template <typename StringAllocator>
+    inline bool
+    operator()(const dbtuple::large_value &lv, StringAllocator &sa)
+    {
+      std::string * const buf = sa();
+      lv.assign_to(*buf);
+      return do_record_read(
+          (const uint8_t *) buf->data(), buf->size(), fields_mask, &v);
+    }
+
     inline value_type &
     results()
     {
@@ -449,10 +472,27 @@ public:
 
   typed_txn_btree(size_type value_size_hint = 128,
                   bool mostly_append = false,
-                  const std::string &name = "<unknown>")
-    : super_type(value_size_hint, mostly_append, name)
+                  const std::string &name = "<unknown>",
+                  bool hashed = false)
+    : super_type(value_size_hint, mostly_append, name, hashed)
   {}
 
+  // column groups: if the schema declares more than one (see
+  // column_group_schema), group g of key k is stored as its own record under
+  // the encoding of k followed by the byte g. search() and put() only touch
+  // (and thus only validate) the groups which intersect their FieldsMask;
+  // insert() and remove() touch every group. range scans read every group in
+  // the range, and put() of a subset of fields expects the row to exist
+  static const size_t NColumnGroups = Schema::NColumnGroups;
+
+  // rows, not records (a row w/ some of its group records already unlinked
+  // still counts)
+  inline size_t
+  size_estimate() const
+  {
+    return (super_type::size_estimate() + NColumnGroups - 1) / NColumnGroups;
+  }
+
   template <typename Traits, typename FieldsMask = AllFields>
   inline bool search(
       Transaction<Traits> &t, const key_type &k, value_type &v,
@@ -487,6 +527,169 @@ public:
 
 private:
 
+  typedef std::integral_constant<bool, (NColumnGroups > 1)> is_grouped;
+  template <size_t G> using group_tag = std::integral_constant<size_t, G>;
+
+  template <typename Traits>
+  inline bool search_impl(
+      Transaction<Traits> &t, const key_type &k, value_type &v,
+      uint64_t fields, std::false_type);
+
+  template <typename Traits>
+  inline bool search_impl(
+      Transaction<Traits> &t, const key_type &k, value_type &v,
+      uint64_t fields, std::true_type);
+
+  template <typename Traits, size_t G>
+  inline bool search_groups(
+      Transaction<Traits> &t, const std::string &k, value_type &v,
+      uint64_t fields, group_tag<G>);
+
+  template <typename Traits>
+  inline bool
+  search_groups(Transaction<Traits> &t, const std::string &k, value_type &v,
+                uint64_t fields, group_tag<NColumnGroups>)
+  {
+    return true;
+  }
+
+  template <typename Traits>
+  inline void search_range_call_impl(
+      Transaction<Traits> &t, const key_type &lower, const key_type *upper,
+      search_range_callback &callback, bool no_key_results,
+      uint64_t fields, std::false_type);
+
+  template <typename Traits>
+  inline void search_range_call_impl(
+      Transaction<Traits> &t, const key_type &lower, const key_type *upper,
+      search_range_callback &callback, bool no_key_results,
+      uint64_t fields, std::true_type);
+
+  template <typename Traits, uint64_t Fields>
+  inline void put_impl(
+      Transaction<Traits> &t, const key_type &k, const value_type *v,
+      bool expect_new, std::false_type);
+
+  template <typename Traits, uint64_t Fields>
+  inline void put_impl(
+      Transaction<Traits> &t, const key_type &k, const value_type *v,
+      bool expect_new, std::true_type);
+
+  template <typename Traits, uint64_t Fields, size_t G>
+  inline void put_groups(
+      Transaction<Traits> &t, const std::string &k, const value_type *v,
+      bool expect_new, group_tag<G>);
+
+  template <typename Traits, uint64_t Fields>
+  inline void
+  put_groups(Transaction<Traits> &t, const std::string &k,
+             const value_type *v, bool expect_new, group_tag<NColumnGroups>)
+  {
+  }
+
+  // decodes the fields (local to group g) of a group record into v
+  template <size_t G>
+  static inline bool
+  read_group(size_t g, const std::string &r, uint64_t fields, value_type *v,
+             group_tag<G>)
+  {
+    if (g != G)
+      return read_group(g, r, fields, v, group_tag<G + 1>());
+    return typed_txn_btree_<typename Schema::template group<G>>::do_record_read(
+        (const uint8_t *) r.data(), r.size(), fields, v);
+  }
+
+  static inline bool
+  read_group(size_t g, const std::string &r, uint64_t fields, value_type *v,
+             group_tag<NColumnGroups>)
+  {
+    ALWAYS_ASSERT(false);
+    return false;
+  }
+
+  // the fields in mask which belong to group g, as group local field bits
+  static inline uint64_t
+  GroupFields(uint64_t fields, size_t g)
+  {
+    return private_::compress_mask(fields, Schema::GroupMask(g));
+  }
+
+  template <typename Traits>
+  static inline const std::string *
+  group_key(Transaction<Traits> &t, const std::string &k, size_t g)
+  {
+    std::string * const ret = t.string_allocator()();
+    ret->reserve(k.size() + 1);
+    ret->assign(k);
+    ret->push_back(char(g));
+    return ret;
+  }
+
+  // reassembles rows from the records of their column groups, which a scan
+  // visits one key (and group) at a time, in order
+  class column_group_scan_callback {
+  public:
+    column_group_scan_callback(search_range_callback &callback,
+                               bool no_key_results,
+                               uint64_t fields)
+      : callback(&callback), no_key_results(no_key_results), fields(fields),
+        needed_groups(0), seen_groups(0), pending(false)
+    {
+      for (size_t g = 0; g < NColumnGroups; g++)
+        if (GroupFields(fields, g))
+          needed_groups |= (1UL << g);
+    }
+
+    template <typename KeyString>
+    inline bool
+    invoke(const KeyString &k, const std::string &r)
+    {
+      INVARIANT(k.length() > 0);
+      const size_t ksz = k.length() - 1;
+      const size_t g = (uint8_t) k.data()[ksz];
+      INVARIANT(g < NColumnGroups);
+      if (!pending || key.size() != ksz ||
+          memcmp(key.data(), k.data(), ksz)) {
+        if (!flush())
+          return false;
+        key.assign(k.data(), ksz);
+        seen_groups = 0;
+        pending = true;
+      }
+      const uint64_t group_fields = GroupFields(fields, g);
+      if (group_fields &&
+          likely(read_group(g, r, group_fields, &v, group_tag<0>())))
+        seen_groups |= (1UL << g);
+      return true;
+    }
+
+    // hands the pending row (if complete) to the caller's callback
+    inline bool
+    flush()
+    {
+      if (!pending)
+        return true;
+      pending = false;
+      if ((seen_groups & needed_groups) != needed_groups)
+        return true;
+      const key_encoder_type key_encoder;
+      if (!no_key_results)
+        key_encoder.read(key, &k);
+      return callback->invoke(k, v);
+    }
+
+  private:
+    search_range_callback *const callback;
+    const bool no_key_results;
+    const uint64_t fields;
+    uint64_t needed_groups;
+    uint64_t seen_groups;
+    bool pending;
+    std::string key;
+    key_type k;
+    value_type v;
+  };
+
   template <typename Traits>
   static inline const std::string *
   stablize(Transaction<Traits> &t, const key_type &k)
@@ -517,12 +720,54 @@ bool
 typed_txn_btree<Transaction, Schema>::search(
     Transaction<Traits> &t, const key_type &k, value_type &v,
     FieldsMask fm)
+{
+  return search_impl(t, k, v, FieldsMask::value, is_grouped());
+}
+
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits>
+bool
+typed_txn_btree<Transaction, Schema>::search_impl(
+    Transaction<Traits> &t, const key_type &k, value_type &v,
+    uint64_t fields, std::false_type)
 {
   // XXX: template single_value_reader with mask
-  single_value_reader vr(v, FieldsMask::value);
+  single_value_reader vr(v, fields);
   return this->do_search(t, k, vr);
 }
 
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits>
+bool
+typed_txn_btree<Transaction, Schema>::search_impl(
+    Transaction<Traits> &t, const key_type &k, value_type &v,
+    uint64_t fields, std::true_type)
+{
+  key_writer writer(&k);
+  const std::string * const key_str =
+    writer.fully_materialize(true, t.string_allocator());
+  return search_groups(t, *key_str, v, fields, group_tag<0>());
+}
+
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits, size_t G>
+bool
+typed_txn_btree<Transaction, Schema>::search_groups(
+    Transaction<Traits> &t, const std::string &k, value_type &v,
+    uint64_t fields, group_tag<G>)
+{
+  typedef typename Schema::template group<G> group_schema;
+  const uint64_t group_fields =
+    private_::compress_mask(fields, group_schema::mask);
+  if (group_fields) {
+    typename typed_txn_btree_<group_schema>::single_value_reader
+      vr(v, group_fields);
+    if (!this->do_search_key(t, *group_key(t, k, G), vr))
+      return false;
+  }
+  return search_groups(t, k, v, fields, group_tag<G + 1>());
+}
+
 template <template <typename> class Transaction, typename Schema>
 template <typename Traits, typename FieldsMask>
 void
@@ -532,12 +777,48 @@ typed_txn_btree<Transaction, Schema>::search_range_call(
     search_range_callback &callback,
     bool no_key_results,
     FieldsMask fm)
+{
+  search_range_call_impl(t, lower, upper, callback, no_key_results,
+                         FieldsMask::value, is_grouped());
+}
+
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits>
+void
+typed_txn_btree<Transaction, Schema>::search_range_call_impl(
+    Transaction<Traits> &t,
+    const key_type &lower, const key_type *upper,
+    search_range_callback &callback,
+    bool no_key_results,
+    uint64_t fields,
+    std::false_type)
 {
   key_reader kr(no_key_results);
-  value_reader vr(FieldsMask::value);
+  value_reader vr(fields);
   this->do_search_range_call(t, lower, upper, callback, kr, vr);
 }
 
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits>
+void
+typed_txn_btree<Transaction, Schema>::search_range_call_impl(
+    Transaction<Traits> &t,
+    const key_type &lower, const key_type *upper,
+    search_range_callback &callback,
+    bool no_key_results,
+    uint64_t fields,
+    std::true_type)
+{
+  // the bounds need no group suffix: every group of a key sorts after the
+  // key itself
+  column_group_scan_callback c(callback, no_key_results, fields);
+  bytes_key_reader kr;
+  bytes_value_reader vr(std::numeric_limits<size_t>::max());
+  this->do_search_range_call(t, lower, upper, c, kr, vr);
+  // a no-op if the caller's callback stopped the scan
+  c.flush();
+}
+
 template <template <typename> class Transaction, typename Schema>
 template <typename Traits>
 void
@@ -546,6 +827,8 @@ typed_txn_btree<Transaction, Schema>::bytes_search_range_call(
     bytes_search_range_callback &callback,
     size_type value_fields_prefix)
 {
+  static_assert(NColumnGroups == 1,
+                "rows of column grouped tables have no single encoding");
   const value_encoder_type value_encoder;
   const size_t max_bytes_read =
     value_encoder.encode_max_nbytes_prefix(value_fields_prefix);
@@ -561,9 +844,7 @@ typed_txn_btree<Transaction, Schema>::put(
     Transaction<Traits> &t, const key_type &k, const value_type &v, FieldsMask fm)
 {
   static_assert(IsSupportable<Traits>(), "xx");
-  const dbtuple::tuple_writer_t tw =
-    &typed_txn_btree_<Schema>::template tuple_writer<FieldsMask::value>;
-  this->do_tree_put(t, stablize(t, k), stablize(t, v), tw, false);
+  put_impl<Traits, FieldsMask::value>(t, k, stablize(t, v), false, is_grouped());
 }
 
 template <template <typename> class Transaction, typename Schema>
@@ -573,9 +854,7 @@ typed_txn_btree<Transaction, Schema>::insert(
     Transaction<Traits> &t, const key_type &k, const value_type &v)
 {
   static_assert(IsSupportable<Traits>(), "xx");
-  const dbtuple::tuple_writer_t tw =
-    &typed_txn_btree_<Schema>::template tuple_writer<AllFieldsMask>;
-  this->do_tree_put(t, stablize(t, k), stablize(t, v), tw, true);
+  put_impl<Traits, AllFieldsMask>(t, k, stablize(t, v), true, is_grouped());
 }
 
 template <template <typename> class Transaction, typename Schema>
@@ -585,9 +864,48 @@ typed_txn_btree<Transaction, Schema>::remove(
     Transaction<Traits> &t, const key_type &k)
 {
   static_assert(IsSupportable<Traits>(), "xx");
+  put_impl<Traits, 0>(t, k, nullptr, false, is_grouped());
+}
+
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits, uint64_t Fields>
+void
+typed_txn_btree<Transaction, Schema>::put_impl(
+    Transaction<Traits> &t, const key_type &k, const value_type *v,
+    bool expect_new, std::false_type)
+{
   const dbtuple::tuple_writer_t tw =
-    &typed_txn_btree_<Schema>::template tuple_writer<0>;
-  this->do_tree_put(t, stablize(t, k), nullptr, tw, false);
+    &typed_txn_btree_<Schema>::template tuple_writer<Fields>;
+  this->do_tree_put(t, stablize(t, k), v, tw, expect_new);
+}
+
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits, uint64_t Fields>
+void
+typed_txn_btree<Transaction, Schema>::put_impl(
+    Transaction<Traits> &t, const key_type &k, const value_type *v,
+    bool expect_new, std::true_type)
+{
+  put_groups<Traits, Fields>(t, *stablize(t, k), v, expect_new, group_tag<0>());
+}
+
+template <template <typename> class Transaction, typename Schema>
+template <typename Traits, uint64_t Fields, size_t G>
+void
+typed_txn_btree<Transaction, Schema>::put_groups(
+    Transaction<Traits> &t, const std::string &k, const value_type *v,
+    bool expect_new, group_tag<G>)
+{
+  typedef typename Schema::template group<G> group_schema;
+  static const uint64_t GroupFields =
+    private_::compress_mask(Fields, group_schema::mask);
+  // a remove (Fields == 0) deletes every group
+  if (GroupFields || !Fields) {
+    const dbtuple::tuple_writer_t tw =
+      &typed_txn_btree_<group_schema>::template tuple_writer<GroupFields>;
+    this->do_tree_put(t, group_key(t, k, G), v, tw, expect_new);
+  }
+  put_groups<Traits, Fields>(t, k, v, expect_new, group_tag<G + 1>());
 }
 
 #endif /* _NDB_TYPED_TXN_BTREE_H_ */
@@ -399,6 +399,76 @@ public:
   }
 };
 
+// log-linear histogram of samples (e.g. latencies in usec): each power of two
+// range is split into 2^SubBucketBits buckets, so percentiles are within
+// 1/2^SubBucketBits of the true value
+class log_histogram {
+public:
+  static const unsigned SubBucketBits = 3;
+  static const size_t NBuckets = (64 - SubBucketBits + 1) << SubBucketBits;
+
+  log_histogram() : n_(0)
+  {
+    NDB_MEMSET(&buckets_[0], 0, sizeof(buckets_));
+  }
+
+  inline void
+  add(uint64_t v)
+  {
+    buckets_[Bucket(v)]++;
+    n_++;
+  }
+
+  void
+  merge(const log_histogram &o)
+  {
+    for (size_t i = 0; i < NBuckets; i++)
+      buckets_[i] += o.buckets_[i];
+    n_ += o.n_;
+  }
+
+  inline uint64_t count() const { return n_; }
+
+  // an upper bound on the value below which a fraction p of the samples
+  // lie, or 0 if there are none
+  uint64_t
+  percentile(double p) const
+  {
+    const uint64_t rank = std::max(uint64_t(1), uint64_t(p * n_ + 0.5));
+    uint64_t acc = 0;
+    for (size_t i = 0; i < NBuckets; i++) {
+      acc += buckets_[i];
+      if (acc >= rank)
+        return BucketMax(i);
+    }
+    return 0;
+  }
+
+private:
+  static inline size_t
+  Bucket(uint64_t v)
+  {
+    if (v < (1UL << SubBucketBits))
+      return v;
+    const unsigned shift = (63 - __builtin_clzl(v)) - SubBucketBits;
+    return ((shift + 1) << SubBucketBits) +
+           ((v >> shift) & ((1UL << SubBucketBits) - 1));
+  }
+
+  static inline uint64_t
+  BucketMax(size_t b)
+  {
+    if (b < (1UL << SubBucketBits))
+      return b;
+    const unsigned shift = (b >> SubBucketBits) - 1;
+    const uint64_t sub = b & ((1UL << SubBucketBits) - 1);
+    return ((((1UL << SubBucketBits) | sub) << shift) - 1) + (1UL << shift);
+  }
+
+  uint64_t n_;
+  uint64_t buckets_[NBuckets];
+};
+
 inline std::string
 next_key(const std::string &s)
 {